@@ -0,0 +1,380 @@
+/*
+Copyright (C) 2018-2020 Andreas Bertsatos <abertsatos@biol.uoa.gr>
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free Software
+Foundation; either version 3 of the License, or (at your option) any later
+version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+details.
+
+You should have received a copy of the GNU General Public License along with
+this program; if not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <cmath>
+#include <octave/oct.h>
+#include "meshThreads.h"
+
+// eigenvector of the largest eigenvalue of the symmetric 4x4 matrix A by
+// cyclic Jacobi rotations, which converge in a few sweeps
+static void largest_eigenvector (double A[4][4], double q[4])
+{
+  double Q[4][4] = {{1, 0, 0, 0}, {0, 1, 0, 0}, {0, 0, 1, 0}, {0, 0, 0, 1}};
+  for (int sweep = 0; sweep < 50; sweep++)
+  {
+      double off = 0;
+      for (int p = 0; p < 3; p++)
+      {
+          for (int r = p + 1; r < 4; r++)
+          {
+              off += A[p][r] * A[p][r];
+          }
+      }
+      if (off == 0)
+      {
+          break;
+      }
+      for (int p = 0; p < 3; p++)
+      {
+          for (int r = p + 1; r < 4; r++)
+          {
+              if (A[p][r] == 0)
+              {
+                  continue;
+              }
+              // rotation zeroing A[p][r]
+              double theta = (A[r][r] - A[p][p]) / (2 * A[p][r]);
+              double t = (theta >= 0 ? 1 : -1)
+                         / (std::abs (theta) + std::sqrt (theta * theta + 1));
+              double c = 1 / std::sqrt (t * t + 1);
+              double s = t * c;
+              for (int k = 0; k < 4; k++)
+              {
+                  double akp = A[k][p];
+                  double akr = A[k][r];
+                  A[k][p] = c * akp - s * akr;
+                  A[k][r] = s * akp + c * akr;
+              }
+              for (int k = 0; k < 4; k++)
+              {
+                  double apk = A[p][k];
+                  double ark = A[r][k];
+                  A[p][k] = c * apk - s * ark;
+                  A[r][k] = s * apk + c * ark;
+              }
+              for (int k = 0; k < 4; k++)
+              {
+                  double qkp = Q[k][p];
+                  double qkr = Q[k][r];
+                  Q[k][p] = c * qkp - s * qkr;
+                  Q[k][r] = s * qkp + c * qkr;
+              }
+          }
+      }
+  }
+  int largest = 0;
+  for (int k = 1; k < 4; k++)
+  {
+      if (A[k][k] > A[largest][largest])
+      {
+          largest = k;
+      }
+  }
+  for (int k = 0; k < 4; k++)
+  {
+      q[k] = Q[k][largest];
+  }
+}
+
+// optimal rotation of the centered DxD covariance H = A' * B, for D of 2 or
+// 3, such that A * R is closest to B.  The rotation of two dimensions is
+// given by the angle maximizing trace (R' * H), and that of three dimensions
+// by the unit quaternion maximizing it (Horn, 1987), which is the
+// eigenvector of the largest eigenvalue of a symmetric 4x4 matrix.  Both are
+// proper rotations, like the reflection corrected singular value
+// decomposition of H
+static void optimal_rotation (const double H[3][3], int D, double R[3][3])
+{
+  if (D == 2)
+  {
+      double angle = std::atan2 (H[0][1] - H[1][0], H[0][0] + H[1][1]);
+      double c = std::cos (angle);
+      double s = std::sin (angle);
+      R[0][0] = c;
+      R[0][1] = s;
+      R[1][0] = -s;
+      R[1][1] = c;
+      return;
+  }
+  double N[4][4] =
+  {
+    {H[0][0] + H[1][1] + H[2][2], H[1][2] - H[2][1], H[2][0] - H[0][2],
+     H[0][1] - H[1][0]},
+    {H[1][2] - H[2][1], H[0][0] - H[1][1] - H[2][2], H[0][1] + H[1][0],
+     H[2][0] + H[0][2]},
+    {H[2][0] - H[0][2], H[0][1] + H[1][0], -H[0][0] + H[1][1] - H[2][2],
+     H[1][2] + H[2][1]},
+    {H[0][1] - H[1][0], H[2][0] + H[0][2], H[1][2] + H[2][1],
+     -H[0][0] - H[1][1] + H[2][2]}
+  };
+  double q[4];
+  largest_eigenvector (N, q);
+  double w = q[0], x = q[1], y = q[2], z = q[3];
+  // the quaternion rotates the column vectors of A to those of B, so R, which
+  // multiplies the row vectors, is its transpose
+  R[0][0] = w * w + x * x - y * y - z * z;
+  R[1][0] = 2 * (x * y - w * z);
+  R[2][0] = 2 * (x * z + w * y);
+  R[0][1] = 2 * (x * y + w * z);
+  R[1][1] = w * w - x * x + y * y - z * z;
+  R[2][1] = 2 * (y * z - w * x);
+  R[0][2] = 2 * (x * z - w * y);
+  R[1][2] = 2 * (y * z + w * x);
+  R[2][2] = w * w - x * x - y * y + z * z;
+}
+
+// align configuration A to configuration B, both N x D column-major
+// matrices, with the point weights w, or equal weights if w is null.  The
+// rotation R and translation T are stored column-major, as are the
+// deviations of the N points.  Returns the weighted mean deviation, or -1 if
+// the weights do not have a positive sum
+static double align (const double *A, const double *B, const double *w,
+                     octave_idx_type N, int D, double *R, double *T,
+                     double *point_dev)
+{
+  // weighted centroids of both configurations
+  double total = 0;
+  double A_centroid[3] = {0, 0, 0};
+  double B_centroid[3] = {0, 0, 0};
+  for (octave_idx_type i = 0; i < N; i++)
+  {
+      double weight = w ? w[i] : 1;
+      total += weight;
+      for (int k = 0; k < D; k++)
+      {
+          A_centroid[k] += weight * A[i + k * N];
+          B_centroid[k] += weight * B[i + k * N];
+      }
+  }
+  if (! (total > 0))
+  {
+      return -1;
+  }
+  for (int k = 0; k < D; k++)
+  {
+      A_centroid[k] /= total;
+      B_centroid[k] /= total;
+  }
+  // weighted covariance of the configurations translated to the origin
+  double H[3][3] = {{0, 0, 0}, {0, 0, 0}, {0, 0, 0}};
+  for (octave_idx_type i = 0; i < N; i++)
+  {
+      double weight = w ? w[i] : 1;
+      double a[3], b[3];
+      for (int k = 0; k < D; k++)
+      {
+          a[k] = A[i + k * N] - A_centroid[k];
+          b[k] = B[i + k * N] - B_centroid[k];
+      }
+      for (int j = 0; j < D; j++)
+      {
+          for (int k = 0; k < D; k++)
+          {
+              H[j][k] += weight * a[j] * b[k];
+          }
+      }
+  }
+  double rotation[3][3];
+  optimal_rotation (H, D, rotation);
+  for (int k = 0; k < D; k++)
+  {
+      T[k] = B_centroid[k];
+      for (int j = 0; j < D; j++)
+      {
+          R[j + k * D] = rotation[j][k];
+          T[k] -= A_centroid[j] * rotation[j][k];
+      }
+  }
+  // deviations of the paired points after the transformation, which needs
+  // no translation since both configurations are centered
+  double deviation = 0;
+  for (octave_idx_type i = 0; i < N; i++)
+  {
+      double squared = 0;
+      for (int k = 0; k < D; k++)
+      {
+          double e = B_centroid[k] - B[i + k * N];
+          for (int j = 0; j < D; j++)
+          {
+              e += (A[i + j * N] - A_centroid[j]) * rotation[j][k];
+          }
+          squared += e * e;
+      }
+      point_dev[i] = std::sqrt (squared);
+      deviation += (w ? w[i] : 1) * point_dev[i];
+  }
+  return deviation / total;
+}
+
+DEFUN_DLD (Kabsch, args, ,
+          "-*- texinfo -*-\n\
+@deftypefn{Loadable function} [R, T, LRMSD, point_dev] = Kabsch(@var{A}, @var{B})\n\
+@deftypefnx{Loadable function} [R, T, LRMSD, point_dev] = Kabsch(@var{A}, @var{B}, @var{property}, @var{value})\n\
+\n\
+\n\
+Example: [R, T, LRMSD, point_dev] = Kabsch(A, B)\n\
+\n\
+\n\
+This function computes the rotation matrix R and the translation vector T,\n\
+which transform the point configuration A to the paired point configuration\n\
+B with the least root mean squared deviation (Kabsch algorithm), so that\n\
+A * R + T is closest to B. Both configurations are NxD matrices with the D\n\
+coordinates of the same N points in the same rows, where D is 2 or 3 and\n\
+there are at least D points.\n\
+\n\
+The rotation is computed in closed form from the covariance of both\n\
+configurations translated to their centroids: in 3 dimensions from the unit\n\
+quaternion of Horn's method, and in 2 dimensions from the angle of the\n\
+rotation. It is always a proper rotation, i.e. reflections are excluded.\n\
+\n\
+R is DxD and T is 1xD. LRMSD returns the mean distance between the paired\n\
+points after the transformation, and point_dev the Nx1 distances of each\n\
+pair.\n\
+\n\
+A and B may also be NxDxK arrays of K pairs of configurations, which are\n\
+aligned in parallel, in which case R is DxDxK, T is 1xDxK, LRMSD is Kx1 and\n\
+point_dev is NxK, so that A(:,:,k) * R(:,:,k) + T(:,:,k) is closest to\n\
+B(:,:,k). Optional property/value pairs may follow the configurations:\n\
+\n\
+@code{\"weights\"} gives the non-negative weights of the points as an Nx1\n\
+vector, shared by all pairs, or as an NxK matrix with the weights of each\n\
+pair in its columns. The centroids, the covariance and the mean deviation\n\
+LRMSD are then weighted. Default are equal weights.\n\
+\n\
+@code{\"threads\"} sets the number of threads aligning the pairs. A value\n\
+of 0 uses all available processors. Default is 1.\n\
+\n\
+Example: [R, T, LRMSD] = Kabsch(A, B, \"weights\", w, \"threads\", 0)\n\
+@end deftypefn")
+{
+
+  // Check for a valid number of input arguments
+  if (args.length() < 2 || args.length() % 2 != 0)
+  {
+      std::cout << "Invalid number of input arguments.\n";
+      return octave_value_list();
+  }
+  if (! args(0).is_matrix_type() || ! args(1).is_matrix_type())
+  {
+      std::cout << "A and B should be real matrices.\n";
+      return octave_value_list();
+  }
+  dim_vector dims = args(0).dims();
+  if (dims.ndims() > 3 || args(1).dims().ndims() != dims.ndims())
+  {
+      std::cout << "A and B should be NxD matrices or NxDxK arrays.\n";
+      return octave_value_list();
+  }
+  for (int k = 0; k < dims.ndims(); k++)
+  {
+      if (args(1).dims()(k) != dims(k))
+      {
+          std::cout << "A and B should be of the same size.\n";
+          return octave_value_list();
+      }
+  }
+  octave_idx_type N = dims(0);
+  int D = dims(1);
+  octave_idx_type K = dims.ndims() > 2 ? dims(2) : 1;
+  if (D < 2 || D > 3)
+  {
+      std::cout << "Points should have 2 or 3 dimensions.\n";
+      return octave_value_list();
+  }
+  if (N < D)
+  {
+      std::cout << "There should be at least as many paired points as space dimensions.\n";
+      return octave_value_list();
+  }
+  int num_threads = 1;
+  NDArray weights;
+  bool weighted = false;
+  for (int i = 2; i < args.length(); i += 2)
+  {
+      std::string property = args(i).is_string() ? args(i).string_value() : "";
+      if (property == "threads" && args(i+1).is_real_scalar())
+      {
+          num_threads = args(i+1).int_value();
+          if (num_threads < 1)
+          {
+              num_threads = std::thread::hardware_concurrency();
+          }
+          num_threads = std::max (num_threads, 1);
+      }
+      else if (property == "weights" && args(i+1).is_matrix_type()
+               && args(i+1).rows() == N && args(i+1).dims().ndims() == 2
+               && (args(i+1).columns() == 1 || args(i+1).columns() == K))
+      {
+          weights = args(i+1).array_value();
+          weighted = true;
+      }
+      else
+      {
+          std::cout << "Invalid property or value in input arguments.\n";
+          return octave_value_list();
+      }
+  }
+  for (octave_idx_type i = 0; i < weights.numel(); i++)
+  {
+      if (! (weights(i) >= 0))
+      {
+          std::cout << "Weights should be non-negative with a positive sum.\n";
+          return octave_value_list();
+      }
+  }
+  const NDArray A = args(0).array_value();
+  const NDArray B = args(1).array_value();
+  NDArray R (dim_vector (D, D, K));
+  NDArray T (dim_vector (1, D, K));
+  Matrix LRMSD (K, 1);
+  Matrix point_dev (N, K);
+  const double *A_data = A.data();
+  const double *B_data = B.data();
+  const double *w_data = weighted ? weights.data() : 0;
+  octave_idx_type w_stride = weighted && weights.columns() > 1 ? N : 0;
+  double *R_data = R.fortran_vec();
+  double *T_data = T.fortran_vec();
+  double *LRMSD_data = LRMSD.fortran_vec();
+  double *point_dev_data = point_dev.fortran_vec();
+  // every pair is aligned on its own, into its own slices of the outputs
+  run_tasks (K, num_threads, [&] (size_t k)
+  {
+    LRMSD_data[k] = align (A_data + k * N * D, B_data + k * N * D,
+                           w_data ? w_data + k * w_stride : 0, N, D,
+                           R_data + k * D * D, T_data + k * D,
+                           point_dev_data + k * N);
+  });
+  for (octave_idx_type k = 0; k < K; k++)
+  {
+      if (LRMSD(k,0) < 0)
+      {
+          std::cout << "Weights should be non-negative with a positive sum.\n";
+          return octave_value_list();
+      }
+  }
+  octave_value_list retval;
+  retval(0) = R;
+  retval(1) = T;
+  retval(2) = LRMSD;
+  retval(3) = point_dev;
+  return retval;
+}
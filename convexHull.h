@@ -0,0 +1,597 @@
+/*
+Copyright (C) 2018-2020 Andreas Bertsatos <abertsatos@biol.uoa.gr>
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free Software
+Foundation; either version 3 of the License, or (at your option) any later
+version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+details.
+
+You should have received a copy of the GNU General Public License along with
+this program; if not, see <http://www.gnu.org/licenses/>.
+*/
+
+#if ! defined (convexHull_h)
+#define convexHull_h 1
+
+// Convex hull of a point cloud by quickhull, used by meshDiameter to reduce
+// the vertices of a mesh to the few on its hull.  Points within a tolerance
+// of the hull, scaled to the coordinates, count as inside, so only vertices
+// of the hull which stand out of it by more than rounding are kept.
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include <octave/oct.h>
+
+#include "meshThreads.h"
+
+class ConvexHull
+{
+public:
+  // points in the rows of the column-major rows x 3 matrix V, which is
+  // read in place
+  ConvexHull (const double *V, octave_idx_type rows)
+    : V (V), rows (rows), tolerance (0), visit (0)
+  {
+    center[0] = center[1] = center[2] = 0;
+  }
+
+  // build the hull.  The hull of the points extreme in 26 directions
+  // encloses most points of a mesh, which are discarded by a single pass
+  // with num_threads threads, and the hull is then expanded towards the
+  // remaining points.  Returns false if all points lie on a plane, which
+  // has no hull with volume
+  bool build (int num_threads)
+  {
+    faces.clear ();
+    visit_mark.clear ();
+    std::vector<octave_idx_type> seeds = extreme_points (num_threads);
+    bool seeded = initial_tetrahedron (seeds);
+    if (! seeded)
+    {
+        // the extreme points lie on a plane, but the others may not
+        seeds.resize (rows);
+        for (octave_idx_type i = 0; i < rows; i++)
+        {
+            seeds[i] = i;
+        }
+        if (! initial_tetrahedron (seeds))
+        {
+            return false;
+        }
+    }
+    expand ();
+    if (seeded)
+    {
+        partition (num_threads);
+        expand ();
+    }
+    return true;
+  }
+
+  // indices of the vertices of the hull in ascending order
+  std::vector<octave_idx_type> vertices () const
+  {
+    std::vector<octave_idx_type> result;
+    for (size_t f = 0; f < faces.size (); f++)
+    {
+        if (! faces[f].removed)
+        {
+            result.insert (result.end (), faces[f].v, faces[f].v + 3);
+        }
+    }
+    std::sort (result.begin (), result.end ());
+    result.erase (std::unique (result.begin (), result.end ()), result.end ());
+    return result;
+  }
+
+private:
+  // triangle of the hull with its vertices in counterclockwise order seen
+  // from outside, the faces across its edges v[k] v[k+1], its outward unit
+  // normal and the points in front of it
+  struct Face
+  {
+    octave_idx_type v[3];
+    int neighbor[3];
+    double normal[3];
+    double offset;
+    std::vector<octave_idx_type> outside;
+    bool removed;
+  };
+
+  // coordinates of point i relative to the center of the bounding box,
+  // which keeps the plane offsets of the faces small
+  void point (octave_idx_type i, double p[3]) const
+  {
+    for (int k = 0; k < 3; k++)
+    {
+        p[k] = V[i + k * rows] - center[k];
+    }
+  }
+
+  double distance (const Face& face, octave_idx_type i) const
+  {
+    double p[3];
+    point (i, p);
+    return face.normal[0] * p[0] + face.normal[1] * p[1]
+           + face.normal[2] * p[2] - face.offset;
+  }
+
+  int add_face (octave_idx_type a, octave_idx_type b, octave_idx_type c)
+  {
+    Face face;
+    face.v[0] = a;
+    face.v[1] = b;
+    face.v[2] = c;
+    face.neighbor[0] = face.neighbor[1] = face.neighbor[2] = -1;
+    face.removed = false;
+    double pa[3], pb[3], pc[3];
+    point (a, pa);
+    point (b, pb);
+    point (c, pc);
+    double ab[3], ac[3];
+    for (int k = 0; k < 3; k++)
+    {
+        ab[k] = pb[k] - pa[k];
+        ac[k] = pc[k] - pa[k];
+    }
+    face.normal[0] = ab[1] * ac[2] - ab[2] * ac[1];
+    face.normal[1] = ab[2] * ac[0] - ab[0] * ac[2];
+    face.normal[2] = ab[0] * ac[1] - ab[1] * ac[0];
+    double length = std::sqrt (face.normal[0] * face.normal[0]
+                               + face.normal[1] * face.normal[1]
+                               + face.normal[2] * face.normal[2]);
+    for (int k = 0; k < 3; k++)
+    {
+        face.normal[k] = length > 0 ? face.normal[k] / length : 0;
+    }
+    face.offset = face.normal[0] * pa[0] + face.normal[1] * pa[1]
+                  + face.normal[2] * pa[2];
+    faces.push_back (face);
+    visit_mark.push_back (0);
+    return faces.size () - 1;
+  }
+
+  // points with the lowest and the highest projection on each of 13
+  // directions, the lowest indices among equal projections, found by
+  // num_threads threads.  The extremes of the axes set the center of the
+  // bounding box and the tolerance
+  std::vector<octave_idx_type> extreme_points (int num_threads)
+  {
+    static const double directions[13][3] = {
+      {1, 0, 0}, {0, 1, 0}, {0, 0, 1}, {1, 1, 0}, {1, -1, 0}, {1, 0, 1},
+      {1, 0, -1}, {0, 1, 1}, {0, 1, -1}, {1, 1, 1}, {1, 1, -1}, {1, -1, 1},
+      {-1, 1, 1}};
+    const octave_idx_type block = 1 << 16;
+    size_t num_blocks = (rows + block - 1) / block;
+    // lowest and highest point of each direction in each block
+    std::vector<octave_idx_type> extremes (26 * num_blocks);
+    auto projection = [this] (octave_idx_type i, int d)
+    {
+      return directions[d][0] * V[i] + directions[d][1] * V[i + rows]
+             + directions[d][2] * V[i + 2 * rows];
+    };
+    run_tasks (num_blocks, num_threads, [&] (size_t b)
+    {
+      octave_idx_type begin = b * block;
+      octave_idx_type end = std::min (rows, begin + block);
+      octave_idx_type *extreme = &extremes[26 * b];
+      double lo[13], hi[13];
+      for (int d = 0; d < 13; d++)
+      {
+          extreme[2 * d] = extreme[2 * d + 1] = begin;
+          lo[d] = hi[d] = projection (begin, d);
+      }
+      for (octave_idx_type i = begin + 1; i < end; i++)
+      {
+          for (int d = 0; d < 13; d++)
+          {
+              double x = projection (i, d);
+              if (x < lo[d])
+              {
+                  lo[d] = x;
+                  extreme[2 * d] = i;
+              }
+              if (x > hi[d])
+              {
+                  hi[d] = x;
+                  extreme[2 * d + 1] = i;
+              }
+          }
+      }
+    });
+    std::vector<octave_idx_type> result (extremes.begin (),
+                                         extremes.begin () + 26);
+    for (size_t b = 1; b < num_blocks; b++)
+    {
+        for (int d = 0; d < 13; d++)
+        {
+            octave_idx_type i = extremes[26 * b + 2 * d];
+            if (projection (i, d) < projection (result[2 * d], d))
+            {
+                result[2 * d] = i;
+            }
+            i = extremes[26 * b + 2 * d + 1];
+            if (projection (i, d) > projection (result[2 * d + 1], d))
+            {
+                result[2 * d + 1] = i;
+            }
+        }
+    }
+    double scale = 0;
+    for (int k = 0; k < 3; k++)
+    {
+        double lo = V[result[2 * k] + k * rows];
+        double hi = V[result[2 * k + 1] + k * rows];
+        center[k] = (lo + hi) / 2;
+        scale += std::max (std::abs (lo), std::abs (hi));
+    }
+    tolerance = 3 * std::numeric_limits<double>::epsilon () * scale;
+    std::sort (result.begin (), result.end ());
+    result.erase (std::unique (result.begin (), result.end ()), result.end ());
+    return result;
+  }
+
+  // tetrahedron of the given points, whose faces receive the points in
+  // front of them.  Returns false if the points have no volume
+  bool initial_tetrahedron (const std::vector<octave_idx_type>& points)
+  {
+    // the point farthest from the first one, the point farthest from the
+    // line between them, and the point farthest from their plane
+    octave_idx_type a = points[0];
+    octave_idx_type b = a;
+    double ab_length = 0;
+    for (size_t i = 1; i < points.size (); i++)
+    {
+        double d = squared_distance (a, points[i]);
+        if (d > ab_length)
+        {
+            b = points[i];
+            ab_length = d;
+        }
+    }
+    if (std::sqrt (ab_length) <= tolerance)
+    {
+        return false;
+    }
+    double pa[3], pb[3], u[3];
+    point (a, pa);
+    point (b, pb);
+    for (int k = 0; k < 3; k++)
+    {
+        u[k] = pb[k] - pa[k];
+    }
+    octave_idx_type c = a;
+    double c_distance = 0;
+    for (size_t i = 0; i < points.size (); i++)
+    {
+        double w[3], n[3];
+        point (points[i], w);
+        for (int k = 0; k < 3; k++)
+        {
+            w[k] -= pa[k];
+        }
+        n[0] = u[1] * w[2] - u[2] * w[1];
+        n[1] = u[2] * w[0] - u[0] * w[2];
+        n[2] = u[0] * w[1] - u[1] * w[0];
+        double d = n[0] * n[0] + n[1] * n[1] + n[2] * n[2];
+        if (d > c_distance)
+        {
+            c = points[i];
+            c_distance = d;
+        }
+    }
+    if (c_distance == 0)
+    {
+        return false;
+    }
+    int base = add_face (a, b, c);
+    octave_idx_type d = a;
+    double height = 0;
+    for (size_t i = 0; i < points.size (); i++)
+    {
+        double h = distance (faces[base], points[i]);
+        if (std::abs (h) > std::abs (height))
+        {
+            d = points[i];
+            height = h;
+        }
+    }
+    faces.clear ();
+    visit_mark.clear ();
+    if (std::abs (height) <= tolerance)
+    {
+        return false;
+    }
+    // orient the faces outwards, so that d lies behind the base
+    if (height > 0)
+    {
+        std::swap (b, c);
+    }
+    add_face (a, b, c);
+    add_face (b, a, d);
+    add_face (c, b, d);
+    add_face (a, c, d);
+    for (int f = 0; f < 4; f++)
+    {
+        for (int k = 0; k < 3; k++)
+        {
+            octave_idx_type from = faces[f].v[k];
+            octave_idx_type to = faces[f].v[(k + 1) % 3];
+            for (int g = 0; g < 4; g++)
+            {
+                for (int m = 0; m < 3; m++)
+                {
+                    if (faces[g].v[m] == to && faces[g].v[(m + 1) % 3] == from)
+                    {
+                        faces[f].neighbor[k] = g;
+                    }
+                }
+            }
+        }
+    }
+    for (size_t i = 0; i < points.size (); i++)
+    {
+        for (int f = 0; f < 4; f++)
+        {
+            if (distance (faces[f], points[i]) > tolerance)
+            {
+                faces[f].outside.push_back (points[i]);
+                break;
+            }
+        }
+    }
+    return true;
+  }
+
+  // assign every point to the first face of the hull it is in front of,
+  // in blocks which are concatenated in order.  The greatest height of the
+  // points above the faces is found in chunks, face by face, which the
+  // compiler turns into vector instructions, and only the few points in
+  // front of some face are searched for the first one
+  void partition (int num_threads)
+  {
+    std::vector<int> live;
+    std::vector<double> plane;
+    for (size_t f = 0; f < faces.size (); f++)
+    {
+        if (! faces[f].removed)
+        {
+            live.push_back (f);
+            plane.insert (plane.end (), faces[f].normal, faces[f].normal + 3);
+            plane.push_back (faces[f].offset);
+        }
+    }
+    const octave_idx_type block = 1 << 16;
+    size_t num_blocks = (rows + block - 1) / block;
+    std::vector<std::vector<octave_idx_type>> outside (live.size () * num_blocks);
+    run_tasks (num_blocks, num_threads, [&] (size_t b)
+    {
+      const int chunk = 256;
+      double x[chunk], y[chunk], z[chunk], height[chunk];
+      octave_idx_type end = std::min (rows, octave_idx_type ((b + 1) * block));
+      for (octave_idx_type begin = b * block; begin < end; begin += chunk)
+      {
+          int n = std::min (octave_idx_type (chunk), end - begin);
+          for (int i = 0; i < chunk; i++)
+          {
+              octave_idx_type j = begin + std::min (i, n - 1);
+              x[i] = V[j] - center[0];
+              y[i] = V[j + rows] - center[1];
+              z[i] = V[j + 2 * rows] - center[2];
+              height[i] = -tolerance;
+          }
+          for (size_t f = 0; f < live.size (); f++)
+          {
+              double nx = plane[4 * f];
+              double ny = plane[4 * f + 1];
+              double nz = plane[4 * f + 2];
+              double offset = plane[4 * f + 3];
+              for (int i = 0; i < chunk; i++)
+              {
+                  double h = nx * x[i] + ny * y[i] + nz * z[i] - offset;
+                  height[i] = h > height[i] ? h : height[i];
+              }
+          }
+          for (int i = 0; i < n; i++)
+          {
+              if (height[i] <= tolerance)
+              {
+                  continue;
+              }
+              for (size_t f = 0; f < live.size (); f++)
+              {
+                  if (distance (faces[live[f]], begin + i) > tolerance)
+                  {
+                      outside[live.size () * b + f].push_back (begin + i);
+                      break;
+                  }
+              }
+          }
+      }
+    });
+    for (size_t b = 0; b < num_blocks; b++)
+    {
+        for (size_t f = 0; f < live.size (); f++)
+        {
+            std::vector<octave_idx_type>& points = outside[live.size () * b + f];
+            faces[live[f]].outside.insert (faces[live[f]].outside.end (),
+                                           points.begin (), points.end ());
+        }
+    }
+  }
+
+  // expand the hull towards the farthest outside point of each face
+  void expand ()
+  {
+    std::vector<int> pending;
+    for (size_t f = 0; f < faces.size (); f++)
+    {
+        if (! faces[f].removed && ! faces[f].outside.empty ())
+        {
+            pending.push_back (f);
+        }
+    }
+    while (! pending.empty ())
+    {
+        int f = pending.back ();
+        pending.pop_back ();
+        if (faces[f].removed || faces[f].outside.empty ())
+        {
+            continue;
+        }
+        add_point (f, pending);
+    }
+  }
+
+  // replace the faces visible from the farthest outside point of face f by
+  // a cone of faces from the point to their horizon
+  void add_point (int f, std::vector<int>& pending)
+  {
+    visit++;
+    const Face& start = faces[f];
+    octave_idx_type eye = start.outside[0];
+    double farthest = distance (start, eye);
+    for (size_t i = 1; i < start.outside.size (); i++)
+    {
+        double d = distance (start, start.outside[i]);
+        if (d > farthest)
+        {
+            eye = start.outside[i];
+            farthest = d;
+        }
+    }
+    // the connected faces visible from the eye and the edges of their
+    // horizon, each with the hidden face across it
+    visible.assign (1, f);
+    stack.assign (1, f);
+    horizon.clear ();
+    hidden.clear ();
+    visit_mark[f] = visit;
+    while (! stack.empty ())
+    {
+        int g = stack.back ();
+        stack.pop_back ();
+        for (int k = 0; k < 3; k++)
+        {
+            int h = faces[g].neighbor[k];
+            if (visit_mark[h] == visit)
+            {
+                continue;
+            }
+            if (distance (faces[h], eye) > tolerance)
+            {
+                visit_mark[h] = visit;
+                visible.push_back (h);
+                stack.push_back (h);
+            }
+            else
+            {
+                horizon.push_back (faces[g].v[k]);
+                horizon.push_back (faces[g].v[(k + 1) % 3]);
+                hidden.push_back (h);
+            }
+        }
+    }
+    // the cone, whose faces are linked to the hidden faces and to each
+    // other through the shared vertices of the horizon
+    cone.clear ();
+    for (size_t e = 0; e < hidden.size (); e++)
+    {
+        octave_idx_type a = horizon[2 * e];
+        octave_idx_type b = horizon[2 * e + 1];
+        int g = add_face (a, b, eye);
+        int h = hidden[e];
+        faces[g].neighbor[0] = h;
+        for (int k = 0; k < 3; k++)
+        {
+            if (faces[h].v[k] == b && faces[h].v[(k + 1) % 3] == a)
+            {
+                faces[h].neighbor[k] = g;
+            }
+        }
+        cone.push_back (g);
+    }
+    for (size_t e = 0; e < cone.size (); e++)
+    {
+        Face& g = faces[cone[e]];
+        for (size_t i = 0; i < cone.size (); i++)
+        {
+            if (faces[cone[i]].v[0] == g.v[1])
+            {
+                g.neighbor[1] = cone[i];
+            }
+            if (faces[cone[i]].v[1] == g.v[0])
+            {
+                g.neighbor[2] = cone[i];
+            }
+        }
+    }
+    // hand the outside points of the visible faces to the cone
+    for (size_t i = 0; i < visible.size (); i++)
+    {
+        Face& g = faces[visible[i]];
+        g.removed = true;
+        for (size_t j = 0; j < g.outside.size (); j++)
+        {
+            octave_idx_type p = g.outside[j];
+            if (p == eye)
+            {
+                continue;
+            }
+            for (size_t e = 0; e < cone.size (); e++)
+            {
+                if (distance (faces[cone[e]], p) > tolerance)
+                {
+                    faces[cone[e]].outside.push_back (p);
+                    break;
+                }
+            }
+        }
+        std::vector<octave_idx_type> ().swap (g.outside);
+    }
+    for (size_t e = 0; e < cone.size (); e++)
+    {
+        if (! faces[cone[e]].outside.empty ())
+        {
+            pending.push_back (cone[e]);
+        }
+    }
+  }
+
+  double squared_distance (octave_idx_type a, octave_idx_type b) const
+  {
+    double p[3], q[3];
+    point (a, p);
+    point (b, q);
+    double d = 0;
+    for (int k = 0; k < 3; k++)
+    {
+        d += (p[k] - q[k]) * (p[k] - q[k]);
+    }
+    return d;
+  }
+
+  const double *V;
+  octave_idx_type rows;
+  double center[3];
+  double tolerance;
+  std::vector<Face> faces;
+  std::vector<int> visit_mark;
+  int visit;
+  // buffers of add_point
+  std::vector<int> visible;
+  std::vector<int> stack;
+  std::vector<octave_idx_type> horizon;
+  std::vector<int> hidden;
+  std::vector<int> cone;
+};
+
+#endif
@@ -50,14 +50,12 @@ function [varargout] = longbone_Scaling(varargin)
   % which are also saved in @var{scale(1,[1:4])}, when output variable is declared by
   % calling the function as @var{scale} = longbone_Scaling.
   %
-  % The present function requires the 'statistics', 'geometry' and 'io' packages installed.
-  % It also relies on 'longbone_maxDistance.m', 'readObj', 'readMtl.m', 'writeObj',
-  % 'writeMtl.m', 'write_MeshlabPoints.m' and 'meshBarycenter' functions available at
+  % The present function requires the 'io' package installed.
+  % It also relies on 'longbone_maxDistance.m', 'meshDiameter', 'readObj', 'readMtl.m',
+  % 'writeObj', 'writeMtl.m', 'write_MeshlabPoints.m' and 'meshBarycenter' functions available at
   % @url{https://github.com/pr0m1th3as/wavefront-obj-mesh-package}.
 
   % load required packages
-  pkg load statistics
-  pkg load geometry
   pkg load io;
   
   % check for valid number of input variables
@@ -105,7 +103,7 @@ function [varargout] = longbone_Scaling(varargin)
     % scale mesh
     v = v * ratio;
     % save scaled model
-    writeObj(v,f,vt,ft,vn,fn,filename);
+    writeObj(v,f,vt,ft,vn,fn,filename,"ifexists","overwrite");
     mtl = readMtl(name);
     filenameMTL = filename([1:length(filename)-4]);
     extension = ".mtl";
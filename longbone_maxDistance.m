@@ -14,8 +14,8 @@
 % this program; if not, see <http://www.gnu.org/licenses/>.
 %
 %
-function [varargout] = longbone_maxDistance(v)
-  % function [maxDistance, maxD_v1, maxD_v2] = longbone_maxDistance(v)
+function [varargout] = longbone_maxDistance(v, epsilon)
+  % function [maxDistance, maxD_v1, maxD_v2] = longbone_maxDistance(v, epsilon)
   %
   % This function calculates the maximum distance of a long bone as represented
   % by its mesh vertices. It requires an Nx3 matrix as input argument, which
@@ -38,58 +38,21 @@ function [varargout] = longbone_maxDistance(v)
   %
   %     e.g. [maxDistance, maxD_v1, maxD_v2] = longbone_maxDistance(v)
   %
-  % The function requires the 'geometry' and 'statistics' packages to be loaded.
+  % The maximum distance is exact. It is computed by the 'meshDiameter' oct-file
+  % between the vertices of the convex hull of the mesh. If the optional second
+  % argument is given, an approximate distance within a factor of (1 - epsilon)
+  % of the exact one is computed in a single pass over the vertices instead.
+  %
+  %     e.g. maxDistance = longbone_maxDistance(v, 0.01)
   
-  % find the extreme vertices of the mesh for each axis
-  [w,iw] = min(v);
-  for i=1:3
-    extreme_V(i,:) = v(iw(i),:);
-    extreme_Vi(i) = iw(i);
-  endfor
-  [w,iw] = max(v);
-  for i=1:3
-    extreme_V(i+3,:) = v(iw(i),:);
-    extreme_Vi(i+3) = iw(i);
-  endfor
-
-  % find max distance between pair of vertices
-  d = squareform(pdist(extreme_V));
-  max_d = max(max(d));
-  % find corresponding vertices
-  [q1, q2] = find(d==max_d);
-  % check if indices match
-  if q1(1)==q2(2) && q1(2)==q2(1)
-    maxd_V1 = extreme_V(q1(1),:);
-    maxd_V2 = extreme_V(q1(2),:);
+  % find the most distant pair of vertices
+  if (nargin > 1)
+    [max_d, iw1, iw2] = meshDiameter(v, "epsilon", epsilon);
   else
-    printf("There is something wrong! Check your input data.");
+    [max_d, iw1, iw2] = meshDiameter(v);
   endif
-  % find vertices that lie outside the boundaries of initial most distant vertices
-  % iterate three times to ensure that maximum distance is found
-  len = distancePoints(maxd_V1,v);
-  [w,iw1] = max(len);
-  maxd_V2 = v(iw1,:);
-  max_d = distancePoints(maxd_V1, maxd_V2);
-  len = distancePoints(maxd_V2,v);
-  [w,iw2] = max(len);
-  maxd_V1 = v(iw2,:);
-  max_d = distancePoints(maxd_V1, maxd_V2);
-  len = distancePoints(maxd_V1,v);
-  [w,iw1] = max(len);
-  maxd_V2 = v(iw1,:);
-  max_d = distancePoints(maxd_V1, maxd_V2);
-  len = distancePoints(maxd_V2,v);
-  [w,iw2] = max(len);
-  maxd_V1 = v(iw2,:);
-  max_d = distancePoints(maxd_V1, maxd_V2);
-  len = distancePoints(maxd_V1,v);
-  [w,iw1] = max(len);
-  maxd_V2 = v(iw1,:);
-  max_d = distancePoints(maxd_V1, maxd_V2);
-  len = distancePoints(maxd_V2,v);
-  [w,iw2] = max(len);
-  maxd_V1 = v(iw2,:);
-  max_d = distancePoints(maxd_V1, maxd_V2);
+  maxd_V1 = v(iw1,:);
+  maxd_V2 = v(iw2,:);
   if (nargout==0)
     printf("Bone maximum distance is %f and is found between vertices %d and %d.\n",...
             max_d, iw1, iw2);
@@ -0,0 +1,119 @@
+/*
+Copyright (C) 2018-2020 Andreas Bertsatos <abertsatos@biol.uoa.gr>
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free Software
+Foundation; either version 3 of the License, or (at your option) any later
+version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+details.
+
+You should have received a copy of the GNU General Public License along with
+this program; if not, see <http://www.gnu.org/licenses/>.
+*/
+
+#if ! defined (mappedFile_h)
+#define mappedFile_h 1
+
+// Memory mapped input files, which are shared by the obj, ply and stl readers.
+
+#include <string>
+#include <fstream>
+#include <iterator>
+#if ! defined (_WIN32)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+#include <octave/oct.h>
+
+// read-only view of a whole mesh file, which is mapped into memory so that
+// it can be scanned in place without copying it into a buffer
+class MappedFile
+{
+public:
+  MappedFile () : data (0), size (0), mtime (0) { }
+  ~MappedFile () { close (); }
+
+  bool open (const std::string& filename)
+  {
+#if defined (_WIN32)
+    std::ifstream inputFile (filename.c_str (), std::ios::binary);
+    if (! inputFile)
+      return false;
+    buffer.assign (std::istreambuf_iterator<char> (inputFile),
+                   std::istreambuf_iterator<char> ());
+    data = buffer.data ();
+    size = buffer.size ();
+    return true;
+#else
+    int fd = ::open (filename.c_str (), O_RDONLY);
+    if (fd < 0)
+      return false;
+    struct stat st;
+    if (fstat (fd, &st) != 0 || ! S_ISREG (st.st_mode))
+    {
+      ::close (fd);
+      return false;
+    }
+    size = st.st_size;
+    mtime = st.st_mtime;
+    if (size > 0)
+    {
+      void *addr = mmap (0, size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (addr == MAP_FAILED)
+      {
+        ::close (fd);
+        size = 0;
+        return false;
+      }
+      madvise (addr, size, MADV_SEQUENTIAL);
+      data = static_cast<const char *> (addr);
+    }
+    ::close (fd);
+    return true;
+#endif
+  }
+
+  void close ()
+  {
+#if ! defined (_WIN32)
+    if (data && size > 0)
+      munmap (const_cast<char *> (data), size);
+#endif
+    data = 0;
+    size = 0;
+  }
+
+  const char *data;
+  size_t size;
+  double mtime;
+
+private:
+#if defined (_WIN32)
+  std::string buffer;
+#endif
+};
+
+// drop the already scanned pages in [begin, end) of the mapped file from
+// the resident set, so that memory usage is dominated by the output arrays
+// rather than by the mapped file
+static inline void release_pages (const char *begin, const char *end)
+{
+#if ! defined (_WIN32)
+  static const size_t page_size = sysconf (_SC_PAGESIZE);
+  size_t first = (reinterpret_cast<size_t> (begin) + page_size - 1)
+                 / page_size * page_size;
+  size_t last = reinterpret_cast<size_t> (end) / page_size * page_size;
+  if (last > first)
+    madvise (reinterpret_cast<void *> (first), last - first, MADV_DONTNEED);
+#endif
+}
+// number of scanned bytes after which their pages are released
+static const octave_idx_type release_interval = 16 << 20;
+
+#endif
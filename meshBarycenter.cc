@@ -17,24 +17,20 @@ this program; if not, see <http://www.gnu.org/licenses/>.
 
 #include <iostream>
 #include <string>
-#include <fstream>
+#include <thread>
+#include <utility>
 #include <vector>
 #include <octave/oct.h>
-#include <octave/parse.h>
-
-struct Coord
-{
-	    double x, y, z;
-};
-struct Area
-{
-      double a;
-};  
+#include "meshIndex.h"
+#include "meshCentroid.h"
+#include "meshThreads.h"
 
 
 DEFUN_DLD (meshBarycenter, args, nargout, 
           "-*- texinfo -*-\n\
 @deftypefn{Loadable function} COORDINATES = meshBarycenter(@var{input_arguments})\n\
+@deftypefnx{Loadable function} [COORDINATES, WEIGHT] = meshBarycenter(@var{input_arguments})\n\
+@deftypefnx{Loadable function} COORDINATES = meshBarycenter(@var{vertex_cell}, @var{face_cell})\n\
 \n\
 \n\
 Example: A = meshBarycenter(Vertices, Faces)\n\
@@ -43,154 +39,171 @@ Example: A = meshBarycenter(Vertices, Faces)\n\
 This function computes the 3D coordinates of the polygon barycenter of a\n\
 triangular 3D Mesh based on its vertices and faces provided as input arguments.\n\
 \n\
-The function will only take two input arguments. The first argument should\n\
+The function takes two input arguments. The first argument should\n\
 be an Nx3 matrix containing the 3-dimensional coordinates of each vertex and\n\
 the second argument should be an Nx3 matrix with each row containing the three\n\
 vertices that form each face of the triangular mesh. The face matrix should\n\
 contain explicitly non-zero integers referring to the existing vertices present\n\
 in the first input argument\n\
+\n\
+The face matrix may be of class double, int32, uint32 or int64, as returned by\n\
+@code{readObj} with the @code{\"indexclass\"} option, and integer indices are\n\
+read in place without conversion.\n\
+\n\
+The barycenter is computed in a single pass over the faces with compensated\n\
+double precision summation, so its accuracy does not degrade with the size of\n\
+the mesh. Optional property/value pairs may follow the faces:\n\
+\n\
+@code{\"mode\"} selects the barycenter. \"faces\" returns the mean of the\n\
+centroids of the faces, which depends on how densely each region of the mesh\n\
+is tessellated. \"area\" returns the centroid of the surface, with each face\n\
+weighted by its area. \"volume\" returns the centroid of the solid enclosed\n\
+by a closed mesh, computed from the signed volumes of the tetrahedra between\n\
+each face and a common vertex (divergence theorem). Default is \"faces\".\n\
+\n\
+@code{\"threads\"} sets the number of threads summing the faces. The faces\n\
+are summed in fixed blocks, which are combined in order, so the result is\n\
+identical for any number of threads. A value of 0 uses all available\n\
+processors. Default is 1.\n\
+\n\
+The optional second output argument returns the number of faces, the surface\n\
+area or the enclosed volume, respectively. The volume is negative if the\n\
+faces are oriented with their normals pointing inwards.\n\
+\n\
+Example: [C, volume] = meshBarycenter(V, F, \"mode\", \"volume\", \"threads\", 0)\n\
+\n\
+The vertices and faces may also be given as two cell arrays with the same\n\
+number of meshes, in which case the barycenters of all meshes are computed in\n\
+one call and returned as the rows of an Nx3 matrix, with their weights in an\n\
+Nx1 vector. The blocks of faces of all meshes are shared among the threads,\n\
+so a batch of meshes of very different sizes keeps every thread busy, and\n\
+each row is identical to the barycenter of the mesh computed on its own.\n\
+\n\
+Example: C = meshBarycenter(@{V1, V2, V3@}, @{F1, F2, F3@}, \"threads\", 0)\n\
 @end deftypefn")
 {
 
   // count the number of input arguments and store their values
   // into the appropriate variables
   // check for invalid number of input arguments
-  if (args.length() != 2)
+  if (args.length() < 2 || args.length() % 2 != 0)
   {
     std::cout << "Invalid number of input arguments.\n";
     return octave_value_list();
   }
-  // check for both arguments being real matrices
-  if (!args(0).is_matrix_type() || !args(1).is_matrix_type())
-  {
-    std::cout << "Both input arguments should be real matrices.\n";
-    return octave_value_list();
-  }
-  // store vertices and faces in vectors
-  Matrix V = args(0).array_value();
-  Matrix F = args(1).array_value();
-  // find number of vertices and faces
-  octave_idx_type V_rows = args(0).rows();
-  octave_idx_type F_rows = args(1).rows();
-  octave_idx_type V_columns = args(0).columns();
-  octave_idx_type F_columns = args(1).columns();
-  // ensure that there are at least 3 vertices and one face in the mesh and
-  // vertex and face matrices are Nx3 in size
-  if (V_rows < 3)
+  int mode = CENTROID_FACES;
+  int num_threads = 1;
+  for (int i = 2; i < args.length(); i += 2)
   {
-    std::cout << "There should be at least 3 vertices in the mesh.\n";
-    return octave_value_list();
-  }
-  if (V_columns != 3)
-  {
-    std::cout << "Vertex matrix should be Nx3 containing x,y,z coordinates.\n";
-    return octave_value_list();
+    std::string property = args(i).is_string() ? args(i).string_value() : "";
+    std::string value = args(i+1).is_string() ? args(i+1).string_value() : "";
+    if (property == "mode" && centroid_mode_value (value) >= 0)
+    {
+      mode = centroid_mode_value (value);
+    }
+    else if (property == "threads" && args(i+1).is_real_scalar())
+    {
+      num_threads = args(i+1).int_value();
+      if (num_threads < 1)
+      {
+        num_threads = std::thread::hardware_concurrency();
+      }
+      if (num_threads < 1)
+      {
+        num_threads = 1;
+      }
+    }
+    else
+    {
+      std::cout << "Invalid property or value in input arguments.\n";
+      return octave_value_list();
+    }
   }
-  if (F_rows < 1)
+  // a single mesh is given as two matrices and a batch of meshes as two
+  // cell arrays of matrices
+  bool batch = args(0).iscell() && args(1).iscell();
+  Cell V_cell = batch ? args(0).cell_value() : Cell (args(0));
+  Cell F_cell = batch ? args(1).cell_value() : Cell (args(1));
+  octave_idx_type num_meshes = V_cell.numel();
+  if (V_cell.numel() != F_cell.numel())
   {
-    std::cout << "There should be at least 1 face in the mesh.\n";
+    std::cout << "Vertex and face cell arrays should have the same number of meshes.\n";
     return octave_value_list();
   }
-  if (F_columns != 3)
+  std::vector<MeshCentroid> meshes;
+  meshes.reserve (num_meshes);
+  for (octave_idx_type i = 0; i < num_meshes; i++)
   {
-    std::cout << "Face matrix should be Nx3 containing three vertices.\n";
-    return octave_value_list();
+    std::string error = check_mesh(V_cell(i), F_cell(i));
+    if (!error.empty())
+    {
+      if (batch)
+      {
+        std::cout << "Mesh " << i + 1 << ": ";
+      }
+      std::cout << error << "\n";
+      return octave_value_list();
+    }
+    meshes.push_back (MeshCentroid (V_cell(i).array_value(), IndexView (F_cell(i)),
+                                    mode));
   }
-  // define matrices for storing vertex coordinates
-  std::vector<Coord> vertex_A;
-  std::vector<Coord> vertex_B;
-  std::vector<Coord> vertex_C;
-  // define matrix for storing barycenter coordinates for each triangular face
-  std::vector<Coord> face_barycenter;
-  // define a vector for storing face area
-  std::vector<Area> face_area;
-  //
-  //
-  // loop through every face of the mesh and create three vectors with the
-  // corresponding vertex coordinates of each face
-  for (octave_idx_type i = 0; i < F_rows; i++)
+  // interleave the vertices of every mesh, then sum the blocks of faces of
+  // all meshes as one pool of tasks, so that the threads stay busy however
+  // much the sizes of the meshes differ
+  run_tasks (meshes.size (), num_threads,
+             [&] (size_t i) { meshes[i].prepare (); });
+  std::vector<std::pair<size_t, size_t>> blocks;
+  for (size_t i = 0; i < meshes.size (); i++)
   {
-    // define variables for the vertices of each face
-    int vert_idx_A, vert_idx_B, vert_idx_C;
-    // define variables for the coordinates of each vertex
-    float tmpx, tmpy, tmpz;
-    // store the vertex indexes
-    vert_idx_A = F(i,0) - 1;
-    vert_idx_B = F(i,1) - 1;
-    vert_idx_C = F(i,2) - 1;
-    // store the coordinates of the first vertex
-    tmpx = V(vert_idx_A,0);
-    tmpy = V(vert_idx_A,1);
-    tmpz = V(vert_idx_A,2);
-    Coord temp_vertex_A = {tmpx, tmpy, tmpz};
-    vertex_A.push_back(temp_vertex_A);
-    // store the coordinates of the second vertex
-    tmpx = V(vert_idx_B,0);
-    tmpy = V(vert_idx_B,1);
-    tmpz = V(vert_idx_B,2);
-    Coord temp_vertex_B = {tmpx, tmpy, tmpz};
-    vertex_B.push_back(temp_vertex_B);
-    // store the coordinates of the third vertex
-    tmpx = V(vert_idx_C,0);
-    tmpy = V(vert_idx_C,1);
-    tmpz = V(vert_idx_C,2);
-    Coord temp_vertex_C = {tmpx, tmpy, tmpz};
-    vertex_C.push_back(temp_vertex_C);
+    for (size_t j = 0; j < meshes[i].num_blocks (); j++)
+    {
+      blocks.push_back (std::make_pair (i, j));
+    }
   }
-  // loop through every face of the mesh and calculate barycenter coordinates
-  // of each triangle along with its area
-  for(octave_idx_type i = 0; i < F_rows; i++)
+  run_tasks (blocks.size (), num_threads, [&] (size_t b)
   {
-    // define variables for the coordinates of each vertex
-    float tmpx, tmpy, tmpz;
-    // compute barycenter coordinates, i.e. centroid of face triangle
-    tmpx = (vertex_A[i].x + vertex_B[i].x + vertex_C[i].x) / 3;
-    tmpy = (vertex_A[i].y + vertex_B[i].y + vertex_C[i].y) / 3;
-    tmpz = (vertex_A[i].z + vertex_B[i].z + vertex_C[i].z) / 3;
-    Coord centroid = {tmpx, tmpy, tmpz};
-    face_barycenter.push_back(centroid);
-    // compute area of triangular face
-    // calculate vector AB and AC
-    Coord vec_AB = {vertex_B[i].x - vertex_A[i].x, vertex_B[i].y
-                      - vertex_A[i].y, vertex_B[i].z - vertex_A[i].z};
-    Coord vec_AC = {vertex_C[i].x - vertex_A[i].x, vertex_C[i].y
-                      - vertex_A[i].y, vertex_C[i].z - vertex_A[i].z};
-    // calculate ABxAC cross product
-    tmpx = vec_AB.y*vec_AC.z - vec_AB.z*vec_AC.y;
-    tmpy = vec_AB.z*vec_AC.x - vec_AB.x*vec_AC.z;
-    tmpz = vec_AB.x*vec_AC.y - vec_AB.y*vec_AC.x;
-    float temp_a = 0.5*sqrt(tmpx*tmpx + tmpy*tmpy + tmpz*tmpz);
-    Area temp_area = {temp_a};
-    face_area.push_back(temp_area);
-  }
-  // calculate the barycenter of the mesh as the weighted average of the
-  // barycenter coordinates (centroids) of the face triangles weighted by
-  // their corresponding area
-  Matrix mesh_barycenter (1, 3);
-  for(octave_idx_type i = 0; i < F_rows; i++)
+    meshes[blocks[b].first].sum_block (blocks[b].second);
+  });
+  // compute the barycenter of each mesh along with the total weight of its
+  // faces
+  Matrix mesh_barycenter (num_meshes, 3);
+  Matrix mesh_weight (num_meshes, 1);
+  for (octave_idx_type i = 0; i < num_meshes; i++)
   {
-    mesh_barycenter(0,0) += face_barycenter[i].x;// * face_area[i].a;
-    mesh_barycenter(0,1) += face_barycenter[i].y;// * face_area[i].a;
-    mesh_barycenter(0,2) += face_barycenter[i].z;// * face_area[i].a;
+    double centroid[3];
+    double weight = 0;
+    std::string error = meshes[i].result (centroid, weight);
+    if (!error.empty())
+    {
+      if (batch)
+      {
+        std::cout << "Mesh " << i + 1 << ": ";
+      }
+      std::cout << error << "\n";
+      return octave_value_list();
+    }
+    for (int k = 0; k < 3; k++)
+    {
+      mesh_barycenter(i,k) = centroid[k];
+    }
+    mesh_weight(i,0) = weight;
   }
-  // divide by the total number of faces
-  mesh_barycenter(0,0) = mesh_barycenter(0,0) / F_rows;
-  mesh_barycenter(0,1) = mesh_barycenter(0,1) / F_rows;
-  mesh_barycenter(0,2) = mesh_barycenter(0,2) / F_rows;
   // define return value list
   octave_value_list retval;
-  
-  if (nargout == 1)
+  if (nargout == 0)
   {
-      retval(0) = mesh_barycenter;
+    for (octave_idx_type i = 0; i < num_meshes; i++)
+    {
+      std::cout << "Mesh barycentric coordinates are: x=" << mesh_barycenter(i,0)
+                << "  y=" << mesh_barycenter(i,1) << "  z=" << mesh_barycenter(i,2)
+                << "\n";
+    }
+    return octave_value_list();
   }
-  else
+  retval(0) = mesh_barycenter;
+  if (nargout >= 2)
   {
-      std::cout << "Mesh barycentric coordinates are: x=" << mesh_barycenter(0,0) 
-                << "  y=" << mesh_barycenter(0,1) << "  z=" << mesh_barycenter(0,2) 
-                << "\n";
-      return octave_value_list();
+    retval(1) = mesh_weight;
   }
-  return retval; 
-
+  return retval;
 }
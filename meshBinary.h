@@ -0,0 +1,349 @@
+/*
+Copyright (C) 2018-2020 Andreas Bertsatos <abertsatos@biol.uoa.gr>
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free Software
+Foundation; either version 3 of the License, or (at your option) any later
+version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+details.
+
+You should have received a copy of the GNU General Public License along with
+this program; if not, see <http://www.gnu.org/licenses/>.
+*/
+
+#if ! defined (meshBinary_h)
+#define meshBinary_h 1
+
+// Records of binary little endian PLY and binary STL files, which are shared
+// by readPly, writePly, readStl and writeStl.  Records are read and written
+// with memcpy, so the files are only supported on little endian machines.
+
+#include <string>
+#include <vector>
+#include <sstream>
+#include <cstring>
+#include <cstdint>
+
+#include <octave/oct.h>
+
+// whether the machine stores numbers in little endian byte order, as the
+// binary PLY and STL files do
+static inline bool little_endian_host ()
+{
+  const uint16_t one = 1;
+  return *reinterpret_cast<const unsigned char *> (&one) == 1;
+}
+
+// scalar property types of a PLY file
+enum PlyType
+{
+      PLY_INVALID, PLY_INT8, PLY_UINT8, PLY_INT16, PLY_UINT16, PLY_INT32,
+      PLY_UINT32, PLY_FLOAT32, PLY_FLOAT64
+};
+
+// property type with the given name, in either its old or its sized form
+static inline int ply_type_value (const std::string& name)
+{
+  if (name == "char" || name == "int8")
+    return PLY_INT8;
+  if (name == "uchar" || name == "uint8")
+    return PLY_UINT8;
+  if (name == "short" || name == "int16")
+    return PLY_INT16;
+  if (name == "ushort" || name == "uint16")
+    return PLY_UINT16;
+  if (name == "int" || name == "int32")
+    return PLY_INT32;
+  if (name == "uint" || name == "uint32")
+    return PLY_UINT32;
+  if (name == "float" || name == "float32")
+    return PLY_FLOAT32;
+  if (name == "double" || name == "float64")
+    return PLY_FLOAT64;
+  return PLY_INVALID;
+}
+
+// size in bytes of a property of the given type
+static inline int ply_type_size (int type)
+{
+  static const int sizes[] = {0, 1, 1, 2, 2, 4, 4, 4, 8};
+  return sizes[type];
+}
+
+// load a little endian property value of the given type
+template <typename T>
+static inline T load_ply (const char *p)
+{
+  T value;
+  memcpy (&value, p, sizeof (T));
+  return value;
+}
+
+static inline double load_ply_value (const char *p, int type)
+{
+  switch (type)
+  {
+    case PLY_INT8:
+      return load_ply<int8_t> (p);
+    case PLY_UINT8:
+      return load_ply<uint8_t> (p);
+    case PLY_INT16:
+      return load_ply<int16_t> (p);
+    case PLY_UINT16:
+      return load_ply<uint16_t> (p);
+    case PLY_INT32:
+      return load_ply<int32_t> (p);
+    case PLY_UINT32:
+      return load_ply<uint32_t> (p);
+    case PLY_FLOAT32:
+      return load_ply<float> (p);
+    default:
+      return load_ply<double> (p);
+  }
+}
+
+static inline int64_t load_ply_index (const char *p, int type)
+{
+  switch (type)
+  {
+    case PLY_INT8:
+      return load_ply<int8_t> (p);
+    case PLY_UINT8:
+      return load_ply<uint8_t> (p);
+    case PLY_INT16:
+      return load_ply<int16_t> (p);
+    case PLY_UINT16:
+      return load_ply<uint16_t> (p);
+    case PLY_INT32:
+      return load_ply<int32_t> (p);
+    case PLY_UINT32:
+      return load_ply<uint32_t> (p);
+    case PLY_FLOAT32:
+      return load_ply<float> (p);
+    default:
+      return load_ply<double> (p);
+  }
+}
+
+// scalar or list property of a PLY element
+struct PlyProperty
+{
+  std::string name;
+  int type;
+  // type of the item count of list properties, or PLY_INVALID for scalars
+  int count_type;
+};
+
+struct PlyElement
+{
+  std::string name;
+  octave_idx_type count;
+  std::vector<PlyProperty> properties;
+
+  // position of the named property, or -1 if the element has none
+  int find (const std::string& property) const
+  {
+    for (size_t i = 0; i < properties.size (); i++)
+    {
+        if (properties[i].name == property)
+        {
+            return i;
+        }
+    }
+    return -1;
+  }
+
+  // size in bytes of each record, or -1 if the element has list properties
+  // and its records vary in size
+  int stride () const
+  {
+    int size = 0;
+    for (size_t i = 0; i < properties.size (); i++)
+    {
+        if (properties[i].count_type != PLY_INVALID)
+        {
+            return -1;
+        }
+        size += ply_type_size (properties[i].type);
+    }
+    return size;
+  }
+
+  // byte offset of the given property within each record, which is only
+  // meaningful for fixed size records
+  int offset (int property) const
+  {
+    int size = 0;
+    for (int i = 0; i < property; i++)
+    {
+        size += ply_type_size (properties[i].type);
+    }
+    return size;
+  }
+
+  // size in bytes of the record starting at p, which may hold lists, or 0
+  // if the record does not end before end
+  size_t record_size (const char *p, const char *end) const
+  {
+    size_t size = 0;
+    for (size_t i = 0; i < properties.size (); i++)
+    {
+        if (properties[i].count_type == PLY_INVALID)
+        {
+            size += ply_type_size (properties[i].type);
+            continue;
+        }
+        if (p + size + ply_type_size (properties[i].count_type) > end)
+        {
+            return 0;
+        }
+        int64_t n = load_ply_index (p + size, properties[i].count_type);
+        if (n < 0)
+        {
+            return 0;
+        }
+        size += ply_type_size (properties[i].count_type)
+                + n * ply_type_size (properties[i].type);
+    }
+    return p + size <= end ? size : 0;
+  }
+};
+
+// parse the header of a binary little endian PLY file held in [data,
+// data + size) into its elements and the offset of the first record.
+// Returns an error message, which is empty on success
+static inline std::string parse_ply_header (const char *data, size_t size,
+                                            std::vector<PlyElement>& elements,
+                                            size_t& header_size)
+{
+  const char *p = data;
+  const char *file_end = data + size;
+  if (size < 4 || memcmp (data, "ply", 3) != 0)
+  {
+      return "File is not a PLY file.";
+  }
+  bool binary = false;
+  while (p < file_end)
+  {
+      const char *line_end = static_cast<const char *>
+                             (memchr (p, '\n', file_end - p));
+      if (! line_end)
+      {
+          break;
+      }
+      std::string line (p, line_end);
+      if (! line.empty () && line[line.length () - 1] == '\r')
+      {
+          line.erase (line.length () - 1);
+      }
+      p = line_end + 1;
+      std::istringstream tokens (line);
+      std::string keyword;
+      tokens >> keyword;
+      if (keyword == "format")
+      {
+          std::string format;
+          tokens >> format;
+          if (format != "binary_little_endian")
+          {
+              return "Only binary little endian PLY files are supported.";
+          }
+          binary = true;
+      }
+      else if (keyword == "element")
+      {
+          PlyElement element;
+          double count = -1;
+          tokens >> element.name >> count;
+          if (count < 0)
+          {
+              return "Invalid element in PLY header.";
+          }
+          element.count = count;
+          elements.push_back (element);
+      }
+      else if (keyword == "property")
+      {
+          PlyProperty property;
+          std::string type;
+          tokens >> type;
+          property.count_type = PLY_INVALID;
+          if (type == "list")
+          {
+              std::string count_type;
+              tokens >> count_type >> type;
+              property.count_type = ply_type_value (count_type);
+              if (property.count_type == PLY_INVALID)
+              {
+                  return "Invalid property in PLY header.";
+              }
+          }
+          property.type = ply_type_value (type);
+          tokens >> property.name;
+          if (property.type == PLY_INVALID || elements.empty ())
+          {
+              return "Invalid property in PLY header.";
+          }
+          elements.back ().properties.push_back (property);
+      }
+      else if (keyword == "end_header")
+      {
+          if (! binary)
+          {
+              return "PLY header does not specify a binary format.";
+          }
+          header_size = p - data;
+          return "";
+      }
+  }
+  return "PLY header is incomplete.";
+}
+
+// output arguments of a reader in the forms of readObj: V and F, followed
+// by VT and FT if the mesh has texture coordinates or else by VN and FN for
+// four or five outputs, or by VT, FT, VN and FN for six or seven outputs.
+// An odd number of outputs ends with the material library, which binary
+// files do not refer to, so it is returned empty
+static inline octave_value_list mesh_outputs (int nargout,
+                                              const octave_value& V,
+                                              const octave_value& F,
+                                              const octave_value& VT,
+                                              const octave_value& FT,
+                                              const octave_value& VN,
+                                              const octave_value& FN,
+                                              bool texture)
+{
+  octave_value_list retval;
+  retval(0) = V;
+  retval(1) = F;
+  int count = 2;
+  if (nargout == 4 || nargout == 5)
+  {
+      retval(count++) = texture ? VT : VN;
+      retval(count++) = texture ? FT : FN;
+  }
+  else if (nargout >= 6)
+  {
+      retval(count++) = VT;
+      retval(count++) = FT;
+      retval(count++) = VN;
+      retval(count++) = FN;
+  }
+  if (nargout % 2 == 1)
+  {
+      retval(count) = "";
+  }
+  return retval;
+}
+
+// binary STL files hold an 80 byte header, a 32 bit triangle count and a 50
+// byte record per triangle, made of its normal and its three vertices as
+// single precision numbers and a 16 bit attribute
+static const size_t stl_header_size = 84;
+static const size_t stl_record_size = 50;
+
+#endif
@@ -0,0 +1,407 @@
+/*
+Copyright (C) 2018-2020 Andreas Bertsatos <abertsatos@biol.uoa.gr>
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free Software
+Foundation; either version 3 of the License, or (at your option) any later
+version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+details.
+
+You should have received a copy of the GNU General Public License along with
+this program; if not, see <http://www.gnu.org/licenses/>.
+*/
+
+#if ! defined (meshCentroid_h)
+#define meshCentroid_h 1
+
+// Centroids of triangular meshes, shared by meshBarycenter and the other
+// functions measuring meshes.  Every face adds its weighted centroid and its
+// weight to compensated sums in a single pass, which is split into fixed
+// blocks of faces.  The blocks are summed by any number of threads and
+// combined in order, so the result does not depend on the thread count.
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+// SIMD kernels are compiled for AVX2 by GCC and Clang on x86 processors
+// whatever the build flags, and are used if the processor supports them
+#if (defined (__GNUC__) || defined (__clang__)) \
+    && (defined (__x86_64__) || defined (__i386__))
+#define MESH_SIMD 1
+#define MESH_TARGET_AVX2 __attribute__ ((target ("avx2")))
+#define MESH_TARGET_AVX2_LOOP __attribute__ ((target ("avx2"), flatten))
+#include <immintrin.h>
+#endif
+
+#include <octave/oct.h>
+
+#include "meshIndex.h"
+
+// centroid of the mesh: the mean of the face centroids, the centroid of its
+// surface, whose faces are weighted by their area, or the centroid of the
+// enclosed solid, made of the tetrahedra between each face and an origin
+enum CentroidMode {CENTROID_FACES, CENTROID_AREA, CENTROID_VOLUME};
+
+// centroid mode with the given name, or -1 if it is not supported
+static inline int centroid_mode_value (const std::string& name)
+{
+  if (name == "faces")
+    return CENTROID_FACES;
+  if (name == "area")
+    return CENTROID_AREA;
+  if (name == "volume")
+    return CENTROID_VOLUME;
+  return -1;
+}
+
+// add x to the compensated sum, whose rounding error is kept in error
+// (Kahan summation).  The error is subtracted from the next addend, so that
+// the sum stays accurate to the last bit regardless of the number of faces
+static inline void kahan_add (double& sum, double& error, double x)
+{
+  double y = x - error;
+  double t = sum + y;
+  error = (t - sum) - y;
+  sum = t;
+}
+
+// compensated sums of the weighted x, y and z coordinates of the face
+// centroids and of their weights
+struct CentroidSum
+{
+  double sum[4];
+  double error[4];
+
+  CentroidSum ()
+  {
+    for (int k = 0; k < 4; k++)
+    {
+        sum[k] = error[k] = 0;
+    }
+  }
+
+  void add (const CentroidSum& other)
+  {
+    for (int k = 0; k < 4; k++)
+    {
+        kahan_add (sum[k], error[k], other.sum[k]);
+        kahan_add (sum[k], error[k], -other.error[k]);
+    }
+  }
+
+  double value (int k) const
+  {
+    return sum[k] - error[k];
+  }
+};
+
+// whether the SIMD kernels may run on this processor
+static inline bool simd_supported ()
+{
+#if defined (MESH_SIMD)
+  static const bool avx2 = __builtin_cpu_supports ("avx2");
+  return avx2;
+#else
+  return false;
+#endif
+}
+
+// check that the vertices and faces of a mesh are real Nx3 matrices with at
+// least 3 vertices and one face.  Returns an error message, which is empty
+// on success
+static inline std::string check_mesh (const octave_value& V,
+                                      const octave_value& F)
+{
+  if (! V.is_matrix_type () || ! F.is_matrix_type ())
+    return "Vertices and faces should be real matrices.";
+  if (V.rows () < 3)
+    return "There should be at least 3 vertices in the mesh.";
+  if (V.columns () != 3)
+    return "Vertex matrix should be Nx3 containing x,y,z coordinates.";
+  if (F.rows () < 1)
+    return "There should be at least 1 face in the mesh.";
+  if (F.columns () != 3)
+    return "Face matrix should be Nx3 containing three vertices.";
+  return "";
+}
+
+// vertices relative to the origin, interleaved as x, y, z triplets, so that
+// each vertex of a face is gathered from a single cache line instead of one
+// per column of the vertex matrix.  The array is padded, so that four
+// doubles may be loaded from the last vertex
+static inline std::vector<double> interleave_vertices (const double *V,
+                                                       octave_idx_type V_rows,
+                                                       const double *origin)
+{
+  std::vector<double> xyz (3 * V_rows + 1);
+  for (octave_idx_type i = 0; i < V_rows; i++)
+  {
+      for (int k = 0; k < 3; k++)
+      {
+          xyz[3 * i + k] = V[i + k * V_rows] - origin[k];
+      }
+  }
+  return xyz;
+}
+
+// add the weighted centroid of a face and its weight to the sums
+struct ScalarCentroid
+{
+  static inline void add (CentroidSum& s, const double *pa, const double *pb,
+                          const double *pc, double weight)
+  {
+    for (int k = 0; k < 3; k++)
+    {
+        kahan_add (s.sum[k], s.error[k], (pa[k] + pb[k] + pc[k]) * weight);
+    }
+    kahan_add (s.sum[3], s.error[3], weight);
+  }
+};
+
+#if defined (MESH_SIMD)
+// the four sums of a face added at once, in the same order of operations as
+// ScalarCentroid, so that both give identical results
+struct SimdCentroid
+{
+  MESH_TARGET_AVX2
+  static inline void add (CentroidSum& s, const double *pa, const double *pb,
+                          const double *pc, double weight)
+  {
+    // the fourth lane of the loaded vertices belongs to the next vertex and
+    // is replaced by the weight
+    __m256d w = _mm256_set1_pd (weight);
+    __m256d x = _mm256_add_pd (_mm256_add_pd (_mm256_loadu_pd (pa),
+                                              _mm256_loadu_pd (pb)),
+                               _mm256_loadu_pd (pc));
+    x = _mm256_blend_pd (_mm256_mul_pd (x, w), w, 8);
+    __m256d sum = _mm256_loadu_pd (s.sum);
+    __m256d y = _mm256_sub_pd (x, _mm256_loadu_pd (s.error));
+    __m256d t = _mm256_add_pd (sum, y);
+    _mm256_storeu_pd (s.error, _mm256_sub_pd (_mm256_sub_pd (t, sum), y));
+    _mm256_storeu_pd (s.sum, t);
+  }
+};
+#endif
+
+// add the faces [begin, end) to the centroid sums with the Kernel adding
+// each face.  Consecutive faces go to two independent compensated sums, so
+// that their additions overlap.  Nothing is stored per face.  Returns false
+// if a face refers to a missing vertex
+template <int mode, typename Kernel, typename T>
+static inline bool sum_centroid_faces (const std::vector<double>& xyz,
+                                       octave_idx_type V_rows, const T *F,
+                                       octave_idx_type F_rows,
+                                       octave_idx_type begin,
+                                       octave_idx_type end,
+                                       CentroidSum& total)
+{
+  const T *A = F;
+  const T *B = F + F_rows;
+  const T *C = F + 2 * F_rows;
+  CentroidSum sums[2];
+  for (octave_idx_type i = begin; i < end; i++)
+  {
+      size_t a = static_cast<octave_idx_type> (A[i]) - 1;
+      size_t b = static_cast<octave_idx_type> (B[i]) - 1;
+      size_t c = static_cast<octave_idx_type> (C[i]) - 1;
+      // indices below 1 wrap around to huge unsigned values
+      if (a >= size_t (V_rows) || b >= size_t (V_rows) || c >= size_t (V_rows))
+      {
+          return false;
+      }
+      const double *pa = &xyz[3 * a];
+      const double *pb = &xyz[3 * b];
+      const double *pc = &xyz[3 * c];
+      // twice the area of the face or six times the volume of the
+      // tetrahedron between the face and the origin
+      double weight = 1;
+      if (mode != CENTROID_FACES)
+      {
+          double ab[3], ac[3], n[3];
+          for (int k = 0; k < 3; k++)
+          {
+              ab[k] = pb[k] - pa[k];
+              ac[k] = pc[k] - pa[k];
+          }
+          n[0] = ab[1] * ac[2] - ab[2] * ac[1];
+          n[1] = ab[2] * ac[0] - ab[0] * ac[2];
+          n[2] = ab[0] * ac[1] - ab[1] * ac[0];
+          weight = mode == CENTROID_AREA
+                   ? std::sqrt (n[0] * n[0] + n[1] * n[1] + n[2] * n[2])
+                   : pa[0] * n[0] + pa[1] * n[1] + pa[2] * n[2];
+      }
+      Kernel::add (sums[i & 1], pa, pb, pc, weight);
+  }
+  total.add (sums[0]);
+  total.add (sums[1]);
+  return true;
+}
+
+#if defined (MESH_SIMD)
+// the face loop compiled for AVX2, with the kernel inlined into it
+template <int mode, typename T>
+MESH_TARGET_AVX2_LOOP
+static bool sum_centroid_faces_simd (const std::vector<double>& xyz,
+                                     octave_idx_type V_rows, const T *F,
+                                     octave_idx_type F_rows,
+                                     octave_idx_type begin, octave_idx_type end,
+                                     CentroidSum& total)
+{
+  return sum_centroid_faces<mode, SimdCentroid> (xyz, V_rows, F, F_rows,
+                                                 begin, end, total);
+}
+#endif
+
+// add the faces [begin, end) to the centroid sums, four sums at a time if
+// the processor supports AVX2.  Returns false if a face refers to a missing
+// vertex
+template <int mode, typename T>
+static inline bool sum_centroids (const std::vector<double>& xyz,
+                                  octave_idx_type V_rows, const T *F,
+                                  octave_idx_type F_rows, octave_idx_type begin,
+                                  octave_idx_type end, CentroidSum& total)
+{
+#if defined (MESH_SIMD)
+  if (simd_supported ())
+  {
+      return sum_centroid_faces_simd<mode> (xyz, V_rows, F, F_rows, begin, end,
+                                            total);
+  }
+#endif
+  return sum_centroid_faces<mode, ScalarCentroid> (xyz, V_rows, F, F_rows,
+                                                   begin, end, total);
+}
+
+// centroid of a mesh in one of the CentroidMode, whose faces are summed in
+// fixed blocks.  The blocks are independent tasks, which may be summed by
+// any thread in any order, and are combined in block order, so the result
+// does not depend on the number of threads.  The sums are taken relative to
+// the first vertex, which keeps the volume of meshes far from the coordinate
+// origin accurate
+class MeshCentroid
+{
+public:
+  MeshCentroid (const Matrix& V, const IndexView& F, int mode)
+    : V (V), F (F), mode (mode),
+      blocks ((F.rows () + block_rows - 1) / block_rows),
+      valid (blocks.size (), 1)
+  { }
+
+  // interleave the vertices, which must precede summing the blocks
+  void prepare ()
+  {
+    const double *data = V.data ();
+    octave_idx_type V_rows = V.rows ();
+    for (int k = 0; k < 3; k++)
+    {
+        origin[k] = data[k * V_rows];
+    }
+    xyz = interleave_vertices (data, V_rows, origin);
+  }
+
+  size_t num_blocks () const
+  {
+    return blocks.size ();
+  }
+
+  void sum_block (size_t i)
+  {
+    switch (F.index_class)
+    {
+      case INDEX_INT32:
+        sum_block (i, static_cast<const int32_t *> (F.data ()));
+        break;
+      case INDEX_UINT32:
+        sum_block (i, static_cast<const uint32_t *> (F.data ()));
+        break;
+      case INDEX_INT64:
+        sum_block (i, static_cast<const int64_t *> (F.data ()));
+        break;
+      default:
+        sum_block (i, static_cast<const double *> (F.data ()));
+    }
+  }
+
+  // combine the blocks into the centroid of the mesh and the total weight
+  // of its faces, i.e. their number, the surface area or the enclosed
+  // volume.  Returns an error message, which is empty on success
+  std::string result (double centroid[3], double& weight) const
+  {
+    CentroidSum total;
+    for (size_t i = 0; i < blocks.size (); i++)
+    {
+        if (! valid[i])
+        {
+            return "Faces refer to missing vertices.";
+        }
+        total.add (blocks[i]);
+    }
+    if (total.value (3) == 0)
+    {
+        return mode == CENTROID_VOLUME ? "Mesh encloses no volume."
+                                       : "Mesh has no area.";
+    }
+    // each face adds the sum of its three vertices, and each tetrahedron
+    // the sum of its four vertices, one of which is the origin
+    double vertices = mode == CENTROID_VOLUME ? 4 : 3;
+    for (int k = 0; k < 3; k++)
+    {
+        centroid[k] = total.value (k) / (vertices * total.value (3))
+                      + origin[k];
+    }
+    weight = total.value (3);
+    if (mode == CENTROID_AREA)
+    {
+        weight /= 2;
+    }
+    else if (mode == CENTROID_VOLUME)
+    {
+        weight /= 6;
+    }
+    return "";
+  }
+
+private:
+  static const octave_idx_type block_rows = 1 << 16;
+
+  template <typename T>
+  void sum_block (size_t i, const T *faces)
+  {
+    octave_idx_type begin = i * block_rows;
+    octave_idx_type end = std::min (F.rows (), begin + block_rows);
+    octave_idx_type V_rows = V.rows ();
+    switch (mode)
+    {
+      case CENTROID_AREA:
+        valid[i] = sum_centroids<CENTROID_AREA> (xyz, V_rows, faces, F.rows (),
+                                                 begin, end, blocks[i]);
+        break;
+      case CENTROID_VOLUME:
+        valid[i] = sum_centroids<CENTROID_VOLUME> (xyz, V_rows, faces,
+                                                   F.rows (), begin, end,
+                                                   blocks[i]);
+        break;
+      default:
+        valid[i] = sum_centroids<CENTROID_FACES> (xyz, V_rows, faces,
+                                                  F.rows (), begin, end,
+                                                  blocks[i]);
+    }
+  }
+
+  Matrix V;
+  IndexView F;
+  int mode;
+  double origin[3];
+  std::vector<double> xyz;
+  std::vector<CentroidSum> blocks;
+  std::vector<char> valid;
+};
+
+#endif
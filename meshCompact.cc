@@ -0,0 +1,174 @@
+/*
+Copyright (C) 2018-2020 Andreas Bertsatos <abertsatos@biol.uoa.gr>
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free Software
+Foundation; either version 3 of the License, or (at your option) any later
+version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+details.
+
+You should have received a copy of the GNU General Public License along with
+this program; if not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <octave/oct.h>
+#include "meshIndex.h"
+#include "meshCompact.h"
+
+
+DEFUN_DLD (meshCompact, args, nargout,
+          "-*- texinfo -*-\n\
+@deftypefn{Loadable function} [@var{v}, @var{f}, @dots{}, @var{map}] = meshCompact(@var{input_arguments})\n\
+\n\
+\n\
+Example: [V, F, map] = meshCompact(V, F, \"tolerance\", 1e-6)\n\
+\n\
+\n\
+This function compacts a triangular 3D Mesh by welding duplicate vertices and\n\
+dropping the vertices which are not referenced by any face.\n\
+\n\
+The function takes 2, 4 or 6 input matrices in the same order as\n\
+@code{writeObj}, i.e. the vertices and faces, optionally followed by texture\n\
+coordinates and texture faces and/or vertex normals and face normals. It\n\
+returns the compacted matrices in the same order, with the faces rewritten to\n\
+refer to the compacted rows and of the same class as the input faces.\n\
+\n\
+Texture coordinates and vertex normals are compacted along with their own\n\
+faces, but only identical rows are welded. The last output argument\n\
+@var{map} is a structure whose fields @var{v}, @var{vt} and @var{vn} hold the\n\
+new row of each old row of the corresponding matrix, or 0 for dropped rows.\n\
+\n\
+Vertices are welded through a spatial hash grid in time linear in the number\n\
+of vertices and faces. Each vertex is welded to the first preceding kept\n\
+vertex within the tolerance, so kept vertices retain their coordinates and\n\
+their relative order.\n\
+\n\
+Optional property/value pairs may follow the matrices:\n\
+\n\
+@code{\"tolerance\"} sets the largest distance between welded vertices.\n\
+Default is 0, which only welds vertices with identical coordinates.\n\
+\n\
+Example: [V, F, VT, FT, VN, FN, map] = meshCompact(V, F, VT, FT, VN, FN)\n\
+@end deftypefn")
+{
+
+  // count the number of input matrices, which are followed by optional
+  // property/value pairs
+  int num_args = 0;
+  while (num_args < args.length() && ! args(num_args).is_string())
+  {
+      num_args++;
+  }
+  if ((num_args != 2 && num_args != 4 && num_args != 6)
+      || (args.length() - num_args) % 2 != 0)
+  {
+      std::cout << "Invalid number of input arguments.\n";
+      return octave_value_list();
+  }
+  if (nargout > num_args + 1)
+  {
+      std::cout << "Invalid number of output arguments.\n";
+      return octave_value_list();
+  }
+  double tolerance = 0;
+  for (int i = num_args; i < args.length(); i += 2)
+  {
+      std::string property = args(i).is_string() ? args(i).string_value() : "";
+      if (property == "tolerance" && args(i+1).is_real_scalar()
+          && args(i+1).double_value() >= 0)
+      {
+          tolerance = args(i+1).double_value();
+      }
+      else
+      {
+          std::cout << "Invalid property or value in input arguments.\n";
+          return octave_value_list();
+      }
+  }
+  for (int i = 0; i < num_args; i++)
+  {
+      if (! args(i).is_matrix_type())
+      {
+          std::cout << "All input matrices should be real matrices.\n";
+          return octave_value_list();
+      }
+  }
+  // the vertices and faces are followed by texture coordinates and texture
+  // faces, by vertex normals and face normals, or by both
+  bool texture = num_args == 6 || (num_args == 4 && args(2).columns() == 2);
+  bool normals = num_args == 6 || (num_args == 4 && args(2).columns() == 3);
+  if (num_args == 4 && ! texture && ! normals)
+  {
+      std::cout << "Third input argument should be an Nx2 matrix with texture\n"
+                << "coordinates or an Nx3 matrix with vertex normals.\n";
+      return octave_value_list();
+  }
+  if (args(0).columns() != 3 || args(1).columns() != 3)
+  {
+      std::cout << "Vertex and face matrices should be Nx3.\n";
+      return octave_value_list();
+  }
+  if ((texture && (args(2).columns() != 2 || args(3).columns() != 3))
+      || (normals && (args(num_args-2).columns() != 3
+                      || args(num_args-1).columns() != 3)))
+  {
+      std::cout << "Texture coordinates should be Nx2, vertex normals and all\n"
+                << "face matrices Nx3.\n";
+      return octave_value_list();
+  }
+
+  // compact each element along with its faces
+  octave_value_list retval (nargout);
+  octave_scalar_map map;
+  static const char *const names[] = {"v", "vt", "vn"};
+  int element = 0;
+  for (int i = 0; i < num_args; i += 2)
+  {
+      Matrix M = args(i).array_value();
+      IndexView F (args(i+1));
+      std::vector<octave_idx_type> remap;
+      // texture coordinates and normals are only welded if identical
+      if (! compact_element (M, F, i == 0 ? tolerance : 0, remap))
+      {
+          std::cout << "Faces refer to missing rows of input argument "
+                    << i + 1 << ".\n";
+          return octave_value_list();
+      }
+      if (i > 0 && texture && element == 0)
+      {
+          element = 1;
+      }
+      else if (i > 0)
+      {
+          element = 2;
+      }
+      map.assign (names[element], remap_value (remap));
+      if (i < nargout)
+      {
+          retval(i) = M;
+      }
+      if (i + 1 < nargout)
+      {
+          retval(i+1) = compact_faces (F, remap);
+      }
+  }
+  for (int e = 0; e < 3; e++)
+  {
+      if (! map.isfield (names[e]))
+      {
+          map.assign (names[e], Matrix (0, 1));
+      }
+  }
+  if (nargout == num_args + 1)
+  {
+      retval(num_args) = map;
+  }
+  return retval;
+}
@@ -0,0 +1,353 @@
+/*
+Copyright (C) 2018-2020 Andreas Bertsatos <abertsatos@biol.uoa.gr>
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free Software
+Foundation; either version 3 of the License, or (at your option) any later
+version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+details.
+
+You should have received a copy of the GNU General Public License along with
+this program; if not, see <http://www.gnu.org/licenses/>.
+*/
+
+#if ! defined (meshCompact_h)
+#define meshCompact_h 1
+
+// Mesh compaction shared by meshCompact and writeObj.  The rows of an element
+// matrix which are referenced by its faces are welded within a tolerance
+// through a spatial hash grid, and all other rows are dropped, in time linear
+// in the number of rows and faces.
+
+#include <string>
+#include <vector>
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+
+#include <octave/oct.h>
+
+#include "meshIndex.h"
+
+// hash grid of the representative rows of the welded element, which are the
+// first rows found in each cluster.  The cells are twice as wide as the
+// tolerance, so the representatives within the tolerance of a row lie in the
+// 8 cells around the corner of its cell nearest to it.  With a zero
+// tolerance, the cells are the bit patterns of the coordinates themselves
+// and only identical rows are welded
+class WeldGrid
+{
+public:
+  WeldGrid (int columns, double tolerance)
+    : columns (columns), tolerance (tolerance), mask (1023)
+  {
+    slots.assign (mask + 1, -1);
+  }
+
+  // index of the earliest representative within the tolerance of the row x,
+  // which becomes a new representative if there is none
+  octave_idx_type insert (const double *x)
+  {
+    int64_t cell[3];
+    int side[3];
+    cell_of (x, cell, side);
+    // identical rows share their cell, which holds a single representative
+    octave_idx_type found = tolerance > 0 ? -1 : head (cell);
+    if (found >= 0)
+    {
+        return found;
+    }
+    for (int corner = 0; corner < 8; corner++)
+    {
+        int64_t neighbour[3];
+        bool skip = false;
+        for (int k = 0; k < 3; k++)
+        {
+            int d = (corner >> k) & 1 ? side[k] : 0;
+            neighbour[k] = cell[k] + d;
+            skip = skip || (d == 0 && (corner >> k) & 1);
+        }
+        if (skip || tolerance == 0)
+        {
+            continue;
+        }
+        for (octave_idx_type r = head (neighbour); r >= 0; r = next[r])
+        {
+            if ((found < 0 || r < found)
+                && within_tolerance (&points[3 * r], x))
+            {
+                found = r;
+            }
+        }
+    }
+    if (found >= 0)
+    {
+        return found;
+    }
+    // the new representative heads the list of its cell
+    octave_idx_type r = next.size ();
+    for (int k = 0; k < 3; k++)
+    {
+        points.push_back (k < columns ? x[k] : 0);
+        cells.push_back (cell[k]);
+    }
+    size_t slot = find_slot (cell);
+    next.push_back (slots[slot]);
+    slots[slot] = r;
+    if (next.size () * 2 > mask)
+    {
+        grow ();
+    }
+    return r;
+  }
+
+  octave_idx_type size () const
+  {
+    return next.size ();
+  }
+
+private:
+  // cell of the row x and, for each coordinate, the side of the nearest
+  // neighbouring cell, or 0 if no neighbour needs to be searched
+  void cell_of (const double *x, int64_t *cell, int *side) const
+  {
+    for (int k = 0; k < 3; k++)
+    {
+        double value = k < columns ? x[k] : 0;
+        side[k] = 0;
+        if (tolerance > 0)
+        {
+            double c = std::floor (value / (2 * tolerance));
+            bool valid = std::fabs (c) < 9e18;
+            cell[k] = valid ? int64_t (c) : 0;
+            if (valid && k < columns)
+            {
+                side[k] = value / (2 * tolerance) - c < 0.5 ? -1 : 1;
+            }
+        }
+        else
+        {
+            // negative zeros are welded with positive ones
+            value = value == 0 ? 0 : value;
+            memcpy (&cell[k], &value, sizeof (value));
+        }
+    }
+  }
+
+  bool within_tolerance (const double *p, const double *x) const
+  {
+    double distance = 0;
+    for (int k = 0; k < columns; k++)
+    {
+        distance += (p[k] - x[k]) * (p[k] - x[k]);
+    }
+    return distance <= tolerance * tolerance;
+  }
+
+  // neighbouring cells differ in few bits, so every coordinate is fully
+  // mixed before the next one is added
+  static size_t hash (const int64_t *cell)
+  {
+    uint64_t h = 0;
+    for (int k = 0; k < 3; k++)
+    {
+        h = (h ^ uint64_t (cell[k])) * 0xBF58476D1CE4E5B9ULL;
+        h = (h ^ (h >> 31)) * 0x94D049BB133111EBULL;
+        h ^= h >> 29;
+    }
+    return h;
+  }
+
+  // slot of the list of representatives of the cell, which is either
+  // occupied by the cell or empty
+  size_t find_slot (const int64_t *cell) const
+  {
+    size_t slot = hash (cell) & mask;
+    while (slots[slot] >= 0
+           && memcmp (&cells[3 * slots[slot]], cell, 3 * sizeof (int64_t)) != 0)
+    {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+  }
+
+  // first representative of the cell, or -1 if the cell is empty
+  octave_idx_type head (const int64_t *cell) const
+  {
+    return slots[find_slot (cell)];
+  }
+
+  // double the table once there are half as many representatives as slots,
+  // which bounds the number of occupied slots
+  void grow ()
+  {
+    mask = 2 * mask + 1;
+    slots.assign (mask + 1, -1);
+    std::vector<octave_idx_type> chain (next.size (), -1);
+    for (octave_idx_type r = 0; r < octave_idx_type (next.size ()); r++)
+    {
+        size_t slot = find_slot (&cells[3 * r]);
+        chain[r] = slots[slot];
+        slots[slot] = r;
+    }
+    next.swap (chain);
+  }
+
+  int columns;
+  double tolerance;
+  size_t mask;
+  std::vector<octave_idx_type> slots;
+  std::vector<octave_idx_type> next;
+  std::vector<double> points;
+  std::vector<int64_t> cells;
+};
+
+// compact the rows of the element matrix M referenced by the face index
+// array F.  remap receives the 0-based new row of each old row, or -1 for
+// dropped rows, and M is replaced by the compacted matrix.  Returns false if
+// a face refers to a missing row
+static inline bool compact_element (Matrix& M, const IndexView& F,
+                                    double tolerance,
+                                    std::vector<octave_idx_type>& remap)
+{
+  octave_idx_type rows = M.rows ();
+  int columns = M.columns ();
+  // mark the referenced rows
+  remap.assign (rows, -1);
+  for (octave_idx_type j = 0; j < F.columns (); j++)
+  {
+      for (octave_idx_type i = 0; i < F.rows (); i++)
+      {
+          octave_idx_type r = F(i,j) - 1;
+          if (r < 0 || r >= rows)
+          {
+              return false;
+          }
+          remap[r] = 0;
+      }
+  }
+  // weld the referenced rows in their original order
+  const double *data = M.data ();
+  WeldGrid grid (columns, tolerance);
+  std::vector<octave_idx_type> kept;
+  for (octave_idx_type r = 0; r < rows; r++)
+  {
+      if (remap[r] < 0)
+      {
+          continue;
+      }
+      double x[3] = {0, 0, 0};
+      for (int k = 0; k < columns; k++)
+      {
+          x[k] = data[r + k * rows];
+      }
+      octave_idx_type w = grid.insert (x);
+      if (w == octave_idx_type (kept.size ()))
+      {
+          kept.push_back (r);
+      }
+      remap[r] = w;
+  }
+  Matrix compacted (kept.size (), columns);
+  double *out = compacted.fortran_vec ();
+  octave_idx_type new_rows = kept.size ();
+  for (int k = 0; k < columns; k++)
+  {
+      for (octave_idx_type i = 0; i < new_rows; i++)
+      {
+          out[i + k * new_rows] = data[kept[i] + k * rows];
+      }
+  }
+  M = compacted;
+  return true;
+}
+
+template <typename T>
+static inline void remap_faces (const IndexView& F,
+                                const std::vector<octave_idx_type>& remap,
+                                T *out)
+{
+  octave_idx_type rows = F.rows ();
+  for (octave_idx_type j = 0; j < F.columns (); j++)
+  {
+      for (octave_idx_type i = 0; i < rows; i++)
+      {
+          out[i + j * rows] = remap[F(i,j) - 1] + 1;
+      }
+  }
+}
+
+// face index array of the same class as F referring to the compacted rows
+static inline octave_value compact_faces (const IndexView& F,
+                                          const std::vector<octave_idx_type>& remap)
+{
+  MeshArray faces;
+  faces.allocate (F.rows (), F.columns (), F.index_class);
+  switch (F.index_class)
+  {
+    case INDEX_INT32:
+      remap_faces (F, remap, static_cast<int32_t *> (faces.data ()));
+      break;
+    case INDEX_UINT32:
+      remap_faces (F, remap, static_cast<uint32_t *> (faces.data ()));
+      break;
+    case INDEX_INT64:
+      remap_faces (F, remap, static_cast<int64_t *> (faces.data ()));
+      break;
+    default:
+      remap_faces (F, remap, static_cast<double *> (faces.data ()));
+  }
+  return faces.value ();
+}
+
+// 1-based old-to-new map of the rows, with 0 for dropped rows
+static inline Matrix remap_value (const std::vector<octave_idx_type>& remap)
+{
+  Matrix map (remap.size (), 1);
+  for (size_t r = 0; r < remap.size (); r++)
+  {
+      map(r,0) = remap[r] + 1;
+  }
+  return map;
+}
+
+// compact the vertices, texture coordinates and vertex normals of a mesh
+// along with their faces, welding the vertices within the tolerance and
+// only identical texture coordinates and normals.  Returns an error
+// message, which is empty on success
+static inline std::string compact_mesh (Matrix& V, IndexView& F,
+                                        Matrix& VT, IndexView& FT,
+                                        Matrix& VN, IndexView& FN,
+                                        bool texture, bool normals,
+                                        double tolerance)
+{
+  std::vector<octave_idx_type> remap;
+  if (! compact_element (V, F, tolerance, remap))
+  {
+      return "Faces refer to missing vertices.";
+  }
+  F = IndexView (compact_faces (F, remap));
+  if (texture && ! compact_element (VT, FT, 0, remap))
+  {
+      return "Texture faces refer to missing texture coordinates.";
+  }
+  if (texture)
+  {
+      FT = IndexView (compact_faces (FT, remap));
+  }
+  if (normals && ! compact_element (VN, FN, 0, remap))
+  {
+      return "Face normals refer to missing vertex normals.";
+  }
+  if (normals)
+  {
+      FN = IndexView (compact_faces (FN, remap));
+  }
+  return "";
+}
+
+#endif
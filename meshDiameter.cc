@@ -0,0 +1,765 @@
+/*
+Copyright (C) 2018-2020 Andreas Bertsatos <abertsatos@biol.uoa.gr>
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free Software
+Foundation; either version 3 of the License, or (at your option) any later
+version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+details.
+
+You should have received a copy of the GNU General Public License along with
+this program; if not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <cmath>
+#include <utility>
+#include <octave/oct.h>
+#include "meshThreads.h"
+#include "convexHull.h"
+
+// pair of points at a squared distance, ordered so that i < j
+struct PointPair
+{
+  double squared;
+  octave_idx_type i;
+  octave_idx_type j;
+
+  PointPair (double squared = -1, octave_idx_type a = 0, octave_idx_type b = 0)
+    : squared (squared), i (std::min (a, b)), j (std::max (a, b))
+  { }
+
+  // farther pairs come first, and equally distant pairs in order of their
+  // indices, so the result does not depend on the order of the search
+  bool operator< (const PointPair& other) const
+  {
+    if (squared != other.squared)
+    {
+        return squared > other.squared;
+    }
+    return i != other.i ? i < other.i : j < other.j;
+  }
+};
+
+// farthest pair of a set of points by branch and bound over a k-d tree.
+// Pairs of nodes are pruned when the farthest corners of their bounding
+// boxes are closer than the farthest pair found, and the surviving pairs of
+// nodes near the root are searched in parallel, each from the lower bound
+// of a few farthest point iterations
+class FarthestPair
+{
+public:
+  // the points of V with the given row indices
+  FarthestPair (const Matrix& V, const std::vector<octave_idx_type>& indices)
+    : indices (indices), xyz (3 * indices.size ())
+  {
+    for (size_t a = 0; a < indices.size (); a++)
+    {
+        for (int k = 0; k < 3; k++)
+        {
+            xyz[3 * a + k] = V(indices[a],k);
+        }
+    }
+    std::vector<size_t> order (indices.size ());
+    for (size_t a = 0; a < order.size (); a++)
+    {
+        order[a] = a;
+    }
+    build (order, 0, order.size ());
+    // store the points in the order of the leaves
+    std::vector<double> sorted (xyz.size ());
+    std::vector<octave_idx_type> sorted_indices (order.size ());
+    for (size_t a = 0; a < order.size (); a++)
+    {
+        for (int k = 0; k < 3; k++)
+        {
+            sorted[3 * a + k] = xyz[3 * order[a] + k];
+        }
+        sorted_indices[a] = indices[order[a]];
+    }
+    xyz.swap (sorted);
+    this->indices.swap (sorted_indices);
+  }
+
+  PointPair search (int num_threads) const
+  {
+    // if all points coincide, no pair of nodes is ever pruned by the bound
+    // of the farthest pair, and every pair is at distance 0, so the result
+    // is the pair of the lowest indices
+    const Node& root = nodes[0];
+    if (root.lo[0] == root.hi[0] && root.lo[1] == root.hi[1]
+        && root.lo[2] == root.hi[2])
+    {
+        std::vector<octave_idx_type> lowest (indices);
+        size_t count = std::min (lowest.size (), size_t (2));
+        std::partial_sort (lowest.begin (), lowest.begin () + count,
+                           lowest.end ());
+        return PointPair (0, lowest[0], lowest[count - 1]);
+    }
+    // lower bound from the farthest point of the farthest point ...
+    PointPair known;
+    size_t from = 0;
+    for (int iteration = 0; iteration < 4; iteration++)
+    {
+        size_t to = from;
+        double farthest = -1;
+        for (size_t b = 0; b < indices.size (); b++)
+        {
+            double d = squared_distance (from, b);
+            if (d > farthest)
+            {
+                to = b;
+                farthest = d;
+            }
+        }
+        known = std::min (known, PointPair (farthest, indices[from],
+                                            indices[to]));
+        from = to;
+    }
+    // pairs of nodes a few levels below the root, as independent tasks
+    std::vector<int> level (1, 0);
+    for (int depth = 0; depth < 5; depth++)
+    {
+        std::vector<int> next;
+        for (size_t i = 0; i < level.size (); i++)
+        {
+            const Node& node = nodes[level[i]];
+            if (node.left < 0)
+            {
+                next.push_back (level[i]);
+            }
+            else
+            {
+                next.push_back (node.left);
+                next.push_back (node.right);
+            }
+        }
+        level.swap (next);
+    }
+    std::vector<std::pair<int, int>> tasks;
+    for (size_t i = 0; i < level.size (); i++)
+    {
+        for (size_t j = i; j < level.size (); j++)
+        {
+            tasks.push_back (std::make_pair (level[i], level[j]));
+        }
+    }
+    std::vector<PointPair> best (tasks.size (), known);
+    run_tasks (tasks.size (), num_threads, [&] (size_t t)
+    {
+      search (tasks[t].first, tasks[t].second, best[t]);
+    });
+    return *std::min_element (best.begin (), best.end ());
+  }
+
+private:
+  static const size_t leaf_size = 8;
+
+  // node of the tree with the bounding box of the points [begin, end) and
+  // its children, or -1 for a leaf
+  struct Node
+  {
+    double lo[3];
+    double hi[3];
+    size_t begin;
+    size_t end;
+    int left;
+    int right;
+  };
+
+  // build the subtree of the points order[begin, end), split at the median
+  // of the longest side of their bounding box
+  int build (std::vector<size_t>& order, size_t begin, size_t end)
+  {
+    Node node;
+    node.begin = begin;
+    node.end = end;
+    node.left = node.right = -1;
+    for (int k = 0; k < 3; k++)
+    {
+        node.lo[k] = node.hi[k] = xyz[3 * order[begin] + k];
+        for (size_t a = begin + 1; a < end; a++)
+        {
+            node.lo[k] = std::min (node.lo[k], xyz[3 * order[a] + k]);
+            node.hi[k] = std::max (node.hi[k], xyz[3 * order[a] + k]);
+        }
+    }
+    int n = nodes.size ();
+    nodes.push_back (node);
+    if (end - begin > leaf_size)
+    {
+        int axis = 0;
+        for (int k = 1; k < 3; k++)
+        {
+            if (node.hi[k] - node.lo[k] > node.hi[axis] - node.lo[axis])
+            {
+                axis = k;
+            }
+        }
+        size_t middle = begin + (end - begin) / 2;
+        std::nth_element (order.begin () + begin, order.begin () + middle,
+                          order.begin () + end, [&] (size_t a, size_t b)
+        {
+          double xa = xyz[3 * a + axis];
+          double xb = xyz[3 * b + axis];
+          return xa != xb ? xa < xb : a < b;
+        });
+        int left = build (order, begin, middle);
+        int right = build (order, middle, end);
+        nodes[n].left = left;
+        nodes[n].right = right;
+    }
+    return n;
+  }
+
+  double squared_distance (size_t a, size_t b) const
+  {
+    double d = 0;
+    for (int k = 0; k < 3; k++)
+    {
+        d += (xyz[3 * a + k] - xyz[3 * b + k]) * (xyz[3 * a + k] - xyz[3 * b + k]);
+    }
+    return d;
+  }
+
+  // squared distance of the farthest corners of the boxes of two nodes
+  double farthest_corners (const Node& A, const Node& B) const
+  {
+    double d = 0;
+    for (int k = 0; k < 3; k++)
+    {
+        double side = std::max (A.hi[k] - B.lo[k], B.hi[k] - A.lo[k]);
+        d += side * side;
+    }
+    return d;
+  }
+
+  // search the pairs of points of the nodes a and b, which may be the same
+  void search (int a, int b, PointPair& best) const
+  {
+    const Node& A = nodes[a];
+    const Node& B = nodes[b];
+    // the corners bound the distance of the points, up to rounding
+    if (farthest_corners (A, B) < best.squared * (1 - 1e-12))
+    {
+        return;
+    }
+    if (A.left < 0 && B.left < 0)
+    {
+        for (size_t i = A.begin; i < A.end; i++)
+        {
+            for (size_t j = a == b ? i + 1 : B.begin; j < B.end; j++)
+            {
+                PointPair pair (squared_distance (i, j), indices[i], indices[j]);
+                best = std::min (best, pair);
+            }
+        }
+        return;
+    }
+    if (a == b)
+    {
+        search (A.left, A.right, best);
+        search (A.left, A.left, best);
+        search (A.right, A.right, best);
+        return;
+    }
+    // split the larger node, and search its farther child first
+    if (B.left < 0 || (A.left >= 0 && A.end - A.begin >= B.end - B.begin))
+    {
+        int first = A.left;
+        int second = A.right;
+        if (farthest_corners (nodes[second], B) > farthest_corners (nodes[first], B))
+        {
+            std::swap (first, second);
+        }
+        search (first, b, best);
+        search (second, b, best);
+    }
+    else
+    {
+        int first = B.left;
+        int second = B.right;
+        if (farthest_corners (A, nodes[second]) > farthest_corners (A, nodes[first]))
+        {
+            std::swap (first, second);
+        }
+        search (a, first, best);
+        search (a, second, best);
+    }
+  }
+
+  std::vector<octave_idx_type> indices;
+  std::vector<double> xyz;
+  std::vector<Node> nodes;
+};
+
+// exact diameter of the rows of V, searched among the vertices of their
+// convex hull, or among all rows if they lie on a plane
+static PointPair exact_diameter (const Matrix& V, int num_threads)
+{
+  std::vector<octave_idx_type> candidates;
+  ConvexHull hull (V.data (), V.rows ());
+  if (hull.build (num_threads))
+  {
+      candidates = hull.vertices ();
+  }
+  else
+  {
+      for (octave_idx_type i = 0; i < V.rows (); i++)
+      {
+          candidates.push_back (i);
+      }
+  }
+  return FarthestPair (V, candidates).search (num_threads);
+}
+
+// vertical columns of a square grid over the x,y plane, each holding the
+// lowest and the highest point along z among the points falling into it.
+// For the farthest pair p, q there are points on the segments between the
+// lowest and the highest points of their columns within a cell diagonal of
+// p and q, and the farthest of these endpoints, which are all kept, are at
+// least as far apart as the two points on the segments.  So the diameter of
+// the kept points is within 2 sqrt(2) cells of the diameter.
+//
+// The points are streamed in chunks, and the cells are the powers of two
+// which fit the bounding box of the x,y coordinates seen so far in half the
+// side of the grid, which is recentered on the bounding box when it leaves
+// the grid, so that a cell never exceeds 4 / (side - 2) times the
+// bounding box.  Cells of the same size cover the same points in any grid,
+// so the grids of separate ranges of points are merged into the grid of
+// all points
+class ColumnGrid
+{
+public:
+  // grid of side x side cells over the rows of the column-major rows x 3
+  // matrix V
+  ColumnGrid (const double *V, octave_idx_type rows, int side)
+    : V (V), rows (rows), side (side), exponent (std::numeric_limits<int>::min ()),
+      empty (true)
+  {
+    origin[0] = origin[1] = 0;
+    lo[0] = lo[1] = hi[0] = hi[1] = 0;
+  }
+
+  // most bytes held by a grid of side x side cells, which is twice its
+  // cells while they are moved into a recentered grid
+  static double peak_bytes (double side)
+  {
+    return 2 * side * side * sizeof (Column);
+  }
+
+  // add the points [begin, end)
+  void add (octave_idx_type begin, octave_idx_type end)
+  {
+    const octave_idx_type chunk = 4096;
+    for (octave_idx_type first = begin; first < end; first += chunk)
+    {
+        octave_idx_type last = std::min (end, first + chunk);
+        // fit the grid to the chunk before adding its points
+        double chunk_lo[2], chunk_hi[2];
+        bool finite = false;
+        for (octave_idx_type i = first; i < last; i++)
+        {
+            double x = V[i];
+            double y = V[i + rows];
+            if (! std::isfinite (x) || ! std::isfinite (y))
+            {
+                continue;
+            }
+            if (! finite)
+            {
+                chunk_lo[0] = chunk_hi[0] = x;
+                chunk_lo[1] = chunk_hi[1] = y;
+                finite = true;
+            }
+            chunk_lo[0] = std::min (chunk_lo[0], x);
+            chunk_hi[0] = std::max (chunk_hi[0], x);
+            chunk_lo[1] = std::min (chunk_lo[1], y);
+            chunk_hi[1] = std::max (chunk_hi[1], y);
+        }
+        if (! finite)
+        {
+            continue;
+        }
+        fit (chunk_lo, chunk_hi, exponent);
+        double scale = std::ldexp (1.0, -exponent);
+        for (octave_idx_type i = first; i < last; i++)
+        {
+            double x = V[i];
+            double y = V[i + rows];
+            double z = V[i + 2 * rows];
+            if (! std::isfinite (x) || ! std::isfinite (y) || ! std::isfinite (z))
+            {
+                continue;
+            }
+            int64_t cx = int64_t (std::floor (x * scale)) - origin[0];
+            int64_t cy = int64_t (std::floor (y * scale)) - origin[1];
+            Column& column = cells[cell (cx, cy)];
+            if (column.index[0] < 0 || z < column.z[0])
+            {
+                column.z[0] = z;
+                column.index[0] = i;
+            }
+            if (column.index[1] < 0 || z > column.z[1])
+            {
+                column.z[1] = z;
+                column.index[1] = i;
+            }
+        }
+    }
+  }
+
+  // add the points of another grid over the same matrix
+  void merge (const ColumnGrid& other)
+  {
+    if (other.empty)
+    {
+        return;
+    }
+    fit (other.lo, other.hi, other.exponent);
+    for (int cy = 0; cy < side; cy++)
+    {
+        for (int cx = 0; cx < side; cx++)
+        {
+            insert (other.origin[0] + cx, other.origin[1] + cy, other.exponent,
+                    other.cells[cell (cx, cy)]);
+        }
+    }
+  }
+
+  // the lowest and highest points of all columns in ascending order
+  std::vector<octave_idx_type> points () const
+  {
+    std::vector<octave_idx_type> result;
+    for (size_t c = 0; c < cells.size (); c++)
+    {
+        for (int k = 0; k < 2; k++)
+        {
+            if (cells[c].index[k] >= 0)
+            {
+                result.push_back (cells[c].index[k]);
+            }
+        }
+    }
+    std::sort (result.begin (), result.end ());
+    result.erase (std::unique (result.begin (), result.end ()), result.end ());
+    return result;
+  }
+
+private:
+  // lowest and highest point of a column, or -1 if it is empty
+  struct Column
+  {
+    double z[2];
+    octave_idx_type index[2];
+
+    Column ()
+    {
+      z[0] = z[1] = 0;
+      index[0] = index[1] = -1;
+    }
+  };
+
+  // position of the cell in column cx and row cy of the grid
+  size_t cell (int64_t cx, int64_t cy) const
+  {
+    return size_t (cy) * side + size_t (cx);
+  }
+
+  // extend the bounding box by [box_lo, box_hi], and enlarge the cells to at
+  // least 2^min_exponent or recenter the grid as needed
+  void fit (const double box_lo[2], const double box_hi[2], int min_exponent)
+  {
+    if (empty)
+    {
+        for (int k = 0; k < 2; k++)
+        {
+            lo[k] = box_lo[k];
+            hi[k] = box_hi[k];
+        }
+    }
+    for (int k = 0; k < 2; k++)
+    {
+        lo[k] = std::min (lo[k], box_lo[k]);
+        hi[k] = std::max (hi[k], box_hi[k]);
+    }
+    // the smallest power of two fitting the box in half the grid, which
+    // keeps the cell coordinates of the box far below the range of int64_t
+    int required = min_exponent;
+    for (int k = 0; k < 2; k++)
+    {
+        double span = (hi[k] - lo[k]) / (side / 2 - 1);
+        double magnitude = std::max (std::abs (lo[k]), std::abs (hi[k]));
+        int e;
+        if (span > 0)
+        {
+            std::frexp (span, &e);
+            required = std::max (required, e);
+        }
+        if (magnitude > 0)
+        {
+            std::frexp (magnitude, &e);
+            required = std::max (required, e - 50);
+        }
+    }
+    if (required == std::numeric_limits<int>::min ())
+    {
+        // all points so far are at the origin
+        required = 0;
+    }
+    int new_exponent = std::max (exponent, required);
+    double scale = std::ldexp (1.0, -new_exponent);
+    int64_t box[2][2];
+    for (int k = 0; k < 2; k++)
+    {
+        box[k][0] = int64_t (std::floor (lo[k] * scale));
+        box[k][1] = int64_t (std::floor (hi[k] * scale));
+    }
+    bool inside = ! empty && new_exponent == exponent;
+    for (int k = 0; k < 2; k++)
+    {
+        inside = inside && box[k][0] >= origin[k]
+                 && box[k][1] < origin[k] + side;
+    }
+    if (inside)
+    {
+        return;
+    }
+    // center the box in a new grid and move the columns into it
+    std::vector<Column> old_cells (size_t (side) * side);
+    old_cells.swap (cells);
+    int64_t old_origin[2] = {origin[0], origin[1]};
+    int old_exponent = exponent;
+    for (int k = 0; k < 2; k++)
+    {
+        origin[k] = box[k][0] - (side - (box[k][1] - box[k][0] + 1)) / 2;
+    }
+    exponent = new_exponent;
+    if (! empty)
+    {
+        for (int cy = 0; cy < side; cy++)
+        {
+            for (int cx = 0; cx < side; cx++)
+            {
+                insert (old_origin[0] + cx, old_origin[1] + cy, old_exponent,
+                        old_cells[cell (cx, cy)]);
+            }
+        }
+    }
+    empty = false;
+  }
+
+  // merge the column at cell (cx, cy) of size 2^from_exponent into the grid
+  void insert (int64_t cx, int64_t cy, int from_exponent, const Column& from)
+  {
+    if (from.index[0] < 0)
+    {
+        return;
+    }
+    // cells of a power of two contain the cells of the smaller ones
+    int shift = std::min (exponent - from_exponent, 62);
+    cx = (cx >> shift) - origin[0];
+    cy = (cy >> shift) - origin[1];
+    Column& column = cells[cell (cx, cy)];
+    if (column.index[0] < 0 || from.z[0] < column.z[0]
+        || (from.z[0] == column.z[0] && from.index[0] < column.index[0]))
+    {
+        column.z[0] = from.z[0];
+        column.index[0] = from.index[0];
+    }
+    if (column.index[1] < 0 || from.z[1] > column.z[1]
+        || (from.z[1] == column.z[1] && from.index[1] < column.index[1]))
+    {
+        column.z[1] = from.z[1];
+        column.index[1] = from.index[1];
+    }
+  }
+
+  const double *V;
+  octave_idx_type rows;
+  int side;
+  int exponent;
+  bool empty;
+  double lo[2];
+  double hi[2];
+  int64_t origin[2];
+  std::vector<Column> cells;
+};
+
+DEFUN_DLD (meshDiameter, args, nargout,
+          "-*- texinfo -*-\n\
+@deftypefn{Loadable function} DISTANCE = meshDiameter(@var{vertices})\n\
+@deftypefnx{Loadable function} [DISTANCE, INDEX1, INDEX2] = meshDiameter(@var{vertices})\n\
+\n\
+\n\
+Example: [maxD, i1, i2] = meshDiameter(V)\n\
+\n\
+\n\
+This function computes the maximum distance between any two vertices of a\n\
+mesh, i.e. the diameter of its vertices, which is found between two vertices\n\
+of their convex hull. The vertices are given as an Nx3 matrix of their\n\
+3-dimensional coordinates, as returned by @code{readObj}.\n\
+\n\
+The convex hull is built by quickhull, starting from the hull of the vertices\n\
+extreme in 26 directions, which encloses most vertices of a mesh so that they\n\
+are discarded by a single parallel pass. The farthest pair of the vertices of\n\
+the hull is then searched in parallel by branch and bound over a k-d tree,\n\
+pruning the pairs of boxes which cannot be farther apart than the farthest\n\
+pair found. The result is exact, apart from vertices lying within rounding\n\
+error of the hull. Nearly spherical point clouds, whose hull holds most of\n\
+their vertices, take considerably longer than meshes of bones.\n\
+\n\
+The optional output arguments return the row indices of the two vertices.\n\
+Equally distant pairs are resolved by their indices, so the result is\n\
+identical for any number of threads. Optional property/value pairs may\n\
+follow the vertices:\n\
+\n\
+@code{\"threads\"} sets the number of threads. A value of 0 uses all\n\
+available processors. Default is 1.\n\
+\n\
+@code{\"epsilon\"} computes an approximate diameter, which is at least\n\
+(1 - epsilon) times the exact one, for epsilon between 0 and 1. The vertices\n\
+are read once in the order of their rows, and binned into the columns of a\n\
+grid of about (11.3 / epsilon)^2 cells over the x,y plane, whose cells grow in\n\
+powers of two with the extent of the vertices read so far. Only the lowest\n\
+and the highest vertex of each column are kept, and the diameter of the kept\n\
+vertices is computed as above. Each thread keeps its own grid of 32 bytes per\n\
+cell, which briefly doubles when the grid is recentered, so memory grows with\n\
+the number of threads by up to 82 MB per thread at an epsilon of 0.01 and\n\
+0.9 MB at 0.1. All grids are kept within 1 GB, using fewer threads if needed,\n\
+so epsilon should be at least about 0.0028. The kept vertices, and therefore\n\
+the result, do not depend on the number of threads.\n\
+At small epsilon, scanning the grid may take longer than the exact search of\n\
+a mesh, whose hull already discards most vertices. By default the diameter\n\
+is exact.\n\
+\n\
+Example: [maxD, i1, i2] = meshDiameter(V, \"epsilon\", 0.01, \"threads\", 0)\n\
+@end deftypefn")
+{
+
+  // Check for a valid number of input arguments
+  if (args.length() < 1 || args.length() % 2 != 1)
+  {
+      std::cout << "Invalid number of input arguments.\n";
+      return octave_value_list();
+  }
+  int num_threads = 1;
+  double epsilon = 0;
+  for (int i = 1; i < args.length(); i += 2)
+  {
+      std::string property = args(i).is_string() ? args(i).string_value() : "";
+      if (property == "threads" && args(i+1).is_real_scalar())
+      {
+          num_threads = args(i+1).int_value();
+          if (num_threads < 1)
+          {
+              num_threads = std::thread::hardware_concurrency();
+          }
+          num_threads = std::max (num_threads, 1);
+      }
+      else if (property == "epsilon" && args(i+1).is_real_scalar()
+               && args(i+1).double_value() > 0 && args(i+1).double_value() < 1)
+      {
+          epsilon = args(i+1).double_value();
+      }
+      else
+      {
+          std::cout << "Invalid property or value in input arguments.\n";
+          return octave_value_list();
+      }
+  }
+  if (! args(0).is_matrix_type() || args(0).columns() != 3)
+  {
+      std::cout << "Vertex matrix should be Nx3 containing x,y,z coordinates.\n";
+      return octave_value_list();
+  }
+  if (args(0).rows() < 2)
+  {
+      std::cout << "There should be at least 2 vertices.\n";
+      return octave_value_list();
+  }
+  Matrix V = args(0).array_value();
+
+  PointPair diameter;
+  if (epsilon > 0)
+  {
+      // keep the extreme vertices of the columns of a grid, whose cells are
+      // below epsilon / (2 sqrt (2)) of the diameter, in one pass over
+      // contiguous ranges of vertices, and search the kept vertices
+      double grid_side = std::ceil (8 * std::sqrt (2.0) / epsilon) + 2;
+      // the grids of all threads are kept within a fixed memory budget,
+      // which bounds epsilon from below and the number of grids
+      const double budget = 1 << 30;
+      if (ColumnGrid::peak_bytes (grid_side) > budget)
+      {
+          double max_side = std::floor (std::sqrt (budget / ColumnGrid::peak_bytes (1)));
+          std::cout << "Epsilon should be at least " << 8 * std::sqrt (2.0) / (max_side - 2)
+                    << " to keep the grid within 1 GB.\n";
+          return octave_value_list();
+      }
+      int side = int (grid_side);
+      octave_idx_type rows = V.rows();
+      double max_grids = std::floor (budget / ColumnGrid::peak_bytes (side));
+      int num_ranges = int (std::min (std::min (octave_idx_type (num_threads), rows),
+                                      octave_idx_type (max_grids)));
+      std::vector<ColumnGrid> grids (num_ranges, ColumnGrid (V.data(), rows, side));
+      run_tasks (num_ranges, num_threads, [&] (size_t r)
+      {
+        grids[r].add (rows * r / num_ranges, rows * (r + 1) / num_ranges);
+      });
+      // cells are the smallest power of two fitting all vertices, so the
+      // kept vertices do not depend on the ranges
+      for (int r = 1; r < num_ranges; r++)
+      {
+          grids[0].merge (grids[r]);
+          grids[r] = ColumnGrid (V.data(), rows, side);
+      }
+      std::vector<octave_idx_type> kept = grids[0].points ();
+      if (kept.size () < 2)
+      {
+          diameter = exact_diameter (V, num_threads);
+      }
+      else
+      {
+          Matrix K (kept.size (), 3);
+          for (size_t i = 0; i < kept.size (); i++)
+          {
+              for (int k = 0; k < 3; k++)
+              {
+                  K(i,k) = V(kept[i],k);
+              }
+          }
+          diameter = exact_diameter (K, num_threads);
+          diameter.i = kept[diameter.i];
+          diameter.j = kept[diameter.j];
+      }
+  }
+  else
+  {
+      diameter = exact_diameter (V, num_threads);
+  }
+  double distance = std::sqrt (diameter.squared);
+
+  octave_value_list retval;
+  if (nargout == 0)
+  {
+      std::cout << "Maximum distance is " << distance << " between vertices "
+                << diameter.i + 1 << " and " << diameter.j + 1 << ".\n";
+      return retval;
+  }
+  retval(0) = distance;
+  if (nargout > 1)
+  {
+      retval(1) = double (diameter.i + 1);
+      retval(2) = double (diameter.j + 1);
+  }
+  return retval;
+}
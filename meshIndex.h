@@ -0,0 +1,274 @@
+/*
+Copyright (C) 2018-2020 Andreas Bertsatos <abertsatos@biol.uoa.gr>
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free Software
+Foundation; either version 3 of the License, or (at your option) any later
+version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+details.
+
+You should have received a copy of the GNU General Public License along with
+this program; if not, see <http://www.gnu.org/licenses/>.
+*/
+
+#if ! defined (meshIndex_h)
+#define meshIndex_h 1
+
+// Face index arrays of class double, int32, uint32 or int64, which are shared
+// by the oct-files, so that integer face arrays returned by readObj can be
+// passed to the other functions without any conversion.
+
+#include <string>
+#include <cstdint>
+
+#include <octave/oct.h>
+
+enum IndexClass {INDEX_DOUBLE, INDEX_INT32, INDEX_UINT32, INDEX_INT64};
+
+// index class with the given name, or -1 if it is not supported
+static inline int index_class_value (const std::string& name)
+{
+  if (name == "double")
+    return INDEX_DOUBLE;
+  if (name == "int32")
+    return INDEX_INT32;
+  if (name == "uint32")
+    return INDEX_UINT32;
+  if (name == "int64")
+    return INDEX_INT64;
+  return -1;
+}
+
+// size in bytes of each element of the given index class
+static inline size_t index_class_size (int index_class)
+{
+  return (index_class == INDEX_INT32 || index_class == INDEX_UINT32) ? 4 : 8;
+}
+
+// output array of a mesh element, which is either a double array or a face
+// index array of one of the integer classes.  The array is allocated once
+// and filled through its raw column-major data
+class MeshArray
+{
+public:
+  MeshArray () : index_class (INDEX_DOUBLE) { }
+
+  void allocate (octave_idx_type rows, octave_idx_type columns, int cls)
+  {
+    index_class = cls;
+    dim_vector dv (rows, columns);
+    d = Matrix ();
+    i32 = int32NDArray ();
+    u32 = uint32NDArray ();
+    i64 = int64NDArray ();
+    switch (index_class)
+    {
+      case INDEX_INT32:
+        i32 = int32NDArray (dv);
+        break;
+      case INDEX_UINT32:
+        u32 = uint32NDArray (dv);
+        break;
+      case INDEX_INT64:
+        i64 = int64NDArray (dv);
+        break;
+      default:
+        d = Matrix (rows, columns);
+    }
+  }
+
+  void *data ()
+  {
+    switch (index_class)
+    {
+      case INDEX_INT32:
+        return i32.fortran_vec ();
+      case INDEX_UINT32:
+        return u32.fortran_vec ();
+      case INDEX_INT64:
+        return i64.fortran_vec ();
+      default:
+        return d.fortran_vec ();
+    }
+  }
+
+  const void *data () const
+  {
+    switch (index_class)
+    {
+      case INDEX_INT32:
+        return i32.data ();
+      case INDEX_UINT32:
+        return u32.data ();
+      case INDEX_INT64:
+        return i64.data ();
+      default:
+        return d.data ();
+    }
+  }
+
+  octave_idx_type rows () const
+  {
+    return dims ()(0);
+  }
+
+  octave_idx_type numel () const
+  {
+    return dims ().numel ();
+  }
+
+  octave_value value () const
+  {
+    switch (index_class)
+    {
+      case INDEX_INT32:
+        return octave_value (i32);
+      case INDEX_UINT32:
+        return octave_value (u32);
+      case INDEX_INT64:
+        return octave_value (i64);
+      default:
+        return octave_value (d);
+    }
+  }
+
+  int index_class;
+
+private:
+  dim_vector dims () const
+  {
+    switch (index_class)
+    {
+      case INDEX_INT32:
+        return i32.dims ();
+      case INDEX_UINT32:
+        return u32.dims ();
+      case INDEX_INT64:
+        return i64.dims ();
+      default:
+        return d.dims ();
+    }
+  }
+
+  Matrix d;
+  int32NDArray i32;
+  uint32NDArray u32;
+  int64NDArray i64;
+};
+
+// read-only view of a face index array given as input argument, which reads
+// double and integer indices in place.  Arrays of other numeric classes are
+// converted to double
+class IndexView
+{
+public:
+  IndexView (const octave_value& value)
+    : index_class (INDEX_DOUBLE), rows_ (value.rows ()),
+      columns_ (value.columns ()), d_data (0), i32_data (0), u32_data (0),
+      i64_data (0)
+  {
+    if (value.is_int32_type ())
+    {
+        index_class = INDEX_INT32;
+        i32 = value.int32_array_value ();
+        i32_data = reinterpret_cast<const int32_t *> (i32.data ());
+    }
+    else if (value.is_uint32_type ())
+    {
+        index_class = INDEX_UINT32;
+        u32 = value.uint32_array_value ();
+        u32_data = reinterpret_cast<const uint32_t *> (u32.data ());
+    }
+    else if (value.is_int64_type ())
+    {
+        index_class = INDEX_INT64;
+        i64 = value.int64_array_value ();
+        i64_data = reinterpret_cast<const int64_t *> (i64.data ());
+    }
+    else
+    {
+        d = value.array_value ();
+        d_data = d.data ();
+    }
+  }
+
+  octave_idx_type rows () const
+  {
+    return rows_;
+  }
+
+  octave_idx_type columns () const
+  {
+    return columns_;
+  }
+
+  octave_idx_type operator () (octave_idx_type i, octave_idx_type j) const
+  {
+    octave_idx_type k = i + j * rows_;
+    switch (index_class)
+    {
+      case INDEX_INT32:
+        return i32_data[k];
+      case INDEX_UINT32:
+        return u32_data[k];
+      case INDEX_INT64:
+        return i64_data[k];
+      default:
+        return d_data[k];
+    }
+  }
+
+  // column-major data of the index array, whose element type is given by
+  // index_class
+  const void *data () const
+  {
+    switch (index_class)
+    {
+      case INDEX_INT32:
+        return i32_data;
+      case INDEX_UINT32:
+        return u32_data;
+      case INDEX_INT64:
+        return i64_data;
+      default:
+        return d_data;
+    }
+  }
+
+  int index_class;
+
+private:
+  octave_idx_type rows_;
+  octave_idx_type columns_;
+  NDArray d;
+  int32NDArray i32;
+  uint32NDArray u32;
+  int64NDArray i64;
+  const double *d_data;
+  const int32_t *i32_data;
+  const uint32_t *u32_data;
+  const int64_t *i64_data;
+};
+
+// whether all indices of the face array refer to one of the given number
+// of rows
+static inline bool faces_in_range (const IndexView& F, octave_idx_type rows)
+{
+  for (octave_idx_type j = 0; j < F.columns (); j++)
+  {
+      for (octave_idx_type i = 0; i < F.rows (); i++)
+      {
+          if (F(i,j) < 1 || F(i,j) > rows)
+          {
+              return false;
+          }
+      }
+  }
+  return true;
+}
+
+#endif
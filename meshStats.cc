@@ -0,0 +1,583 @@
+/*
+Copyright (C) 2018-2020 Andreas Bertsatos <abertsatos@biol.uoa.gr>
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free Software
+Foundation; either version 3 of the License, or (at your option) any later
+version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+details.
+
+You should have received a copy of the GNU General Public License along with
+this program; if not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <cmath>
+#include <limits>
+#include <octave/oct.h>
+#include "meshIndex.h"
+#include "meshCentroid.h"
+#include "meshThreads.h"
+
+// Every face adds, for the tetrahedron between it and the origin with six
+// times its signed volume D = a . (b - a) x (c - a), the following twelve
+// values, which are kept in three compensated sums of four:
+//
+//   D * s, D            first moments and volume, s = a + b + c
+//   D * q_xx, q_yy, q_zz, q_xy
+//   D * q_xz, q_yz, |n|, 0
+//
+// where q_ij = s_i s_j + a_i a_j + b_i b_j + c_i c_j, so that the second
+// moment of the tetrahedron is D q_ij / 120, and |n| is twice the area of
+// the face.
+// add the twelve values of a face to the three sums
+struct ScalarStats
+{
+  static inline void add (CentroidSum s[3], const double *pa, const double *pb,
+                          const double *pc)
+  {
+    double ab[3], ac[3], n[3], vs[3];
+    for (int k = 0; k < 3; k++)
+    {
+        ab[k] = pb[k] - pa[k];
+        ac[k] = pc[k] - pa[k];
+        vs[k] = pa[k] + pb[k] + pc[k];
+    }
+    n[0] = ab[1] * ac[2] - ab[2] * ac[1];
+    n[1] = ab[2] * ac[0] - ab[0] * ac[2];
+    n[2] = ab[0] * ac[1] - ab[1] * ac[0];
+    double D = pa[0] * n[0] + pa[1] * n[1] + pa[2] * n[2];
+    double area = std::sqrt (n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+    // pairs of coordinates of each second moment, in the order of the sums
+    static const int pairs[6][2] = {{0, 0}, {1, 1}, {2, 2}, {0, 1},
+                                    {0, 2}, {1, 2}};
+    double q[6];
+    for (int m = 0; m < 6; m++)
+    {
+        int j = pairs[m][0];
+        int k = pairs[m][1];
+        q[m] = vs[j] * vs[k] + pa[j] * pa[k] + pb[j] * pb[k] + pc[j] * pc[k];
+    }
+    for (int k = 0; k < 3; k++)
+    {
+        kahan_add (s[0].sum[k], s[0].error[k], vs[k] * D);
+    }
+    kahan_add (s[0].sum[3], s[0].error[3], D);
+    for (int m = 0; m < 4; m++)
+    {
+        kahan_add (s[1].sum[m], s[1].error[m], q[m] * D);
+    }
+    kahan_add (s[2].sum[0], s[2].error[0], q[4] * D);
+    kahan_add (s[2].sum[1], s[2].error[1], q[5] * D);
+    kahan_add (s[2].sum[2], s[2].error[2], area);
+  }
+};
+
+#if defined (MESH_SIMD)
+// the cross product, the moments and the sums of a face computed four lanes
+// at a time, in the same order of operations as ScalarStats
+struct SimdStats
+{
+  // v_i v_i for x, y and z followed by v_x v_y
+  MESH_TARGET_AVX2
+  static inline __m256d square_moments (__m256d v)
+  {
+    return _mm256_mul_pd (_mm256_permute4x64_pd (v, _MM_SHUFFLE (0, 2, 1, 0)),
+                          _mm256_permute4x64_pd (v, _MM_SHUFFLE (1, 2, 1, 0)));
+  }
+
+  // v_x v_z and v_y v_z in the first two lanes
+  MESH_TARGET_AVX2
+  static inline __m256d cross_moments (__m256d v)
+  {
+    return _mm256_mul_pd (v, _mm256_permute4x64_pd (v, _MM_SHUFFLE (2, 2, 2, 2)));
+  }
+
+  MESH_TARGET_AVX2
+  static inline void kahan_add (CentroidSum& s, __m256d x)
+  {
+    __m256d sum = _mm256_loadu_pd (s.sum);
+    __m256d y = _mm256_sub_pd (x, _mm256_loadu_pd (s.error));
+    __m256d t = _mm256_add_pd (sum, y);
+    _mm256_storeu_pd (s.error, _mm256_sub_pd (_mm256_sub_pd (t, sum), y));
+    _mm256_storeu_pd (s.sum, t);
+  }
+
+  MESH_TARGET_AVX2
+  static inline void add (CentroidSum s[3], const double *pa, const double *pb,
+                          const double *pc)
+  {
+    // the fourth lane of the loaded vertices belongs to the next vertex, so
+    // it is cleared from the normal and replaced in the sums
+    __m256d va = _mm256_loadu_pd (pa);
+    __m256d vb = _mm256_loadu_pd (pb);
+    __m256d vc = _mm256_loadu_pd (pc);
+    __m256d ab = _mm256_sub_pd (vb, va);
+    __m256d ac = _mm256_sub_pd (vc, va);
+    const int yzx = _MM_SHUFFLE (3, 0, 2, 1);
+    const int zxy = _MM_SHUFFLE (3, 1, 0, 2);
+    __m256d n = _mm256_sub_pd (
+      _mm256_mul_pd (_mm256_permute4x64_pd (ab, yzx),
+                     _mm256_permute4x64_pd (ac, zxy)),
+      _mm256_mul_pd (_mm256_permute4x64_pd (ab, zxy),
+                     _mm256_permute4x64_pd (ac, yzx)));
+    n = _mm256_blend_pd (n, _mm256_setzero_pd (), 8);
+    // a . n and n . n
+    __m256d h = _mm256_hadd_pd (_mm256_mul_pd (va, n), _mm256_mul_pd (n, n));
+    __m128d dots = _mm_add_pd (_mm256_castpd256_pd128 (h),
+                               _mm256_extractf128_pd (h, 1));
+    __m256d D = _mm256_broadcastsd_pd (dots);
+    double area = std::sqrt (_mm_cvtsd_f64 (_mm_unpackhi_pd (dots, dots)));
+    __m256d vs = _mm256_add_pd (_mm256_add_pd (va, vb), vc);
+    __m256d q1 = _mm256_add_pd (_mm256_add_pd (_mm256_add_pd (
+                   square_moments (vs), square_moments (va)),
+                   square_moments (vb)), square_moments (vc));
+    __m256d q2 = _mm256_add_pd (_mm256_add_pd (_mm256_add_pd (
+                   cross_moments (vs), cross_moments (va)),
+                   cross_moments (vb)), cross_moments (vc));
+    kahan_add (s[0], _mm256_blend_pd (_mm256_mul_pd (vs, D), D, 8));
+    kahan_add (s[1], _mm256_mul_pd (q1, D));
+    kahan_add (s[2], _mm256_blend_pd (_mm256_mul_pd (q2, D),
+                                      _mm256_set_pd (0, area, 0, 0), 12));
+  }
+};
+#endif
+
+// number of faces ahead whose vertices are prefetched
+static const octave_idx_type prefetch_faces = 16;
+
+// add the faces [begin, end) to the three sums with the Kernel adding each
+// face.  Consecutive faces go to two independent sets of sums.  Returns
+// false if a face refers to a missing vertex
+template <typename Kernel, typename T>
+static inline bool sum_stats_faces (const std::vector<double>& xyz,
+                                    octave_idx_type V_rows, const T *F,
+                                    octave_idx_type F_rows,
+                                    octave_idx_type begin, octave_idx_type end,
+                                    CentroidSum total[3])
+{
+  const T *A = F;
+  const T *B = F + F_rows;
+  const T *C = F + 2 * F_rows;
+  CentroidSum sums[2][3];
+  for (octave_idx_type i = begin; i < end; i++)
+  {
+      size_t a = static_cast<octave_idx_type> (A[i]) - 1;
+      size_t b = static_cast<octave_idx_type> (B[i]) - 1;
+      size_t c = static_cast<octave_idx_type> (C[i]) - 1;
+      // indices below 1 wrap around to huge unsigned values
+      if (a >= size_t (V_rows) || b >= size_t (V_rows) || c >= size_t (V_rows))
+      {
+          return false;
+      }
+      // fetch the vertices of a face further ahead, since faces of a large
+      // mesh refer to vertices scattered over memory
+      if (i + prefetch_faces < end)
+      {
+          size_t ahead[3];
+          ahead[0] = static_cast<octave_idx_type> (A[i + prefetch_faces]) - 1;
+          ahead[1] = static_cast<octave_idx_type> (B[i + prefetch_faces]) - 1;
+          ahead[2] = static_cast<octave_idx_type> (C[i + prefetch_faces]) - 1;
+          for (int k = 0; k < 3; k++)
+          {
+              if (ahead[k] < size_t (V_rows))
+              {
+                  __builtin_prefetch (&xyz[3 * ahead[k]]);
+              }
+          }
+      }
+      Kernel::add (sums[i & 1], &xyz[3 * a], &xyz[3 * b], &xyz[3 * c]);
+  }
+  for (int j = 0; j < 3; j++)
+  {
+      total[j].add (sums[0][j]);
+      total[j].add (sums[1][j]);
+  }
+  return true;
+}
+
+#if defined (MESH_SIMD)
+// the face loop compiled for AVX2, with the kernel inlined into it
+template <typename T>
+MESH_TARGET_AVX2_LOOP
+static bool sum_stats_faces_simd (const std::vector<double>& xyz,
+                                  octave_idx_type V_rows, const T *F,
+                                  octave_idx_type F_rows, octave_idx_type begin,
+                                  octave_idx_type end, CentroidSum total[3])
+{
+  return sum_stats_faces<SimdStats> (xyz, V_rows, F, F_rows, begin, end,
+                                     total);
+}
+#endif
+
+// add the faces [begin, end) to the three sums, four lanes at a time if the
+// processor supports AVX2.  Returns false if a face refers to a missing
+// vertex
+template <typename T>
+static bool sum_stats (const std::vector<double>& xyz, octave_idx_type V_rows,
+                       const T *F, octave_idx_type F_rows,
+                       octave_idx_type begin, octave_idx_type end,
+                       CentroidSum total[3])
+{
+#if defined (MESH_SIMD)
+  if (simd_supported ())
+  {
+      return sum_stats_faces_simd (xyz, V_rows, F, F_rows, begin, end, total);
+  }
+#endif
+  return sum_stats_faces<ScalarStats> (xyz, V_rows, F, F_rows, begin, end,
+                                       total);
+}
+
+// eigenvalues of the symmetric 3x3 matrix A in ascending order, with their
+// unit eigenvectors in the columns of Q (cyclic Jacobi rotations).  Each
+// eigenvector is signed so that its largest component is positive
+static void symmetric_eigen (Matrix A, double lambda[3], Matrix& Q)
+{
+  Q = Matrix (3, 3, 0.0);
+  for (int k = 0; k < 3; k++)
+  {
+      Q(k,k) = 1;
+  }
+  for (int sweep = 0; sweep < 50; sweep++)
+  {
+      double off = A(0,1) * A(0,1) + A(0,2) * A(0,2) + A(1,2) * A(1,2);
+      if (off == 0)
+      {
+          break;
+      }
+      for (int p = 0; p < 2; p++)
+      {
+          for (int q = p + 1; q < 3; q++)
+          {
+              if (A(p,q) == 0)
+              {
+                  continue;
+              }
+              // rotation zeroing A(p,q)
+              double theta = (A(q,q) - A(p,p)) / (2 * A(p,q));
+              double t = (theta >= 0 ? 1 : -1)
+                         / (std::abs (theta) + std::sqrt (theta * theta + 1));
+              double c = 1 / std::sqrt (t * t + 1);
+              double s = t * c;
+              for (int k = 0; k < 3; k++)
+              {
+                  double akp = A(k,p);
+                  double akq = A(k,q);
+                  A(k,p) = c * akp - s * akq;
+                  A(k,q) = s * akp + c * akq;
+              }
+              for (int k = 0; k < 3; k++)
+              {
+                  double apk = A(p,k);
+                  double aqk = A(q,k);
+                  A(p,k) = c * apk - s * aqk;
+                  A(q,k) = s * apk + c * aqk;
+              }
+              for (int k = 0; k < 3; k++)
+              {
+                  double qkp = Q(k,p);
+                  double qkq = Q(k,q);
+                  Q(k,p) = c * qkp - s * qkq;
+                  Q(k,q) = s * qkp + c * qkq;
+              }
+          }
+      }
+  }
+  // sort the eigenpairs by ascending eigenvalue
+  int order[3] = {0, 1, 2};
+  std::sort (order, order + 3, [&A] (int i, int j) { return A(i,i) < A(j,j); });
+  Matrix sorted (3, 3);
+  for (int j = 0; j < 3; j++)
+  {
+      lambda[j] = A(order[j],order[j]);
+      int largest = 0;
+      for (int k = 1; k < 3; k++)
+      {
+          if (std::abs (Q(k,order[j])) > std::abs (Q(largest,order[j])))
+          {
+              largest = k;
+          }
+      }
+      double sign = Q(largest,order[j]) < 0 ? -1 : 1;
+      for (int k = 0; k < 3; k++)
+      {
+          sorted(k,j) = sign * Q(k,order[j]);
+      }
+  }
+  Q = sorted;
+}
+
+// global properties of a mesh, whose faces are summed in fixed blocks like
+// MeshCentroid, so the result does not depend on the number of threads.
+// The sums are taken relative to the first vertex
+class MeshStats
+{
+public:
+  MeshStats (const Matrix& V, const IndexView& F)
+    : V (V), F (F), blocks ((F.rows () + block_rows - 1) / block_rows),
+      valid (blocks.size (), 1)
+  { }
+
+  // interleave the vertices and find their bounding box, which must
+  // precede summing the blocks
+  void prepare ()
+  {
+    const double *data = V.data ();
+    octave_idx_type V_rows = V.rows ();
+    for (int k = 0; k < 3; k++)
+    {
+        origin[k] = data[k * V_rows];
+        box[0][k] = box[1][k] = origin[k];
+        for (octave_idx_type i = 1; i < V_rows; i++)
+        {
+            box[0][k] = std::min (box[0][k], data[i + k * V_rows]);
+            box[1][k] = std::max (box[1][k], data[i + k * V_rows]);
+        }
+    }
+    xyz = interleave_vertices (data, V_rows, origin);
+  }
+
+  size_t num_blocks () const
+  {
+    return blocks.size ();
+  }
+
+  void sum_block (size_t i)
+  {
+    octave_idx_type begin = i * block_rows;
+    octave_idx_type end = std::min (F.rows (), begin + block_rows);
+    switch (F.index_class)
+    {
+      case INDEX_INT32:
+        valid[i] = sum_stats (xyz, V.rows (),
+                              static_cast<const int32_t *> (F.data ()),
+                              F.rows (), begin, end, blocks[i].sums);
+        break;
+      case INDEX_UINT32:
+        valid[i] = sum_stats (xyz, V.rows (),
+                              static_cast<const uint32_t *> (F.data ()),
+                              F.rows (), begin, end, blocks[i].sums);
+        break;
+      case INDEX_INT64:
+        valid[i] = sum_stats (xyz, V.rows (),
+                              static_cast<const int64_t *> (F.data ()),
+                              F.rows (), begin, end, blocks[i].sums);
+        break;
+      default:
+        valid[i] = sum_stats (xyz, V.rows (),
+                              static_cast<const double *> (F.data ()),
+                              F.rows (), begin, end, blocks[i].sums);
+    }
+  }
+
+  // combine the blocks into the properties of the mesh.  Returns an error
+  // message, which is empty on success
+  std::string result (octave_scalar_map& stats) const
+  {
+    CentroidSum total[3];
+    for (size_t i = 0; i < blocks.size (); i++)
+    {
+        if (! valid[i])
+        {
+            return "Faces refer to missing vertices.";
+        }
+        for (int j = 0; j < 3; j++)
+        {
+            total[j].add (blocks[i].sums[j]);
+        }
+    }
+    double volume = total[0].value (3) / 6;
+    Matrix bounding_box (2, 3);
+    for (int k = 0; k < 3; k++)
+    {
+        bounding_box(0,k) = box[0][k];
+        bounding_box(1,k) = box[1][k];
+    }
+    stats.assign ("area", total[2].value (2) / 2);
+    stats.assign ("volume", volume);
+    stats.assign ("boundingbox", bounding_box);
+    if (volume == 0)
+    {
+        // an open or flat mesh encloses no solid
+        double nan = std::numeric_limits<double>::quiet_NaN ();
+        stats.assign ("centroid", Matrix (1, 3, nan));
+        stats.assign ("inertia", Matrix (3, 3, nan));
+        stats.assign ("principalmoments", Matrix (1, 3, nan));
+        stats.assign ("principalaxes", Matrix (3, 3, nan));
+        return "";
+    }
+    // centroid relative to the origin and second moments about it
+    double c[3];
+    for (int k = 0; k < 3; k++)
+    {
+        c[k] = total[0].value (k) / (4 * total[0].value (3));
+    }
+    double moments[6] = {total[1].value (0), total[1].value (1),
+                         total[1].value (2), total[1].value (3),
+                         total[2].value (0), total[2].value (1)};
+    static const int pairs[6][2] = {{0, 0}, {1, 1}, {2, 2}, {0, 1},
+                                    {0, 2}, {1, 2}};
+    // second moments about the centroid, of a solid of unit density,
+    // whichever way the faces are oriented
+    Matrix S (3, 3);
+    for (int m = 0; m < 6; m++)
+    {
+        int j = pairs[m][0];
+        int k = pairs[m][1];
+        S(j,k) = S(k,j) = (moments[m] / 120 - volume * c[j] * c[k])
+                          * (volume < 0 ? -1 : 1);
+    }
+    Matrix inertia (3, 3);
+    double trace = S(0,0) + S(1,1) + S(2,2);
+    for (int j = 0; j < 3; j++)
+    {
+        for (int k = 0; k < 3; k++)
+        {
+            inertia(j,k) = (j == k ? trace : 0) - S(j,k);
+        }
+    }
+    double lambda[3];
+    Matrix axes;
+    symmetric_eigen (inertia, lambda, axes);
+    Matrix centroid (1, 3);
+    Matrix principal_moments (1, 3);
+    for (int k = 0; k < 3; k++)
+    {
+        centroid(0,k) = c[k] + origin[k];
+        principal_moments(0,k) = lambda[k];
+    }
+    stats.assign ("centroid", centroid);
+    stats.assign ("inertia", inertia);
+    stats.assign ("principalmoments", principal_moments);
+    stats.assign ("principalaxes", axes);
+    return "";
+  }
+
+private:
+  static const octave_idx_type block_rows = 1 << 16;
+
+  struct Block
+  {
+    CentroidSum sums[3];
+  };
+
+  Matrix V;
+  IndexView F;
+  double origin[3];
+  double box[2][3];
+  std::vector<double> xyz;
+  std::vector<Block> blocks;
+  std::vector<char> valid;
+};
+
+
+DEFUN_DLD (meshStats, args, ,
+          "-*- texinfo -*-\n\
+@deftypefn{Loadable function} STATS = meshStats(@var{vertices}, @var{faces})\n\
+\n\
+\n\
+Example: S = meshStats(V, F)\n\
+\n\
+\n\
+This function computes the global properties of a triangular 3D Mesh in a\n\
+single pass over its faces. The first argument should be an Nx3 matrix\n\
+containing the 3-dimensional coordinates of each vertex and the second\n\
+argument an Nx3 matrix with each row containing the three vertices that form\n\
+each face, of class double, int32, uint32 or int64 as returned by\n\
+@code{readObj}.\n\
+\n\
+The returned structure has the following fields:\n\
+\n\
+@code{area}: the surface area of the mesh.\n\
+\n\
+@code{volume}: the volume enclosed by a closed mesh, which is negative if the\n\
+faces are oriented with their normals pointing inwards.\n\
+\n\
+@code{boundingbox}: a 2x3 matrix with the minimum and maximum coordinates of\n\
+the vertices.\n\
+\n\
+@code{centroid}: the 1x3 centroid of the enclosed solid.\n\
+\n\
+@code{inertia}: the 3x3 inertia tensor of the enclosed solid of unit density\n\
+about its centroid.\n\
+\n\
+@code{principalmoments}: the 1x3 eigenvalues of the inertia tensor in\n\
+ascending order.\n\
+\n\
+@code{principalaxes}: a 3x3 matrix with the principal axes in its columns,\n\
+in the order of the principal moments. The first column is the axis about\n\
+which the solid is least resistant to rotation, i.e. the long axis of a bone.\n\
+\n\
+The volume, centroid and inertia are computed from the signed tetrahedra\n\
+between each face and a common vertex (divergence theorem) and are only\n\
+meaningful for closed meshes. If the mesh encloses no volume they are NaN.\n\
+\n\
+The faces are summed in fixed blocks with compensated double precision\n\
+summation and the blocks are combined in order, so the result is identical\n\
+for any number of threads. Optional property/value pairs may follow the\n\
+faces:\n\
+\n\
+@code{\"threads\"} sets the number of threads summing the faces. A value of\n\
+0 uses all available processors. Default is 1.\n\
+\n\
+Example: S = meshStats(V, F, \"threads\", 0); long_axis = S.principalaxes(:,1)\n\
+@end deftypefn")
+{
+
+  // Check for a valid number of input arguments
+  if (args.length() < 2 || args.length() % 2 != 0)
+  {
+      std::cout << "Invalid number of input arguments.\n";
+      return octave_value_list();
+  }
+  int num_threads = 1;
+  for (int i = 2; i < args.length(); i += 2)
+  {
+      std::string property = args(i).is_string() ? args(i).string_value() : "";
+      if (property == "threads" && args(i+1).is_real_scalar())
+      {
+          num_threads = args(i+1).int_value();
+          if (num_threads < 1)
+          {
+              num_threads = std::thread::hardware_concurrency();
+          }
+          num_threads = std::max (num_threads, 1);
+      }
+      else
+      {
+          std::cout << "Invalid property or value in input arguments.\n";
+          return octave_value_list();
+      }
+  }
+  std::string error = check_mesh (args(0), args(1));
+  if (! error.empty ())
+  {
+      std::cout << error << "\n";
+      return octave_value_list();
+  }
+
+  // interleave the vertices, then sum the blocks of faces in parallel
+  MeshStats mesh (args(0).array_value(), IndexView (args(1)));
+  mesh.prepare ();
+  run_tasks (mesh.num_blocks (), num_threads,
+             [&mesh] (size_t i) { mesh.sum_block (i); });
+  octave_scalar_map stats;
+  error = mesh.result (stats);
+  if (! error.empty ())
+  {
+      std::cout << error << "\n";
+      return octave_value_list();
+  }
+  octave_value_list retval;
+  retval(0) = stats;
+  return retval;
+}
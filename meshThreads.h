@@ -0,0 +1,58 @@
+/*
+Copyright (C) 2018-2020 Andreas Bertsatos <abertsatos@biol.uoa.gr>
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free Software
+Foundation; either version 3 of the License, or (at your option) any later
+version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+details.
+
+You should have received a copy of the GNU General Public License along with
+this program; if not, see <http://www.gnu.org/licenses/>.
+*/
+
+#if ! defined (meshThreads_h)
+#define meshThreads_h 1
+
+// Thread pool shared by the functions which split their work into
+// independent tasks, from the chunks of an obj file to the blocks of faces
+// of a mesh.
+
+#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+// run task (i) for every i in [0, count) on num_threads threads.  Each
+// thread takes the next task as soon as it finishes one, so that tasks of
+// very different sizes keep all threads busy
+template <typename Task>
+static inline void run_tasks (size_t count, int num_threads, const Task& task)
+{
+  std::atomic<size_t> next_task (0);
+  auto run = [&] ()
+  {
+    size_t i;
+    while ((i = next_task++) < count)
+    {
+        task (i);
+    }
+  };
+  num_threads = std::max (1, int (std::min (size_t (num_threads), count)));
+  std::vector<std::thread> workers;
+  for (int t = 1; t < num_threads; t++)
+  {
+      workers.push_back (std::thread (run));
+  }
+  run ();
+  for (size_t t = 0; t < workers.size (); t++)
+  {
+      workers[t].join ();
+  }
+}
+
+#endif
@@ -0,0 +1,941 @@
+/*
+Copyright (C) 2018-2020 Andreas Bertsatos <abertsatos@biol.uoa.gr>
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free Software
+Foundation; either version 3 of the License, or (at your option) any later
+version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+details.
+
+You should have received a copy of the GNU General Public License along with
+this program; if not, see <http://www.gnu.org/licenses/>.
+*/
+
+#if ! defined (objParser_h)
+#define objParser_h 1
+
+// Tokenizer and two-pass chunk parser for Wavefront obj files, which is
+// shared by readObj and the streaming readObjOpen/readObjNext functions.
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#if defined (__has_include)
+#if __has_include (<charconv>)
+#include <charconv>
+#endif
+#endif
+#include <octave/oct.h>
+
+#include "mappedFile.h"
+#include "meshIndex.h"
+#include "meshThreads.h"
+
+// elements of an obj file in the order their arrays are returned
+enum ObjElement
+{
+      VERTEX, FACE, TEXTURE, FACE_TEXTURE, NORMALS, FACE_NORMALS, NUM_ELEMENTS
+};
+
+// faces are stored in the requested index class, the other elements as double
+static inline bool is_face_element (int k)
+{
+  return k == FACE || k == FACE_TEXTURE || k == FACE_NORMALS;
+}
+
+
+// face layouts of an obj file, i.e. v, v/vt, v/vt/vn and v//vn
+enum FaceLayout
+{
+      FACE_UNKNOWN, FACE_V, FACE_VT, FACE_VTN, FACE_VN
+};
+
+// cursor helpers for scanning a line delimited by [p, end)
+static inline bool is_blank (char c)
+{
+  return c == ' ' || c == '\t' || c == '\r';
+}
+static inline bool is_digit (char c)
+{
+  return c >= '0' && c <= '9';
+}
+static inline const char *skip_blanks (const char *p, const char *end)
+{
+  while (p < end && is_blank (*p))
+    p++;
+  return p;
+}
+
+// parse a strictly positive integer index, which is checked against the
+// index class of the faces only when it is stored
+static inline bool parse_index (const char *&p, const char *end,
+                                octave_idx_type &value)
+{
+  if (p == end || ! is_digit (*p))
+    return false;
+  int64_t n = 0;
+  while (p < end && is_digit (*p))
+  {
+    if (n > (INT64_MAX - 9) / 10)
+      return false;
+    n = n * 10 + (*p - '0');
+    p++;
+  }
+  value = n;
+  return n > 0;
+}
+
+// check whether the eight characters packed in a little endian word are all
+// decimal digits, so that a run of digits can be consumed eight at a time
+static inline bool is_eight_digits (uint64_t word)
+{
+  return ! (((word + 0x4646464646464646ULL) | (word - 0x3030303030303030ULL))
+            & 0x8080808080808080ULL);
+}
+
+// convert eight decimal digits packed in a little endian word to their value
+static inline uint32_t parse_eight_digits (uint64_t word)
+{
+  const uint64_t mask = 0x000000FF000000FFULL;
+  const uint64_t mul1 = 0x000F424000000064ULL;
+  const uint64_t mul2 = 0x0000271000000001ULL;
+  word -= 0x3030303030303030ULL;
+  word = (word * 10) + (word >> 8);
+  word = (((word & mask) * mul1) + (((word >> 16) & mask) * mul2)) >> 32;
+  return uint32_t (word);
+}
+
+// load eight characters as a little endian word
+static inline uint64_t load_word (const char *p)
+{
+  uint64_t word;
+  memcpy (&word, p, sizeof (word));
+#if defined (__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  word = __builtin_bswap64 (word);
+#endif
+  return word;
+}
+
+// correctly rounded conversion of the number in [begin, end), which is used
+// whenever the fast path below cannot guarantee an exact result
+static inline double parse_double_exact (const char *begin, const char *end,
+                                         bool negative, long long exponent)
+{
+  double value = 0;
+#if defined (__cpp_lib_to_chars)
+  std::from_chars_result r = std::from_chars (begin, end, value);
+  if (r.ec == std::errc::result_out_of_range)
+    value = (exponent > 0) ? (negative ? -HUGE_VAL : HUGE_VAL)
+                           : (negative ? -0.0 : 0.0);
+#else
+  std::string number (begin, end);
+  value = strtod (number.c_str (), 0);
+#endif
+  return value;
+}
+
+// parse a decimal floating point number in fixed or scientific notation.
+// Numbers with up to 19 significant digits, whose decimal exponent is small
+// enough for the power of ten to be exactly representable, are converted
+// with a single correctly rounded floating point operation.  All others are
+// passed to an exact decimal to double conversion
+static inline bool parse_double (const char *&p, const char *end, double &value)
+{
+  static const double pow10[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7,
+                                 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14,
+                                 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21,
+                                 1e22};
+  const char *s = p;
+  bool negative = false;
+  if (s < end && (*s == '-' || *s == '+'))
+  {
+    negative = (*s == '-');
+    s++;
+  }
+  const char *number_begin = (s > p && *p == '+') ? s : p;
+  // accumulate all digits into the mantissa, consuming runs of eight digits
+  // at a time in the fractional part
+  uint64_t mantissa = 0;
+  const char *digits_begin = s;
+  while (s < end && is_digit (*s))
+  {
+    mantissa = mantissa * 10 + (*s - '0');
+    s++;
+  }
+  long long digit_count = s - digits_begin;
+  long long exponent = 0;
+  if (s < end && *s == '.')
+  {
+    s++;
+    const char *fraction_begin = s;
+    while (end - s >= 8 && is_eight_digits (load_word (s)))
+    {
+      mantissa = mantissa * 100000000 + parse_eight_digits (load_word (s));
+      s += 8;
+    }
+    while (s < end && is_digit (*s))
+    {
+      mantissa = mantissa * 10 + (*s - '0');
+      s++;
+    }
+    exponent = -(s - fraction_begin);
+    digit_count -= exponent;
+  }
+  if (digit_count == 0)
+    return false;
+  if (s < end && (*s == 'e' || *s == 'E'))
+  {
+    const char *e = s + 1;
+    bool exp_negative = false;
+    if (e < end && (*e == '-' || *e == '+'))
+    {
+      exp_negative = (*e == '-');
+      e++;
+    }
+    if (e < end && is_digit (*e))
+    {
+      long long exp_value = 0;
+      while (e < end && is_digit (*e))
+      {
+        if (exp_value < 100000)
+          exp_value = exp_value * 10 + (*e - '0');
+        e++;
+      }
+      exponent += exp_negative ? -exp_value : exp_value;
+      s = e;
+    }
+  }
+  // discount leading zeros before checking whether the mantissa overflowed
+  if (digit_count > 19)
+  {
+    const char *z = digits_begin;
+    while (z < s && (*z == '0' || *z == '.'))
+    {
+      if (*z == '0')
+        digit_count--;
+      z++;
+    }
+  }
+  p = s;
+  const uint64_t max_exact = uint64_t (1) << 53;
+  if (digit_count <= 19 && mantissa <= max_exact)
+  {
+    double result = double (mantissa);
+    if (exponent >= 0 && exponent <= 22)
+    {
+      value = negative ? -(result * pow10[exponent])
+                       : result * pow10[exponent];
+      return true;
+    }
+    if (exponent < 0 && exponent >= -22)
+    {
+      value = negative ? -(result / pow10[-exponent])
+                       : result / pow10[-exponent];
+      return true;
+    }
+    if (mantissa == 0)
+    {
+      value = negative ? -0.0 : 0.0;
+      return true;
+    }
+  }
+  value = parse_double_exact (number_begin, s, negative, exponent);
+  return true;
+}
+
+// parse up to n floating point numbers separated by blanks, leaving any
+// missing values at zero
+static inline void parse_doubles (const char *p, const char *end,
+                                  double *values, int n)
+{
+  for (int i = 0; i < n; i++)
+  {
+    values[i] = 0;
+    p = skip_blanks (p, end);
+    if (! parse_double (p, end, values[i]))
+      break;
+  }
+}
+
+// fast path for triangular faces of a known layout, which returns false as
+// soon as the line deviates from it
+template <int layout>
+static inline bool parse_triangle (const char *p, const char *end,
+                                   octave_idx_type *v, octave_idx_type *vt,
+                                   octave_idx_type *vn)
+{
+  for (int i = 0; i < 3; i++)
+  {
+    p = skip_blanks (p, end);
+    if (! parse_index (p, end, v[i]))
+      return false;
+    if (layout == FACE_VT || layout == FACE_VTN)
+    {
+      if (p == end || *p != '/')
+        return false;
+      p++;
+      if (! parse_index (p, end, vt[i]))
+        return false;
+    }
+    if (layout == FACE_VTN)
+    {
+      if (p == end || *p != '/')
+        return false;
+      p++;
+    }
+    if (layout == FACE_VN)
+    {
+      if (end - p < 2 || p[0] != '/' || p[1] != '/')
+        return false;
+      p += 2;
+    }
+    if (layout == FACE_VTN || layout == FACE_VN)
+    {
+      if (! parse_index (p, end, vn[i]))
+        return false;
+    }
+    if (p < end && ! is_blank (*p))
+      return false;
+  }
+  return skip_blanks (p, end) == end;
+}
+
+// generic face parser, which determines the layout of the face from its
+// first vertex, stores the indices of all its vertices and returns their
+// number or -1 if the face is malformed or its vertices do not share the
+// same layout
+static inline int parse_face (const char *p, const char *end,
+                              std::vector<octave_idx_type>& v,
+                              std::vector<octave_idx_type>& vt,
+                              std::vector<octave_idx_type>& vn, int &layout)
+{
+  v.clear ();
+  vt.clear ();
+  vn.clear ();
+  layout = FACE_UNKNOWN;
+  p = skip_blanks (p, end);
+  while (p < end)
+  {
+    octave_idx_type vi = 0, vti = 0, vni = 0;
+    int vertex_layout = FACE_V;
+    if (! parse_index (p, end, vi))
+      return -1;
+    if (p < end && *p == '/')
+    {
+      p++;
+      if (p < end && *p == '/')
+      {
+        p++;
+        if (! parse_index (p, end, vni))
+          return -1;
+        vertex_layout = FACE_VN;
+      }
+      else
+      {
+        if (! parse_index (p, end, vti))
+          return -1;
+        vertex_layout = FACE_VT;
+        if (p < end && *p == '/')
+        {
+          p++;
+          if (! parse_index (p, end, vni))
+            return -1;
+          vertex_layout = FACE_VTN;
+        }
+      }
+    }
+    if (p < end && ! is_blank (*p))
+      return -1;
+    if (layout == FACE_UNKNOWN)
+      layout = vertex_layout;
+    else if (layout != vertex_layout)
+      return -1;
+    v.push_back (vi);
+    vt.push_back (vti);
+    vn.push_back (vni);
+    p = skip_blanks (p, end);
+  }
+  return v.size ();
+}
+
+// scratch buffers for triangulating polygons, which are reused across the
+// faces of a chunk
+struct PolygonScratch
+{
+  std::vector<double> x, y;
+  std::vector<int> remaining;
+  std::vector<int> triangles;
+};
+
+// twice the signed area of the 2D triangle (a, b, c)
+static inline double signed_area (const PolygonScratch& s, int a, int b, int c)
+{
+  return (s.x[b] - s.x[a]) * (s.y[c] - s.y[a])
+         - (s.y[b] - s.y[a]) * (s.x[c] - s.x[a]);
+}
+
+// split a polygon with n > 3 vertices, whose 1-based vertex indices into the
+// column-major vertex array V are given in v, into n - 2 triangles, which are
+// stored in s.triangles as triplets of positions in the polygon.  The polygon
+// is projected onto the coordinate plane most parallel to it, as given by its
+// Newell normal.  Convex polygons are split into a fan, whereas non-convex
+// ones are split by ear clipping.  Both preserve the winding of the polygon
+static inline void triangulate_polygon (const double *V, octave_idx_type V_rows,
+                                        const std::vector<octave_idx_type>& v,
+                                        PolygonScratch& s)
+{
+  int n = v.size ();
+  s.triangles.clear ();
+  s.x.resize (n);
+  s.y.resize (n);
+  bool valid = true;
+  double normal[3] = {0, 0, 0};
+  for (int i = 0; i < n; i++)
+  {
+      octave_idx_type a = v[i] - 1;
+      octave_idx_type b = v[(i + 1) % n] - 1;
+      if (a >= V_rows || b >= V_rows)
+      {
+          valid = false;
+          break;
+      }
+      for (int k = 0; k < 3; k++)
+      {
+          int k1 = (k + 1) % 3;
+          int k2 = (k + 2) % 3;
+          normal[k] += (V[a + k1 * V_rows] - V[b + k1 * V_rows])
+                       * (V[a + k2 * V_rows] + V[b + k2 * V_rows]);
+      }
+  }
+  bool convex = true;
+  if (valid)
+  {
+      // drop the dominant axis of the normal and keep the remaining two in
+      // cyclic order, so that the projected polygon is counterclockwise
+      int axis = 0;
+      for (int k = 1; k < 3; k++)
+      {
+          if (std::fabs (normal[k]) > std::fabs (normal[axis]))
+          {
+              axis = k;
+          }
+      }
+      int u = (axis + 1) % 3;
+      int w = (axis + 2) % 3;
+      double orientation = normal[axis] < 0 ? -1 : 1;
+      for (int i = 0; i < n; i++)
+      {
+          s.x[i] = V[v[i] - 1 + u * V_rows];
+          s.y[i] = orientation * V[v[i] - 1 + w * V_rows];
+      }
+      for (int i = 0; i < n && convex; i++)
+      {
+          if (signed_area (s, (i + n - 1) % n, i, (i + 1) % n) < 0)
+          {
+              convex = false;
+          }
+      }
+  }
+  if (valid && ! convex)
+  {
+      s.remaining.resize (n);
+      for (int i = 0; i < n; i++)
+      {
+          s.remaining[i] = i;
+      }
+      while (s.remaining.size () > 3)
+      {
+          int m = s.remaining.size ();
+          bool clipped = false;
+          for (int k = 0; k < m && ! clipped; k++)
+          {
+              int a = s.remaining[(k + m - 1) % m];
+              int b = s.remaining[k];
+              int c = s.remaining[(k + 1) % m];
+              if (signed_area (s, a, b, c) <= 0)
+              {
+                  continue;
+              }
+              // an ear must not contain any other remaining vertex
+              bool ear = true;
+              for (int j = 0; j < m && ear; j++)
+              {
+                  int q = s.remaining[j];
+                  if (q == a || q == b || q == c)
+                  {
+                      continue;
+                  }
+                  if (signed_area (s, a, b, q) >= 0 && signed_area (s, b, c, q) >= 0
+                      && signed_area (s, c, a, q) >= 0)
+                  {
+                      ear = false;
+                  }
+              }
+              if (ear)
+              {
+                  s.triangles.push_back (a);
+                  s.triangles.push_back (b);
+                  s.triangles.push_back (c);
+                  s.remaining.erase (s.remaining.begin () + k);
+                  clipped = true;
+              }
+          }
+          // degenerate polygons without any ear are finished with a fan
+          if (! clipped)
+          {
+              break;
+          }
+      }
+      // fan over the remaining vertices
+      for (size_t i = 1; i + 1 < s.remaining.size (); i++)
+      {
+          s.triangles.push_back (s.remaining[0]);
+          s.triangles.push_back (s.remaining[i]);
+          s.triangles.push_back (s.remaining[i + 1]);
+      }
+      return;
+  }
+  for (int i = 1; i + 1 < n; i++)
+  {
+      s.triangles.push_back (0);
+      s.triangles.push_back (i);
+      s.triangles.push_back (i + 1);
+  }
+}
+
+// o, g or usemtl statement found by the first pass when indexing the obj
+// file, along with the elements counted in the chunk before the statement
+struct ObjStatement
+{
+  const char *line;
+  char type;
+  std::string name;
+  octave_idx_type count[NUM_ELEMENTS];
+  octave_idx_type polygons;
+};
+
+// newline aligned chunk of the obj file along with the number of elements
+// it contains and the row offsets of these elements in the output arrays
+struct ObjChunk
+{
+  const char *begin;
+  const char *end;
+  octave_idx_type count[NUM_ELEMENTS];
+  octave_idx_type offset[NUM_ELEMENTS];
+  std::string mtl_filename;
+  bool triangular;
+  // whether the chunk lies in a mapped file, whose pages may be released
+  bool mapped;
+  // whether polygons are triangulated, in which case a face with n vertices
+  // counts as n - 2 faces, and the number of source polygons in the chunk,
+  // their offset in the file and whether any of them has more than three
+  // vertices
+  bool triangulate;
+  octave_idx_type polygons;
+  octave_idx_type polygon_offset;
+  bool has_polygons;
+  // whether the first pass records the o, g and usemtl statements of the
+  // chunk for the group index
+  bool index;
+  std::vector<ObjStatement> statements;
+};
+
+// column-major storage of the output arrays and their number of rows
+struct ObjArrays
+{
+  // vertex elements are stored as double, whereas faces are stored in the
+  // requested index class
+  void *data[NUM_ELEMENTS];
+  octave_idx_type rows[NUM_ELEMENTS];
+  int index_class;
+  // source polygon of each face, if requested
+  double *polygon_map;
+  // whether the second pass stores vertex elements and faces.  Triangulating
+  // polygons requires all vertices to be stored before any face is parsed
+  bool fill_vertices;
+  bool fill_faces;
+};
+
+// find the end of the line starting at p
+static inline const char *find_line_end (const char *p, const char *file_end)
+{
+  const char *line_end = static_cast<const char *>
+                         (memchr (p, '\n', file_end - p));
+  return line_end ? line_end : file_end;
+}
+
+// store the material library filename referenced in an mtllib line
+static inline void parse_mtllib (const char *line, const char *line_end,
+                                 std::string& mtl_filename)
+{
+  const char *str_end = line_end;
+  while (str_end > line && is_blank (str_end[-1]))
+  {
+      str_end--;
+  }
+  const char *str_start = str_end;
+  while (str_start > line && str_start[-1] != ' ')
+  {
+      str_start--;
+  }
+  std::string mtl_line (line, str_end - line);
+  size_t dot_slash = mtl_line.find ("./");
+  if (dot_slash != std::string::npos)
+  {
+      str_start = line + dot_slash + 2;
+  }
+  mtl_filename.assign (str_start, str_end - str_start);
+}
+
+// name of an o, g or usemtl statement, which ends at the end of the line
+static inline std::string statement_name (const char *p, const char *line_end)
+{
+  p = skip_blanks (p, line_end);
+  while (line_end > p && is_blank (line_end[-1]))
+  {
+      line_end--;
+  }
+  return std::string (p, line_end - p);
+}
+
+// record an o, g or usemtl statement of the chunk
+static inline void add_statement (ObjChunk *chunk, const char *line,
+                                  const char *name, const char *line_end,
+                                  char type)
+{
+  ObjStatement statement;
+  statement.line = line;
+  statement.type = type;
+  statement.name = statement_name (name, line_end);
+  for (int k = 0; k < NUM_ELEMENTS; k++)
+  {
+      statement.count[k] = chunk->count[k];
+  }
+  statement.polygons = chunk->polygons;
+  chunk->statements.push_back (statement);
+}
+
+// count the vertices of a face record
+static inline int count_face_vertices (const char *p, const char *end)
+{
+  int n = 0;
+  p = skip_blanks (p, end);
+  while (p < end)
+  {
+      n++;
+      while (p < end && ! is_blank (*p))
+      {
+          p++;
+      }
+      p = skip_blanks (p, end);
+  }
+  return n;
+}
+
+// first pass: count the elements in the chunk.  Faces are counted towards
+// texture and normal faces according to the layout of their first vertex
+static inline void count_chunk (ObjChunk *chunk, const ObjArrays *)
+{
+  for (int k = 0; k < NUM_ELEMENTS; k++)
+  {
+      chunk->count[k] = 0;
+  }
+  chunk->polygons = 0;
+  chunk->has_polygons = false;
+  chunk->statements.clear ();
+  const char *p = chunk->begin;
+  const char *released = p;
+  while (p < chunk->end)
+  {
+      if (chunk->mapped && p - released > release_interval)
+      {
+          release_pages (released, p);
+          released = p;
+      }
+      const char *line_end = find_line_end (p, chunk->end);
+      const char *line = p;
+      p = line_end + 1;
+      octave_idx_type length = line_end - line;
+      if (length > 2 && line[0] == 'm' && line[1] == 't' && line[2] == 'l')
+      {
+          parse_mtllib (line, line_end, chunk->mtl_filename);
+      }
+      else if (length > 1 && line[0] == 'v' && is_blank (line[1]))
+      {
+          chunk->count[VERTEX]++;
+      }
+      else if (chunk->index && length > 1 && (line[0] == 'o' || line[0] == 'g')
+               && is_blank (line[1]))
+      {
+          add_statement (chunk, line, line + 2, line_end, line[0]);
+      }
+      else if (chunk->index && length > 6 && memcmp (line, "usemtl", 6) == 0
+               && is_blank (line[6]))
+      {
+          add_statement (chunk, line, line + 7, line_end, 'u');
+      }
+      else if (length > 2 && line[0] == 'v' && line[1] == 'n' && is_blank (line[2]))
+      {
+          chunk->count[NORMALS]++;
+      }
+      else if (length > 2 && line[0] == 'v' && line[1] == 't' && is_blank (line[2]))
+      {
+          chunk->count[TEXTURE]++;
+      }
+      else if (length > 1 && line[0] == 'f' && is_blank (line[1]))
+      {
+          // a polygon with n vertices is split into n - 2 triangles
+          octave_idx_type faces = 1;
+          if (chunk->triangulate)
+          {
+              int n = count_face_vertices (line + 2, line_end);
+              if (n > 3)
+              {
+                  faces = n - 2;
+                  chunk->has_polygons = true;
+              }
+          }
+          chunk->polygons++;
+          chunk->count[FACE] += faces;
+          const char *c = skip_blanks (line + 2, line_end);
+          while (c < line_end && is_digit (*c))
+          {
+              c++;
+          }
+          if (c < line_end && *c == '/')
+          {
+              c++;
+              if (c < line_end && *c == '/')
+              {
+                  chunk->count[FACE_NORMALS] += faces;
+              }
+              else
+              {
+                  chunk->count[FACE_TEXTURE] += faces;
+                  while (c < line_end && is_digit (*c))
+                  {
+                      c++;
+                  }
+                  if (c < line_end && *c == '/')
+                  {
+                      chunk->count[FACE_NORMALS] += faces;
+                  }
+              }
+          }
+      }
+  }
+  if (chunk->mapped)
+    release_pages (released, chunk->end);
+}
+
+// store n values in row r of a column-major array with the given rows
+template <typename D, typename T>
+static inline void store_row (D *data, octave_idx_type rows,
+                              octave_idx_type r, const T *values, int n)
+{
+  for (int j = 0; j < n; j++)
+  {
+      data[r + j * rows] = values[j];
+  }
+}
+
+// store a row of face indices in the index class of the output arrays.
+// Returns false if an index does not fit the index class
+static inline bool store_index_row (const ObjArrays *arrays, int k,
+                                    octave_idx_type r, const octave_idx_type *values)
+{
+  switch (arrays->index_class)
+  {
+      case INDEX_INT32:
+        for (int j = 0; j < 3; j++)
+        {
+            if (values[j] > INT32_MAX)
+              return false;
+        }
+        store_row (static_cast<int32_t *> (arrays->data[k]), arrays->rows[k],
+                   r, values, 3);
+        break;
+      case INDEX_UINT32:
+        for (int j = 0; j < 3; j++)
+        {
+            if (values[j] > UINT32_MAX)
+              return false;
+        }
+        store_row (static_cast<uint32_t *> (arrays->data[k]), arrays->rows[k],
+                   r, values, 3);
+        break;
+      case INDEX_INT64:
+        store_row (static_cast<int64_t *> (arrays->data[k]), arrays->rows[k],
+                   r, values, 3);
+        break;
+      default:
+        store_row (static_cast<double *> (arrays->data[k]), arrays->rows[k],
+                   r, values, 3);
+  }
+  return true;
+}
+
+// second pass: parse the elements of the chunk straight into their rows of
+// the output arrays.  The face layout is determined from the first face of
+// the chunk and subsequent faces are scanned with the corresponding fast path
+static inline void fill_chunk (ObjChunk *chunk, const ObjArrays *arrays)
+{
+  chunk->triangular = true;
+  octave_idx_type row[NUM_ELEMENTS];
+  for (int k = 0; k < NUM_ELEMENTS; k++)
+  {
+      row[k] = chunk->offset[k];
+  }
+  octave_idx_type polygon = chunk->polygon_offset;
+  int face_layout = FACE_UNKNOWN;
+  std::vector<octave_idx_type> pv, pvt, pvn;
+  PolygonScratch scratch;
+  const char *p = chunk->begin;
+  const char *released = p;
+  while (p < chunk->end)
+  {
+      if (chunk->mapped && p - released > release_interval)
+      {
+          release_pages (released, p);
+          released = p;
+      }
+      const char *line_end = find_line_end (p, chunk->end);
+      const char *line = p;
+      p = line_end + 1;
+      octave_idx_type length = line_end - line;
+      if (arrays->fill_vertices && length > 1 && line[0] == 'v' && is_blank (line[1]))
+      {
+          double xyz[3];
+          parse_doubles (line + 2, line_end, xyz, 3);
+          store_row (static_cast<double *> (arrays->data[VERTEX]),
+                     arrays->rows[VERTEX], row[VERTEX]++, xyz, 3);
+          continue;
+      }
+      else if (arrays->fill_vertices && length > 2 && line[0] == 'v'
+               && line[1] == 'n' && is_blank (line[2]))
+      {
+          double xyz[3];
+          parse_doubles (line + 3, line_end, xyz, 3);
+          store_row (static_cast<double *> (arrays->data[NORMALS]),
+                     arrays->rows[NORMALS], row[NORMALS]++, xyz, 3);
+          continue;
+      }
+      else if (arrays->fill_vertices && length > 2 && line[0] == 'v'
+               && line[1] == 't' && is_blank (line[2]))
+      {
+          double uv[2];
+          parse_doubles (line + 3, line_end, uv, 2);
+          store_row (static_cast<double *> (arrays->data[TEXTURE]),
+                     arrays->rows[TEXTURE], row[TEXTURE]++, uv, 2);
+          continue;
+      }
+      if (arrays->fill_faces && length > 1 && line[0] == 'f' && is_blank (line[1]))
+      {
+          octave_idx_type v[3], vt[3], vn[3];
+          bool parsed = false;
+          // try the fast path of the layout found in the first face
+          switch (face_layout)
+          {
+              case FACE_V:
+                parsed = parse_triangle<FACE_V> (line + 2, line_end, v, vt, vn);
+                break;
+              case FACE_VT:
+                parsed = parse_triangle<FACE_VT> (line + 2, line_end, v, vt, vn);
+                break;
+              case FACE_VTN:
+                parsed = parse_triangle<FACE_VTN> (line + 2, line_end, v, vt, vn);
+                break;
+              case FACE_VN:
+                parsed = parse_triangle<FACE_VN> (line + 2, line_end, v, vt, vn);
+                break;
+          }
+          int layout = face_layout;
+          int count = 3;
+          // otherwise fall back to the generic parser, which also rejects
+          // faces with more than three vertices unless polygons are
+          // triangulated
+          if (! parsed)
+          {
+              count = parse_face (line + 2, line_end, pv, pvt, pvn, layout);
+              if (count < 3 || (count > 3 && ! chunk->triangulate))
+              {
+                  chunk->triangular = false;
+                  return;
+              }
+              if (face_layout == FACE_UNKNOWN)
+              {
+                  face_layout = layout;
+              }
+          }
+          if (count == 3)
+          {
+              if (! parsed)
+              {
+                  std::copy (pv.begin (), pv.end (), v);
+                  std::copy (pvt.begin (), pvt.end (), vt);
+                  std::copy (pvn.begin (), pvn.end (), vn);
+              }
+              scratch.triangles.assign (3, 0);
+              scratch.triangles[1] = 1;
+              scratch.triangles[2] = 2;
+          }
+          else
+          {
+              triangulate_polygon (static_cast<const double *> (arrays->data[VERTEX]),
+                                   arrays->rows[VERTEX], pv, scratch);
+          }
+          polygon++;
+          for (size_t t = 0; t < scratch.triangles.size (); t += 3)
+          {
+              octave_idx_type tv[3], tvt[3], tvn[3];
+              for (int j = 0; j < 3; j++)
+              {
+                  int i = scratch.triangles[t + j];
+                  tv[j] = (count == 3) ? v[i] : pv[i];
+                  tvt[j] = (count == 3) ? vt[i] : pvt[i];
+                  tvn[j] = (count == 3) ? vn[i] : pvn[i];
+              }
+              if (arrays->polygon_map)
+              {
+                  arrays->polygon_map[row[FACE]] = polygon;
+              }
+              // indices beyond the index class make the face invalid
+              if (! store_index_row (arrays, FACE, row[FACE]++, tv)
+                  || ((layout == FACE_VT || layout == FACE_VTN)
+                      && ! store_index_row (arrays, FACE_TEXTURE,
+                                            row[FACE_TEXTURE]++, tvt))
+                  || ((layout == FACE_VN || layout == FACE_VTN)
+                      && ! store_index_row (arrays, FACE_NORMALS,
+                                            row[FACE_NORMALS]++, tvn)))
+              {
+                  chunk->triangular = false;
+                  return;
+              }
+          }
+      }
+  }
+  if (chunk->mapped)
+    release_pages (released, chunk->end);
+}
+
+// run a pass over every chunk on a pool of worker threads, which pick the
+// next unprocessed chunk until all chunks are done
+static inline void for_each_chunk (std::vector<ObjChunk>& chunks,
+                                   void (*pass) (ObjChunk *, const ObjArrays *),
+                                   const ObjArrays *arrays, int num_threads)
+{
+  run_tasks (chunks.size (), num_threads, [&] (size_t i)
+  {
+    pass (&chunks[i], arrays);
+  });
+}
+
+#endif
@@ -0,0 +1,1018 @@
+/*
+Copyright (C) 2018-2020 Andreas Bertsatos <abertsatos@biol.uoa.gr>
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free Software
+Foundation; either version 3 of the License, or (at your option) any later
+version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+details.
+
+You should have received a copy of the GNU General Public License along with
+this program; if not, see <http://www.gnu.org/licenses/>.
+*/
+
+#if ! defined (objWriter_h)
+#define objWriter_h 1
+
+// Buffered output engine for Wavefront obj files.  Numbers are formatted
+// without iostreams or locales into a large reusable buffer, which is
+// written to the file with a single call whenever it fills up.  The file is
+// written under a temporary name and only moved to its final name once it is
+// complete, so that other processes never read a partially written file.
+// Files may be compressed with gzip or zstd on a separate thread while the
+// next block of text is being formatted.
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <cerrno>
+#if ! defined (_WIN32)
+#include <unistd.h>
+#endif
+#if defined (HAVE_ZLIB)
+#include <zlib.h>
+#endif
+#if defined (HAVE_ZSTD)
+#include <zstd.h>
+#endif
+#if defined (__has_include)
+#if __has_include (<charconv>)
+#include <charconv>
+#endif
+#endif
+
+#include <octave/oct.h>
+
+#include "meshIndex.h"
+
+// format doubles with the shortest representation that reads back to the
+// same value, instead of a fixed number of significant digits
+static const int PRECISION_ROUNDTRIP = 0;
+
+// policies of the writers for a filename that already exists
+enum ExistingFile {EXISTING_FAIL, EXISTING_OVERWRITE, EXISTING_RENAME};
+
+// policy with the given name, or -1 if it is not supported
+static inline int existing_file_value (const std::string& name)
+{
+  if (name == "fail")
+    return EXISTING_FAIL;
+  if (name == "overwrite")
+    return EXISTING_OVERWRITE;
+  if (name == "rename")
+    return EXISTING_RENAME;
+  return -1;
+}
+
+// compression formats of the written files
+enum OutputCompression {OUTPUT_PLAIN, OUTPUT_GZIP, OUTPUT_ZSTD};
+
+// compression format with the given name, or -1 if it is not supported
+static inline int output_compression_value (const std::string& name)
+{
+  if (name == "none")
+    return OUTPUT_PLAIN;
+  if (name == "gzip")
+    return OUTPUT_GZIP;
+  if (name == "zstd")
+    return OUTPUT_ZSTD;
+  return -1;
+}
+
+static inline bool ends_with (const std::string& s, const std::string& suffix)
+{
+  return s.length () >= suffix.length ()
+         && s.compare (s.length () - suffix.length (), suffix.length (),
+                       suffix) == 0;
+}
+
+// compression format implied by the extension of the filename
+static inline int output_compression_of (const std::string& filename)
+{
+  if (ends_with (filename, ".gz"))
+    return OUTPUT_GZIP;
+  if (ends_with (filename, ".zst"))
+    return OUTPUT_ZSTD;
+  return OUTPUT_PLAIN;
+}
+
+// filename without its .gz or .zst extension
+static inline std::string uncompressed_filename (const std::string& filename)
+{
+  if (ends_with (filename, ".gz"))
+    return filename.substr (0, filename.length () - 3);
+  if (ends_with (filename, ".zst"))
+    return filename.substr (0, filename.length () - 4);
+  return filename;
+}
+
+// material library referenced by an obj file, named after the uncompressed
+// filename with its last three characters replaced by mtl
+static inline std::string material_filename (const std::string& filename)
+{
+  std::string mtl_filename = uncompressed_filename (filename);
+  return mtl_filename.replace (mtl_filename.length () - 3, 3, "mtl");
+}
+
+// first free filename made by appending _1, _2, ... to the name of the
+// given file, before its extension and any compression extension
+static inline std::string free_filename (const std::string& filename)
+{
+  std::string base = uncompressed_filename (filename);
+  size_t dot = base.rfind ('.');
+  size_t slash = base.find_last_of ("/\\");
+  if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+  {
+      dot = base.length ();
+  }
+  for (int n = 1; ; n++)
+  {
+      std::string name = filename.substr (0, dot) + "_" + std::to_string (n)
+                         + filename.substr (dot);
+      std::FILE *file = std::fopen (name.c_str (), "rb");
+      if (! file)
+      {
+          return name;
+      }
+      std::fclose (file);
+  }
+}
+
+// apply the policy for an existing file to filename, which is replaced by a
+// free filename if renaming.  Returns false if the file exists and must be
+// left untouched
+static inline bool resolve_filename (std::string& filename, int if_exists)
+{
+  std::FILE *file = std::fopen (filename.c_str (), "rb");
+  if (! file)
+  {
+      return true;
+  }
+  std::fclose (file);
+  if (if_exists == EXISTING_FAIL)
+  {
+      return false;
+  }
+  if (if_exists == EXISTING_RENAME)
+  {
+      filename = free_filename (filename);
+  }
+  return true;
+}
+
+// compressor of the text written by an ObjWriter, which runs on a separate
+// thread.  Each block handed over by the writer is swapped with a spare
+// buffer, so the writer formats the next block while the previous one is
+// being compressed and written to the file
+class OutputCompressor
+{
+public:
+  // a negative level selects the default level of the format
+  OutputCompressor (std::FILE *file, int compression, int level)
+    : file (file), compression (compression), level (level), pending_length (0),
+      has_pending (false), finishing (false), failed (false), output (1 << 20)
+  { }
+
+  // initialize the compressed stream and start the compressing thread.
+  // Returns false if the format is not supported by this build
+  bool start ()
+  {
+#if defined (HAVE_ZLIB)
+    if (compression == OUTPUT_GZIP)
+    {
+        memset (&zs, 0, sizeof (zs));
+        // a window of 15 bits plus 16 selects the gzip format
+        if (deflateInit2 (&zs, level < 0 ? Z_DEFAULT_COMPRESSION : level,
+                          Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+        {
+            return false;
+        }
+        worker = std::thread (&OutputCompressor::run, this);
+        return true;
+    }
+#endif
+#if defined (HAVE_ZSTD)
+    if (compression == OUTPUT_ZSTD)
+    {
+        zcs = ZSTD_createCCtx ();
+        if (! zcs || (level >= 0 && ZSTD_isError (ZSTD_CCtx_setParameter
+                                    (zcs, ZSTD_c_compressionLevel, level))))
+        {
+            ZSTD_freeCCtx (zcs);
+            return false;
+        }
+        worker = std::thread (&OutputCompressor::run, this);
+        return true;
+    }
+#endif
+    return false;
+  }
+
+  // hand a block of length bytes over to the compressing thread, which
+  // leaves the writer with an empty buffer of the same size
+  void write (std::vector<char>& block, size_t length)
+  {
+    std::unique_lock<std::mutex> lock (mutex);
+    idle.wait (lock, [this] { return ! has_pending; });
+    if (pending.size () < block.size ())
+    {
+        pending.resize (block.size ());
+    }
+    pending.swap (block);
+    pending_length = length;
+    has_pending = true;
+    ready.notify_one ();
+  }
+
+  // compress the remaining blocks, end the compressed stream and stop the
+  // thread.  Returns false if compressing or writing failed
+  bool finish ()
+  {
+    {
+      std::unique_lock<std::mutex> lock (mutex);
+      finishing = true;
+      ready.notify_one ();
+    }
+    worker.join ();
+#if defined (HAVE_ZLIB)
+    if (compression == OUTPUT_GZIP)
+    {
+        deflateEnd (&zs);
+    }
+#endif
+#if defined (HAVE_ZSTD)
+    if (compression == OUTPUT_ZSTD)
+    {
+        ZSTD_freeCCtx (zcs);
+    }
+#endif
+    return ! failed;
+  }
+
+private:
+  void run ()
+  {
+    std::unique_lock<std::mutex> lock (mutex);
+    while (true)
+    {
+        ready.wait (lock, [this] { return has_pending || finishing; });
+        if (! has_pending)
+        {
+            break;
+        }
+        // the writer only touches the pending block after it is released
+        lock.unlock ();
+        compress (pending.data (), pending_length, false);
+        lock.lock ();
+        has_pending = false;
+        idle.notify_one ();
+    }
+    lock.unlock ();
+    compress (0, 0, true);
+  }
+
+  // compress n bytes of text and write the output to the file, ending the
+  // stream if last is set
+  void compress (const char *text, size_t n, bool last)
+  {
+#if defined (HAVE_ZLIB)
+    if (compression == OUTPUT_GZIP)
+    {
+        zs.next_in = reinterpret_cast<Bytef *> (const_cast<char *> (text));
+        zs.avail_in = n;
+        int status = Z_OK;
+        do
+        {
+            zs.next_out = reinterpret_cast<Bytef *> (output.data ());
+            zs.avail_out = output.size ();
+            status = deflate (&zs, last ? Z_FINISH : Z_NO_FLUSH);
+            if (status == Z_STREAM_ERROR)
+            {
+                failed = true;
+                return;
+            }
+            write_output (output.size () - zs.avail_out);
+        }
+        while (zs.avail_out == 0 || (last && status != Z_STREAM_END));
+    }
+#endif
+#if defined (HAVE_ZSTD)
+    if (compression == OUTPUT_ZSTD)
+    {
+        ZSTD_inBuffer input = {text, n, 0};
+        size_t remaining = 0;
+        do
+        {
+            ZSTD_outBuffer out = {output.data (), output.size (), 0};
+            remaining = ZSTD_compressStream2 (zcs, &out, &input,
+                                              last ? ZSTD_e_end : ZSTD_e_continue);
+            if (ZSTD_isError (remaining))
+            {
+                failed = true;
+                return;
+            }
+            write_output (out.pos);
+        }
+        while (input.pos < input.size || (last && remaining != 0));
+    }
+#endif
+#if ! defined (HAVE_ZLIB) && ! defined (HAVE_ZSTD)
+    // start never succeeds without the libraries, so nothing is compressed
+    (void) text;
+    (void) n;
+    (void) last;
+#endif
+  }
+
+  void write_output (size_t n)
+  {
+    if (n > 0 && std::fwrite (output.data (), 1, n, file) != n)
+    {
+        failed = true;
+    }
+  }
+
+  std::FILE *file;
+  int compression;
+  int level;
+  std::thread worker;
+  std::mutex mutex;
+  std::condition_variable ready;
+  std::condition_variable idle;
+  std::vector<char> pending;
+  size_t pending_length;
+  bool has_pending;
+  bool finishing;
+  bool failed;
+  std::vector<char> output;
+#if defined (HAVE_ZLIB)
+  z_stream zs;
+#endif
+#if defined (HAVE_ZSTD)
+  ZSTD_CCtx *zcs;
+#endif
+};
+
+class ObjWriter
+{
+public:
+  // precision is either PRECISION_ROUNDTRIP or the number of significant
+  // digits of the formatted doubles
+  ObjWriter (int precision = PRECISION_ROUNDTRIP)
+    : file (0), buffer (buffer_size), length (0), precision (precision),
+      failed (false), replace (true), existed (false)
+  { }
+
+  ~ObjWriter ()
+  {
+    close ();
+  }
+
+  // open the file for writing.  The text is written to a temporary file next
+  // to filename, which replaces filename when the writer is closed.  Unless
+  // replace_existing is set, an existing filename is never replaced.  The
+  // text is compressed in the given OutputCompression format and level,
+  // where a negative level selects the default level of the format.  Without
+  // an open file, the formatted text accumulates in the buffer
+  bool open (const std::string& filename, bool replace_existing = true,
+             int compression = OUTPUT_PLAIN, int level = -1)
+  {
+    target_file = filename;
+    temp_file = filename + ".tmp";
+#if ! defined (_WIN32)
+    temp_file += std::to_string (getpid ());
+#endif
+    file = std::fopen (temp_file.c_str (), "wb");
+    bool created = file != 0;
+    if (start (replace_existing, compression, level))
+    {
+        return true;
+    }
+    // only a newly created temporary file is removed, since a resumed one
+    // holds the text written so far
+    if (created)
+    {
+        std::remove (temp_file.c_str ());
+    }
+    return false;
+  }
+
+  // reopen the temporary file of a released writer for appending, after
+  // checking that it still holds the size bytes written so far.  Compressed
+  // text is appended as a new gzip member or zstd frame, which decompressors
+  // read as the continuation of the previous ones
+  bool resume (const std::string& filename, const std::string& temporary,
+               long size, bool replace_existing = true,
+               int compression = OUTPUT_PLAIN, int level = -1)
+  {
+    target_file = filename;
+    temp_file = temporary;
+    file = std::fopen (temp_file.c_str (), "r+b");
+    if (file && (std::fseek (file, 0, SEEK_END) != 0
+                 || std::ftell (file) != size))
+    {
+        std::fclose (file);
+        file = 0;
+    }
+    return start (replace_existing, compression, level);
+  }
+
+  // write any buffered text and close the temporary file without moving it
+  // to its final name, so that it can be resumed.  Returns the size of the
+  // temporary file, or -1 if any write failed, in which case the temporary
+  // file is removed
+  long release ()
+  {
+    if (! file)
+    {
+        return -1;
+    }
+    finish ();
+    long size = failed ? -1 : std::ftell (file);
+    if (std::fclose (file) != 0 || size < 0)
+    {
+        failed = true;
+        std::remove (temp_file.c_str ());
+    }
+    file = 0;
+    return failed ? -1 : size;
+  }
+
+  // remove the temporary file of a released writer
+  static void discard (const std::string& temporary)
+  {
+    std::remove (temporary.c_str ());
+  }
+
+  // name of the temporary file, which is moved to the final name on close
+  const std::string& temporary_filename () const
+  {
+    return temp_file;
+  }
+
+  // write any buffered text, close the file and move it to its final name.
+  // Returns false if any write to the file failed or the file could not be
+  // moved, in which case the temporary file is removed
+  bool close ()
+  {
+    if (! file)
+    {
+        return ! failed;
+    }
+    finish ();
+    if (std::fclose (file) != 0)
+    {
+        failed = true;
+    }
+    file = 0;
+    if (! failed && ! publish ())
+    {
+        failed = true;
+    }
+    if (failed)
+    {
+        std::remove (temp_file.c_str ());
+    }
+    return ! failed;
+  }
+
+  // whether the last close failed because the final name already existed
+  // and the writer was not allowed to replace it
+  bool target_existed () const
+  {
+    return existed;
+  }
+
+  void put (char c)
+  {
+    reserve (1);
+    buffer[length++] = c;
+  }
+
+  void put (const char *s, size_t n)
+  {
+    reserve (n);
+    memcpy (buffer.data () + length, s, n);
+    length += n;
+  }
+
+  void put (const char *s)
+  {
+    put (s, strlen (s));
+  }
+
+  void put (const std::string& s)
+  {
+    put (s.data (), s.length ());
+  }
+
+  // format an index in decimal
+  void put_index (octave_idx_type value)
+  {
+    reserve (max_number_length);
+    if (value < 0)
+    {
+        buffer[length++] = '-';
+        value = -value;
+    }
+    char digits[24];
+    int n = 0;
+    do
+    {
+        digits[n++] = '0' + value % 10;
+        value /= 10;
+    }
+    while (value > 0);
+    while (n > 0)
+    {
+        buffer[length++] = digits[--n];
+    }
+  }
+
+  void put_double (double value)
+  {
+    reserve (max_number_length);
+    char *p = buffer.data () + length;
+#if defined (__cpp_lib_to_chars)
+    std::to_chars_result r = precision == PRECISION_ROUNDTRIP
+      ? std::to_chars (p, p + max_number_length, value)
+      : std::to_chars (p, p + max_number_length, value,
+                       std::chars_format::general, precision);
+    length = r.ptr - buffer.data ();
+#else
+    // 17 significant digits always read back to the same double
+    int digits = precision == PRECISION_ROUNDTRIP ? 17 : precision;
+    length += snprintf (p, max_number_length, "%.*g", digits, value);
+#endif
+  }
+
+  // write an element line made of a keyword, such as "v ", followed by n
+  // values separated by spaces
+  void put_line (const char *keyword, const double *values, int n)
+  {
+    put (keyword);
+    for (int j = 0; j < n; j++)
+    {
+        if (j > 0)
+        {
+            put (' ');
+        }
+        put_double (values[j]);
+    }
+    put ('\n');
+  }
+
+  // write a face line with the vertex, texture and normal indices of its
+  // three vertices.  Texture or normal indices are omitted if null
+  void put_face (const octave_idx_type *v, const octave_idx_type *vt,
+                 const octave_idx_type *vn)
+  {
+    put ('f');
+    for (int j = 0; j < 3; j++)
+    {
+        put (' ');
+        put_index (v[j]);
+        if (vt || vn)
+        {
+            put ('/');
+        }
+        if (vt)
+        {
+            put_index (vt[j]);
+        }
+        if (vn)
+        {
+            put ('/');
+            put_index (vn[j]);
+        }
+    }
+    put ('\n');
+  }
+
+  // append the text buffered by another writer without an open file.  Large
+  // texts are written to the file directly instead of being copied
+  void append (const ObjWriter& other)
+  {
+    if (file && ! compressor && other.length >= buffer.size () / 2)
+    {
+        flush ();
+        if (std::fwrite (other.buffer.data (), 1, other.length, file)
+            != other.length)
+        {
+            failed = true;
+        }
+        return;
+    }
+    put (other.buffer.data (), other.length);
+  }
+
+  // discard the buffered text
+  void clear ()
+  {
+    length = 0;
+  }
+
+  int get_precision () const
+  {
+    return precision;
+  }
+
+  // buffered text, which is only meaningful without an open file
+  const char *data () const
+  {
+    return buffer.data ();
+  }
+
+  size_t size () const
+  {
+    return length;
+  }
+
+private:
+  static const size_t buffer_size = 8 << 20;
+  // longest number written by put_index or put_double with at most 17
+  // significant digits
+  static const size_t max_number_length = 32;
+
+  // set up the writer for the newly opened file
+  bool start (bool replace_existing, int compression, int level)
+  {
+    if (! file)
+    {
+        return false;
+    }
+    // the buffer is written in large blocks, so bypass stdio buffering
+    std::setvbuf (file, 0, _IONBF, 0);
+    if (compression != OUTPUT_PLAIN)
+    {
+        compressor.reset (new OutputCompressor (file, compression, level));
+        if (! compressor->start ())
+        {
+            compressor.reset ();
+            std::fclose (file);
+            file = 0;
+            return false;
+        }
+    }
+    failed = false;
+    replace = replace_existing;
+    existed = false;
+    return true;
+  }
+
+  // write any buffered text and finish the compressed stream, leaving the
+  // file open
+  void finish ()
+  {
+    flush ();
+    if (compressor && ! compressor->finish ())
+    {
+        failed = true;
+    }
+    compressor.reset ();
+  }
+
+  // make room for n more bytes, either by writing the buffer to the file
+  // or by growing it
+  void reserve (size_t n)
+  {
+    if (length + n <= buffer.size ())
+    {
+        return;
+    }
+    if (file)
+    {
+        flush ();
+    }
+    if (length + n > buffer.size ())
+    {
+        buffer.resize (std::max (2 * buffer.size (), length + n));
+    }
+  }
+
+  // move the closed temporary file to its final name
+  bool publish ()
+  {
+    if (replace)
+    {
+#if defined (_WIN32)
+        std::remove (target_file.c_str ());
+#endif
+        return std::rename (temp_file.c_str (), target_file.c_str ()) == 0;
+    }
+#if defined (_WIN32)
+    // rename does not replace existing files on Windows
+    if (std::rename (temp_file.c_str (), target_file.c_str ()) != 0)
+    {
+        existed = errno == EEXIST || errno == EACCES;
+        return false;
+    }
+    return true;
+#else
+    // a hard link is created atomically and only if the name is free
+    if (link (temp_file.c_str (), target_file.c_str ()) == 0)
+    {
+        std::remove (temp_file.c_str ());
+        return true;
+    }
+    if (errno == EEXIST)
+    {
+        existed = true;
+        return false;
+    }
+    // file systems without hard links, such as FAT, SMB or some FUSE
+    // mounts, fall back to renaming if the name is free.  A file created
+    // between the check and the rename is then replaced
+    if (access (target_file.c_str (), F_OK) == 0)
+    {
+        existed = true;
+        return false;
+    }
+    return std::rename (temp_file.c_str (), target_file.c_str ()) == 0;
+#endif
+  }
+
+  void flush ()
+  {
+    if (compressor)
+    {
+        if (length > 0)
+        {
+            compressor->write (buffer, length);
+        }
+        length = 0;
+        return;
+    }
+    if (length > 0 && std::fwrite (buffer.data (), 1, length, file) != length)
+    {
+        failed = true;
+    }
+    length = 0;
+  }
+
+  FILE *file;
+  std::vector<char> buffer;
+  size_t length;
+  int precision;
+  bool failed;
+  std::string target_file;
+  std::string temp_file;
+  // whether an existing target file may be replaced
+  bool replace;
+  // whether publishing failed because the target file existed
+  bool existed;
+  // compressor of the written text, if any
+  std::unique_ptr<OutputCompressor> compressor;
+};
+
+// format the rows [0, rows) of an element section by calling
+// format (writer, begin, end) for consecutive ranges of rows.  With several
+// threads, the rows are split into equal chunks, which a pool of worker
+// threads takes in order and formats into a ring of buffers, while the
+// calling thread appends the formatted chunks to out in order.  The workers
+// run up to one ring ahead of the output, so formatting continues while the
+// previous chunks are written, and the output is identical to formatting
+// all rows serially
+template <typename Format>
+static inline void write_rows (ObjWriter& out, octave_idx_type rows,
+                               int num_threads, const Format& format)
+{
+  // smaller sections are not worth the threads
+  const octave_idx_type min_chunk_rows = 1 << 14;
+  const octave_idx_type max_chunk_rows = 1 << 18;
+  if (num_threads <= 1 || rows < 2 * min_chunk_rows)
+  {
+      format (out, 0, rows);
+      return;
+  }
+  octave_idx_type chunk_rows = std::min (max_chunk_rows,
+                                         std::max (min_chunk_rows,
+                                                   rows / num_threads + 1));
+  size_t num_chunks = (rows + chunk_rows - 1) / chunk_rows;
+  num_threads = int (std::min (size_t (num_threads), num_chunks));
+  std::deque<ObjWriter> buffers;
+  for (int t = 0; t < 2 * num_threads; t++)
+  {
+      buffers.emplace_back (out.get_precision ());
+  }
+  std::mutex mutex;
+  std::condition_variable changed;
+  // next chunk to format, number of chunks written and chunks formatted
+  size_t next_chunk = 0;
+  size_t written = 0;
+  std::vector<char> formatted (num_chunks, 0);
+  auto run = [&] ()
+  {
+    while (true)
+    {
+        size_t chunk;
+        {
+          // wait until the buffer of the next chunk has been written
+          std::unique_lock<std::mutex> lock (mutex);
+          changed.wait (lock, [&] { return next_chunk >= num_chunks
+                                           || next_chunk < written + buffers.size (); });
+          if (next_chunk >= num_chunks)
+          {
+              return;
+          }
+          chunk = next_chunk++;
+        }
+        ObjWriter& buffer = buffers[chunk % buffers.size ()];
+        octave_idx_type begin = chunk * chunk_rows;
+        buffer.clear ();
+        format (buffer, begin, std::min (rows, begin + chunk_rows));
+        std::unique_lock<std::mutex> lock (mutex);
+        formatted[chunk] = 1;
+        changed.notify_all ();
+    }
+  };
+  std::vector<std::thread> workers;
+  for (int t = 0; t < num_threads; t++)
+  {
+      workers.push_back (std::thread (run));
+  }
+  for (size_t chunk = 0; chunk < num_chunks; chunk++)
+  {
+      {
+        std::unique_lock<std::mutex> lock (mutex);
+        changed.wait (lock, [&] { return formatted[chunk] != 0; });
+      }
+      out.append (buffers[chunk % buffers.size ()]);
+      std::unique_lock<std::mutex> lock (mutex);
+      written++;
+      changed.notify_all ();
+  }
+  for (size_t t = 0; t < workers.size (); t++)
+  {
+      workers[t].join ();
+  }
+}
+
+// write the rows of an element matrix as lines starting with the keyword,
+// reading each row from the column-major data of the matrix
+static inline void write_element (ObjWriter& out, const char *keyword,
+                                  const Matrix& M, int num_threads)
+{
+  const double *data = M.data ();
+  octave_idx_type rows = M.rows ();
+  int columns = M.columns ();
+  write_rows (out, rows, num_threads,
+              [&] (ObjWriter& writer, octave_idx_type begin,
+                   octave_idx_type end)
+  {
+    double values[3];
+    for (octave_idx_type i = begin; i < end; i++)
+    {
+        for (int j = 0; j < columns; j++)
+        {
+            values[j] = data[i + j * rows];
+        }
+        writer.put_line (keyword, values, columns);
+    }
+  });
+}
+
+// write the faces of a mesh along with their texture and normal indices.
+// The face layout (v, v/vt, v//vn or v/vt/vn) is fixed at compile time.
+// offsets holds the number of vertices, texture coordinates and vertex
+// normals preceding the mesh in the file, which are added to its indices
+template <bool texture, bool normals>
+static inline void write_faces (ObjWriter& out, const IndexView& F,
+                                const IndexView& FT, const IndexView& FN,
+                                const octave_idx_type *offsets,
+                                int num_threads)
+{
+  write_rows (out, F.rows (), num_threads,
+              [&] (ObjWriter& writer, octave_idx_type begin,
+                   octave_idx_type end)
+  {
+    octave_idx_type v[3], vt[3], vn[3];
+    for (octave_idx_type i = begin; i < end; i++)
+    {
+        for (int j = 0; j < 3; j++)
+        {
+            v[j] = F(i,j) + offsets[0];
+            if (texture)
+            {
+                vt[j] = FT(i,j) + offsets[1];
+            }
+            if (normals)
+            {
+                vn[j] = FN(i,j) + offsets[2];
+            }
+        }
+        writer.put_face (v, texture ? vt : 0, normals ? vn : 0);
+    }
+  });
+}
+
+// elements of a mesh given to a writer in the argument forms of writeObj,
+// i.e. V, F, [VT, FT], [VN, FN] followed by the filename and property/value
+// pairs.  The matrices share their data with the arguments
+struct MeshArguments
+{
+  Matrix V, VT, VN;
+  octave_value F, FT, FN;
+  bool texture, normals;
+  std::string filename;
+  // position of the first property/value pair
+  int options;
+};
+
+// check and store the mesh arguments, which start at position first of args
+// after any leading arguments of the caller.  Returns an error message,
+// which is empty on success
+static inline std::string parse_mesh_arguments (const octave_value_list& args,
+                                                MeshArguments& mesh,
+                                                int first = 0)
+{
+  int num_args = 0;
+  while (first + num_args < args.length ()
+         && ! args(first + num_args).is_string ())
+  {
+      num_args++;
+  }
+  num_args++;
+  if ((num_args != 3 && num_args != 5 && num_args != 7)
+      || (args.length () - first - num_args) % 2 != 0)
+  {
+      return "Invalid number of input arguments.";
+  }
+  for (int i = 0; i < num_args - 1; i++)
+  {
+      if (! args(first + i).is_matrix_type ())
+      {
+          return "All arguments before the filename should be real matrices.";
+      }
+  }
+  octave_idx_type third_columns = num_args == 5 ? args(first + 2).columns () : 0;
+  mesh.texture = num_args == 7 || third_columns == 2;
+  mesh.normals = num_args == 7 || third_columns == 3;
+  if (num_args == 5 && ! mesh.texture && ! mesh.normals)
+  {
+      return "Third input argument should be an Nx2 matrix with texture\n"
+             "coordinates or an Nx3 matrix with vertex normals.";
+  }
+  int normals_arg = mesh.texture ? 4 : 2;
+  mesh.V = args(first).array_value ();
+  mesh.F = args(first + 1);
+  mesh.VT = mesh.texture ? Matrix (args(first + 2).array_value ())
+                         : Matrix (0, 2);
+  mesh.FT = mesh.texture ? args(first + 3) : octave_value (Matrix (0, 3));
+  mesh.VN = mesh.normals ? Matrix (args(first + normals_arg).array_value ())
+                         : Matrix (0, 3);
+  mesh.FN = mesh.normals ? args(first + normals_arg + 1)
+                         : octave_value (Matrix (0, 3));
+  mesh.filename = args(first + num_args - 1).string_value ();
+  mesh.options = first + num_args;
+  octave_idx_type F_rows = mesh.F.rows ();
+  if (mesh.V.rows () < 3)
+  {
+      return "There should be at least 3 vertices in the mesh.";
+  }
+  if (mesh.V.columns () != 3)
+  {
+      return "Vertex matrix should be Nx3 containing x,y,z coordinates.";
+  }
+  if (F_rows < 1)
+  {
+      return "There should be at least 1 face in the mesh.";
+  }
+  if (mesh.F.columns () != 3)
+  {
+      return "Face matrix should be Nx3 containing three vertices.";
+  }
+  if (mesh.texture && (mesh.VT.columns () != 2 || mesh.FT.columns () != 3))
+  {
+      return "Texture coordinates and texture faces should be Nx2 and Nx3 matrices.";
+  }
+  if (mesh.texture && mesh.FT.rows () != F_rows)
+  {
+      return "Faces and texture faces should contain the same\n"
+             "number of values.";
+  }
+  if (mesh.normals && (mesh.VN.columns () != 3 || mesh.FN.columns () != 3))
+  {
+      return "Vertex normals and face normals should be Nx3 matrices.";
+  }
+  if (mesh.normals && mesh.FN.rows () != F_rows)
+  {
+      return "Faces and face normals should contain the same\n"
+             "number of values.";
+  }
+  return "";
+}
+
+#endif
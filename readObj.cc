@@ -16,24 +16,1045 @@ this program; if not, see <http://www.gnu.org/licenses/>.
 */
 
 #include <iostream>
-#include <string>
 #include <fstream>
+#include <string>
 #include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#if defined (HAVE_ZLIB)
+#include <zlib.h>
+#endif
+#if defined (HAVE_ZSTD)
+#include <zstd.h>
+#endif
 #include <octave/oct.h>
+#include "objParser.h"
+
+// number of columns of each output array
+static const int element_columns[NUM_ELEMENTS] = {3, 3, 2, 3, 3, 3};
+
+// split the text in [data, data + size) into newline aligned chunks, one for
+// each worker thread, unless the text is too small to be worth splitting.
+// The chunks take their parsing options from prototype
+static std::vector<ObjChunk> split_chunks (const char *data, size_t size,
+                                           int num_threads,
+                                           const ObjChunk& prototype)
+{
+  const char *file_end = data + size;
+  size_t min_chunk_size = 1 << 20;
+  size_t num_chunks = std::min (size_t (num_threads), size / min_chunk_size + 1);
+  std::vector<ObjChunk> chunks;
+  const char *chunk_begin = data;
+  for (size_t i = 1; i <= num_chunks && chunk_begin < file_end; i++)
+  {
+      const char *chunk_end = file_end;
+      if (i < num_chunks)
+      {
+          chunk_end = data + size / num_chunks * i;
+          if (chunk_end < chunk_begin)
+          {
+              chunk_end = chunk_begin;
+          }
+          chunk_end = std::min (find_line_end (chunk_end, file_end) + 1, file_end);
+      }
+      ObjChunk chunk = prototype;
+      chunk.begin = chunk_begin;
+      chunk.end = chunk_end;
+      chunks.push_back (chunk);
+      chunk_begin = chunk_end;
+  }
+  return chunks;
+}
+
+// compute the row offsets of each counted chunk in the output arrays as the
+// prefix sum of the counts and return whether any chunk holds polygons
+static bool prefix_offsets (std::vector<ObjChunk>& chunks,
+                            octave_idx_type *total, std::string& mtl_filename)
+{
+  octave_idx_type polygons = 0;
+  bool has_polygons = false;
+  for (int k = 0; k < NUM_ELEMENTS; k++)
+  {
+      total[k] = 0;
+  }
+  for (size_t i = 0; i < chunks.size (); i++)
+  {
+      for (int k = 0; k < NUM_ELEMENTS; k++)
+      {
+          chunks[i].offset[k] = total[k];
+          total[k] += chunks[i].count[k];
+      }
+      chunks[i].polygon_offset = polygons;
+      polygons += chunks[i].polygons;
+      has_polygons = has_polygons || chunks[i].has_polygons;
+      if (! chunks[i].mtl_filename.empty ())
+      {
+          mtl_filename = chunks[i].mtl_filename;
+      }
+  }
+  return has_polygons;
+}
+
+// allocate the output array of element k, storing faces in the requested
+// index class, and return its raw column-major data
+static void *allocate_element (MeshArray *array, int k, octave_idx_type rows,
+                               int index_class)
+{
+  array->allocate (rows, element_columns[k],
+                   is_face_element (k) ? index_class : INDEX_DOUBLE);
+  return array->data ();
+}
+
+// allocate the output arrays once and parse each counted chunk straight into
+// its rows.  If polygon_map is given, it receives the source polygon of each
+// face.  Returns false if the mesh is not triangular
+static bool parse_chunks (std::vector<ObjChunk>& chunks, int num_threads,
+                          int index_class, MeshArray **matrices,
+                          Matrix *polygon_map, std::string& mtl_filename)
+{
+  octave_idx_type total[NUM_ELEMENTS];
+  bool has_polygons = prefix_offsets (chunks, total, mtl_filename);
+  ObjArrays arrays;
+  arrays.index_class = index_class;
+  for (int k = 0; k < NUM_ELEMENTS; k++)
+  {
+      arrays.data[k] = allocate_element (matrices[k], k, total[k], index_class);
+      arrays.rows[k] = total[k];
+  }
+  arrays.polygon_map = 0;
+  if (polygon_map)
+  {
+      *polygon_map = Matrix (total[FACE], 1);
+      arrays.polygon_map = polygon_map->fortran_vec ();
+  }
+  // polygons are triangulated in the plane of their vertices, so all
+  // vertices are stored before any face is parsed
+  arrays.fill_vertices = true;
+  arrays.fill_faces = ! has_polygons;
+  for_each_chunk (chunks, fill_chunk, &arrays, num_threads);
+  if (has_polygons)
+  {
+      arrays.fill_vertices = false;
+      arrays.fill_faces = true;
+      for_each_chunk (chunks, fill_chunk, &arrays, num_threads);
+  }
+  for (size_t i = 0; i < chunks.size (); i++)
+  {
+      if (! chunks[i].triangular)
+      {
+          return false;
+      }
+  }
+  return true;
+}
+
+// compression formats of obj files, detected from their magic bytes
+enum Compression
+{
+      COMPRESSION_NONE, COMPRESSION_GZIP, COMPRESSION_ZSTD
+};
+
+static int compression_format (const MappedFile& mesh)
+{
+  const unsigned char *magic = reinterpret_cast<const unsigned char *> (mesh.data);
+  if (mesh.size >= 2 && magic[0] == 0x1F && magic[1] == 0x8B)
+    return COMPRESSION_GZIP;
+  if (mesh.size >= 4 && magic[0] == 0x28 && magic[1] == 0xB5
+      && magic[2] == 0x2F && magic[3] == 0xFD)
+    return COMPRESSION_ZSTD;
+  return COMPRESSION_NONE;
+}
+
+// bounded queue of decompressed blocks passed from the decompressing thread
+// to the parsing thread
+class BlockQueue
+{
+public:
+  BlockQueue () : finished (false), failed (false) { }
+
+  void push (std::string& block)
+  {
+    std::unique_lock<std::mutex> lock (mutex);
+    not_full.wait (lock, [this] () { return blocks.size () < max_blocks; });
+    blocks.push_back (std::string ());
+    blocks.back ().swap (block);
+    not_empty.notify_one ();
+  }
+
+  // wait for the next block, returning false once the queue is exhausted
+  bool pop (std::string& block)
+  {
+    std::unique_lock<std::mutex> lock (mutex);
+    not_empty.wait (lock, [this] () { return ! blocks.empty () || finished; });
+    if (blocks.empty ())
+      return false;
+    block.swap (blocks.front ());
+    blocks.pop_front ();
+    not_full.notify_one ();
+    return true;
+  }
+
+  void finish (bool success)
+  {
+    std::unique_lock<std::mutex> lock (mutex);
+    finished = true;
+    failed = ! success;
+    not_empty.notify_one ();
+  }
+
+  bool finished;
+  bool failed;
+
+private:
+  static const size_t max_blocks = 4;
+  std::deque<std::string> blocks;
+  std::mutex mutex;
+  std::condition_variable not_empty;
+  std::condition_variable not_full;
+};
+
+// size of the decompressed blocks
+static const size_t decompressed_block_size = 16 << 20;
+
+// decompress the mapped file into blocks pushed onto the queue
+static void decompress_blocks (const MappedFile *mesh, int compression,
+                               BlockQueue *queue)
+{
+  bool success = false;
+  std::string block;
+#if defined (HAVE_ZLIB)
+  if (compression == COMPRESSION_GZIP)
+  {
+      z_stream zs;
+      memset (&zs, 0, sizeof (zs));
+      // accept gzip and zlib headers
+      success = (inflateInit2 (&zs, 15 + 32) == Z_OK);
+      zs.next_in = reinterpret_cast<Bytef *> (const_cast<char *> (mesh->data));
+      zs.avail_in = 0;
+      size_t remaining = mesh->size;
+      int status = Z_OK;
+      while (success)
+      {
+          if (zs.avail_in == 0 && remaining > 0)
+          {
+              zs.avail_in = std::min (remaining, size_t (1) << 30);
+              remaining -= zs.avail_in;
+          }
+          block.resize (decompressed_block_size);
+          zs.next_out = reinterpret_cast<Bytef *> (&block[0]);
+          zs.avail_out = block.size ();
+          status = inflate (&zs, Z_NO_FLUSH);
+          block.resize (block.size () - zs.avail_out);
+          if (! block.empty ())
+          {
+              queue->push (block);
+          }
+          if (status == Z_STREAM_END)
+          {
+              // concatenated gzip members are decompressed in sequence
+              if (zs.avail_in == 0 && remaining == 0)
+                break;
+              status = inflateReset (&zs);
+          }
+          if (status != Z_OK && status != Z_BUF_ERROR)
+          {
+              success = false;
+          }
+          else if (status == Z_BUF_ERROR && zs.avail_in == 0 && remaining == 0)
+          {
+              // truncated input
+              success = false;
+          }
+      }
+      inflateEnd (&zs);
+  }
+#endif
+#if defined (HAVE_ZSTD)
+  if (compression == COMPRESSION_ZSTD)
+  {
+      ZSTD_DStream *zds = ZSTD_createDStream ();
+      success = (zds != 0 && ! ZSTD_isError (ZSTD_initDStream (zds)));
+      ZSTD_inBuffer input = {mesh->data, mesh->size, 0};
+      size_t status = 0;
+      bool output_full = false;
+      while (success && (input.pos < input.size || output_full))
+      {
+          block.resize (decompressed_block_size);
+          ZSTD_outBuffer output = {&block[0], block.size (), 0};
+          status = ZSTD_decompressStream (zds, &output, &input);
+          if (ZSTD_isError (status))
+          {
+              success = false;
+              break;
+          }
+          output_full = (output.pos == output.size);
+          block.resize (output.pos);
+          if (! block.empty ())
+          {
+              queue->push (block);
+          }
+      }
+      // a non-zero status at the end of the input means a truncated frame
+      if (status != 0)
+      {
+          success = false;
+      }
+      ZSTD_freeDStream (zds);
+  }
+#endif
+#if ! defined (HAVE_ZLIB) && ! defined (HAVE_ZSTD)
+  // no format is supported, so the queue finishes with a failure
+  (void) mesh;
+  (void) compression;
+#endif
+  queue->finish (success);
+}
+
+// decompress the obj file on a separate thread and append the decompressed
+// blocks to text.  The first pass runs on the parsing thread while the next
+// blocks are being decompressed, counting the elements of each block up to
+// its last complete line, which becomes a chunk of the second pass
+static bool decompress_obj (const MappedFile& mesh, int compression,
+                            const ObjChunk& prototype, std::string& text,
+                            std::vector<ObjChunk>& chunks)
+{
+#if ! defined (HAVE_ZLIB)
+  if (compression == COMPRESSION_GZIP)
+  {
+      std::cout << "readObj was compiled without gzip support.\n";
+      return false;
+  }
+#endif
+#if ! defined (HAVE_ZSTD)
+  if (compression == COMPRESSION_ZSTD)
+  {
+      std::cout << "readObj was compiled without zstd support.\n";
+      return false;
+  }
+#endif
+  // reserve the uncompressed size stored in the gzip trailer, which is only
+  // a hint since it is stored modulo 2^32
+  size_t size_hint = 4 * mesh.size;
+  if (compression == COMPRESSION_GZIP && mesh.size >= 4)
+  {
+      const unsigned char *t = reinterpret_cast<const unsigned char *>
+                               (mesh.data + mesh.size - 4);
+      size_t isize = t[0] | (t[1] << 8) | (t[2] << 16) | (size_t (t[3]) << 24);
+      size_hint = std::max (size_hint, isize);
+  }
+  text.reserve (size_hint);
+  BlockQueue queue;
+  std::thread decompressor (decompress_blocks, &mesh, compression, &queue);
+  std::vector<size_t> bounds (1, 0);
+  std::string block;
+  while (queue.pop (block))
+  {
+      text.append (block);
+      size_t counted = bounds.back ();
+      size_t last_newline = text.rfind ('\n');
+      if (last_newline != std::string::npos && last_newline + 1 > counted)
+      {
+          ObjChunk chunk = prototype;
+          chunk.begin = text.data () + counted;
+          chunk.end = text.data () + last_newline + 1;
+          chunk.mapped = false;
+          count_chunk (&chunk, 0);
+          chunks.push_back (chunk);
+          bounds.push_back (last_newline + 1);
+      }
+  }
+  decompressor.join ();
+  if (queue.failed)
+  {
+      std::cout << "Failure decompressing file.\n";
+      return false;
+  }
+  // count the final line if it has no trailing newline
+  if (bounds.back () < text.size ())
+  {
+      ObjChunk chunk = prototype;
+      chunk.begin = text.data () + bounds.back ();
+      chunk.end = text.data () + text.size ();
+      chunk.mapped = false;
+      count_chunk (&chunk, 0);
+      chunks.push_back (chunk);
+      bounds.push_back (text.size ());
+  }
+  // the text may have been reallocated while appending blocks
+  for (size_t i = 0; i < chunks.size (); i++)
+  {
+      for (size_t j = 0; j < chunks[i].statements.size (); j++)
+      {
+          chunks[i].statements[j].line = text.data () + bounds[i]
+                                         + (chunks[i].statements[j].line
+                                            - chunks[i].begin);
+      }
+      chunks[i].begin = text.data () + bounds[i];
+      chunks[i].end = text.data () + bounds[i + 1];
+  }
+  return true;
+}
 
-struct Coord
+// 64-bit hash of the bytes in [p, p + n), which processes four interleaved
+// 64-bit lanes so that hashing runs close to memory bandwidth
+static uint64_t hash_bytes (const char *p, size_t n, uint64_t seed)
 {
-	    double x, y, z;
+  const uint64_t prime1 = 0x9E3779B185EBCA87ULL;
+  const uint64_t prime2 = 0xC2B2AE3D27D4EB4FULL;
+  const uint64_t prime3 = 0x165667B19E3779F9ULL;
+  uint64_t lane[4] = {seed + prime1 + prime2, seed + prime2, seed,
+                      seed - prime1};
+  const char *end = p + n;
+  while (end - p >= 32)
+  {
+      for (int i = 0; i < 4; i++)
+      {
+          uint64_t word;
+          memcpy (&word, p + 8 * i, 8);
+          lane[i] += word * prime2;
+          lane[i] = ((lane[i] << 31) | (lane[i] >> 33)) * prime1;
+      }
+      p += 32;
+  }
+  uint64_t h = ((lane[0] << 1) | (lane[0] >> 63))
+               + ((lane[1] << 7) | (lane[1] >> 57))
+               + ((lane[2] << 12) | (lane[2] >> 52))
+               + ((lane[3] << 18) | (lane[3] >> 46));
+  h += n;
+  while (p < end)
+  {
+      h ^= (unsigned char) *p++ * prime3;
+      h = ((h << 11) | (h >> 53)) * prime1;
+  }
+  h ^= h >> 33;
+  h *= prime2;
+  h ^= h >> 29;
+  h *= prime3;
+  h ^= h >> 32;
+  return h;
+}
+
+// content hash of the mapped file.  The file is hashed in fixed size blocks,
+// which are distributed over the worker threads and combined in file order,
+// so the hash does not depend on the number of threads
+static uint64_t hash_file (const MappedFile& mesh, int num_threads)
+{
+  const size_t block_size = 64 << 20;
+  size_t num_blocks = (mesh.size + block_size - 1) / block_size;
+  std::vector<uint64_t> block_hash (num_blocks);
+  size_t num_workers = std::min (size_t (num_threads), num_blocks);
+  std::vector<std::thread> workers;
+  for (size_t w = 0; w < num_workers; w++)
+  {
+      workers.push_back (std::thread ([&, w] ()
+      {
+        for (size_t b = w; b < num_blocks; b += num_workers)
+        {
+            const char *begin = mesh.data + b * block_size;
+            size_t n = std::min (block_size, mesh.size - b * block_size);
+            block_hash[b] = hash_bytes (begin, n, b);
+            release_pages (begin, begin + n);
+        }
+      }));
+  }
+  for (size_t w = 0; w < workers.size (); w++)
+  {
+      workers[w].join ();
+  }
+  return hash_bytes (reinterpret_cast<const char *> (block_hash.data ()),
+                     num_blocks * sizeof (uint64_t), mesh.size);
+}
+
+// size in bytes of each entry of the output array of element k
+static size_t element_size (int k, int index_class)
+{
+  return is_face_element (k) ? index_class_size (index_class) : sizeof (double);
+}
+
+// header of the binary sidecar cache file, which is followed by the .mtl
+// filename padded to a multiple of 8 bytes and the raw column-major data
+// of the output arrays in the order V, F, VT, FT, VN, FN and the polygon
+// map, which is only stored if it was requested.  The faces are stored in
+// their index class
+struct ObjCacheHeader
+{
+  char magic[8];
+  uint64_t version;
+  uint64_t source_size;
+  double source_mtime;
+  uint64_t source_hash;
+  uint64_t rows[NUM_ELEMENTS];
+  uint64_t mtl_length;
+  uint64_t triangulated;
+  uint64_t polygon_rows;
+  uint64_t index_class;
 };
-struct Faces
+static const uint64_t cache_version = 3;
+static const char cache_magic[8] = {'O', 'B', 'J', 'C', 'A', 'C', 'H', 'E'};
+
+// load the output arrays from the sidecar cache file if it exists and it
+// was created from the same source file with the same triangulation and
+// index class.  The polygon map is loaded if it is requested and present in
+// the cache
+static bool read_cache (const std::string& cache_file, const MappedFile& mesh,
+                        uint64_t hash, bool triangulate, int index_class,
+                        MeshArray **matrices, Matrix *polygon_map,
+                        std::string& mtl_filename)
 {
-      int a, b, c;
-};  
-struct TCoord
+  MappedFile cache;
+  if (! cache.open (cache_file) || cache.size < sizeof (ObjCacheHeader))
+  {
+      return false;
+  }
+  ObjCacheHeader header;
+  memcpy (&header, cache.data, sizeof (header));
+  if (memcmp (header.magic, cache_magic, 8) != 0
+      || header.version != cache_version
+      || header.source_size != mesh.size || header.source_mtime != mesh.mtime
+      || header.source_hash != hash || header.triangulated != triangulate
+      || header.index_class != uint64_t (index_class)
+      || (polygon_map && header.polygon_rows != header.rows[FACE]))
+  {
+      return false;
+  }
+  size_t mtl_padded = (header.mtl_length + 7) / 8 * 8;
+  size_t expected = sizeof (header) + mtl_padded;
+  for (int k = 0; k < NUM_ELEMENTS; k++)
+  {
+      expected += header.rows[k] * element_columns[k] * element_size (k, index_class);
+  }
+  expected += header.polygon_rows * sizeof (double);
+  if (cache.size != expected)
+  {
+      return false;
+  }
+  const char *p = cache.data + sizeof (header);
+  mtl_filename.assign (p, header.mtl_length);
+  p += mtl_padded;
+  for (int k = 0; k < NUM_ELEMENTS; k++)
+  {
+      size_t bytes = header.rows[k] * element_columns[k]
+                     * element_size (k, index_class);
+      memcpy (allocate_element (matrices[k], k, header.rows[k], index_class),
+              p, bytes);
+      release_pages (p, p + bytes);
+      p += bytes;
+  }
+  if (polygon_map)
+  {
+      *polygon_map = Matrix (header.polygon_rows, 1);
+      memcpy (polygon_map->fortran_vec (), p,
+              header.polygon_rows * sizeof (double));
+  }
+  return true;
+}
+
+// write the output arrays to the sidecar cache file.  The file is written
+// under a temporary name and renamed, so that concurrent readers never see
+// a partially written cache
+static bool write_cache (const std::string& cache_file, const MappedFile& mesh,
+                         uint64_t hash, bool triangulate, int index_class,
+                         MeshArray **matrices, const Matrix *polygon_map,
+                         const std::string& mtl_filename)
 {
-      double u, v  ;
+  ObjCacheHeader header;
+  memset (&header, 0, sizeof (header));
+  memcpy (header.magic, cache_magic, 8);
+  header.version = cache_version;
+  header.source_size = mesh.size;
+  header.source_mtime = mesh.mtime;
+  header.source_hash = hash;
+  for (int k = 0; k < NUM_ELEMENTS; k++)
+  {
+      header.rows[k] = matrices[k]->rows ();
+  }
+  header.mtl_length = mtl_filename.length ();
+  header.triangulated = triangulate;
+  header.polygon_rows = polygon_map ? polygon_map->rows () : 0;
+  header.index_class = index_class;
+  std::string temp_file = cache_file + ".tmp";
+#if ! defined (_WIN32)
+  temp_file += std::to_string (getpid ());
+#endif
+  std::ofstream outputFile (temp_file.c_str (), std::ios::binary);
+  if (! outputFile.is_open ())
+  {
+      return false;
+  }
+  outputFile.write (reinterpret_cast<const char *> (&header), sizeof (header));
+  std::string mtl_padded = mtl_filename;
+  mtl_padded.resize ((mtl_filename.length () + 7) / 8 * 8, '\0');
+  outputFile.write (mtl_padded.data (), mtl_padded.length ());
+  for (int k = 0; k < NUM_ELEMENTS; k++)
+  {
+      outputFile.write (static_cast<const char *> (matrices[k]->data ()),
+                        matrices[k]->numel () * element_size (k, index_class));
+  }
+  if (polygon_map)
+  {
+      outputFile.write (reinterpret_cast<const char *> (polygon_map->data ()),
+                        polygon_map->numel () * sizeof (double));
+  }
+  outputFile.close ();
+  if (! outputFile || std::rename (temp_file.c_str (), cache_file.c_str ()) != 0)
+  {
+      std::remove (temp_file.c_str ());
+      return false;
+  }
+  return true;
+}
+
+// section of the obj file between two o, g or usemtl statements, which is
+// the unit of the group index.  The offsets are the number of elements in
+// the file before the section, so that face indices can be resolved to the
+// sections holding their vertices
+struct ObjSection
+{
+  uint64_t begin;
+  uint64_t end;
+  octave_idx_type offset[NUM_ELEMENTS];
+  octave_idx_type count[NUM_ELEMENTS];
+  octave_idx_type polygon_offset;
+  // active object, group and material names
+  std::string names[3];
+};
+
+// split the counted chunks of the text into sections at the o, g and usemtl
+// statements recorded by the first pass.  Expects the row offsets of the
+// chunks to be computed
+static std::vector<ObjSection> collect_sections (const std::vector<ObjChunk>& chunks,
+                                                 const char *text, size_t size)
+{
+  std::vector<ObjSection> sections;
+  ObjSection section = ObjSection ();
+  for (size_t i = 0; i <= chunks.size (); i++)
+  {
+      size_t num_statements = i < chunks.size () ? chunks[i].statements.size () : 1;
+      for (size_t j = 0; j < num_statements; j++)
+      {
+          // the end of the text closes the last section
+          uint64_t begin = size;
+          octave_idx_type offset[NUM_ELEMENTS];
+          octave_idx_type polygon_offset = 0;
+          const ObjStatement *statement = 0;
+          if (i < chunks.size ())
+          {
+              statement = &chunks[i].statements[j];
+              begin = statement->line - text;
+              for (int k = 0; k < NUM_ELEMENTS; k++)
+              {
+                  offset[k] = chunks[i].offset[k] + statement->count[k];
+              }
+              polygon_offset = chunks[i].polygon_offset + statement->polygons;
+          }
+          else
+          {
+              for (int k = 0; k < NUM_ELEMENTS; k++)
+              {
+                  offset[k] = chunks.empty () ? 0 : chunks.back ().offset[k]
+                                                    + chunks.back ().count[k];
+              }
+          }
+          section.end = begin;
+          if (section.end > section.begin)
+          {
+              for (int k = 0; k < NUM_ELEMENTS; k++)
+              {
+                  section.count[k] = offset[k] - section.offset[k];
+              }
+              sections.push_back (section);
+          }
+          if (! statement)
+          {
+              break;
+          }
+          section.begin = begin;
+          for (int k = 0; k < NUM_ELEMENTS; k++)
+          {
+              section.offset[k] = offset[k];
+          }
+          section.polygon_offset = polygon_offset;
+          int name = statement->type == 'o' ? 0 : (statement->type == 'g' ? 1 : 2);
+          section.names[name] = statement->name;
+      }
+  }
+  return sections;
+}
+
+// check whether the section belongs to the named object, group or material.
+// A g statement may assign several group names
+static bool section_matches (const ObjSection& section, const std::string& name)
+{
+  if (section.names[0] == name || section.names[2] == name)
+  {
+      return true;
+  }
+  const std::string& groups = section.names[1];
+  size_t pos = 0;
+  while (pos < groups.length ())
+  {
+      size_t end = groups.find_first_of (" \t", pos);
+      if (end == std::string::npos)
+      {
+          end = groups.length ();
+      }
+      if (groups.compare (pos, end - pos, name) == 0)
+      {
+          return true;
+      }
+      pos = end + 1;
+  }
+  return false;
+}
+
+// header of the group index file, which is followed by the .mtl filename
+// and the sections of the obj file, each as a record of 64-bit integers
+// followed by its names.  Strings are padded to a multiple of 8 bytes
+struct ObjIndexHeader
+{
+  char magic[8];
+  uint64_t version;
+  uint64_t source_size;
+  double source_mtime;
+  uint64_t num_sections;
+  uint64_t mtl_length;
 };
-      
+static const uint64_t index_version = 1;
+static const char index_magic[8] = {'O', 'B', 'J', 'I', 'N', 'D', 'E', 'X'};
+// begin, end, offsets, counts, polygon offset and name lengths of a section
+static const int section_fields = 2 + 2 * NUM_ELEMENTS + 1 + 3;
+
+static void append_padded (std::string& buffer, const std::string& str)
+{
+  buffer += str;
+  buffer.resize ((buffer.length () + 7) / 8 * 8, '\0');
+}
+
+// load the sections from the group index file if it exists and it was
+// created from a source file of the same size and modification time.  The
+// content is not hashed, so that loading a few groups does not read the
+// whole obj file
+static bool read_index (const std::string& index_file, const MappedFile& mesh,
+                        std::vector<ObjSection>& sections,
+                        std::string& mtl_filename)
+{
+  MappedFile index;
+  if (! index.open (index_file) || index.size < sizeof (ObjIndexHeader))
+  {
+      return false;
+  }
+  ObjIndexHeader header;
+  memcpy (&header, index.data, sizeof (header));
+  if (memcmp (header.magic, index_magic, 8) != 0
+      || header.version != index_version || header.source_size != mesh.size
+      || header.source_mtime != mesh.mtime)
+  {
+      return false;
+  }
+  const char *p = index.data + sizeof (header);
+  const char *index_end = index.data + index.size;
+  size_t mtl_padded = (header.mtl_length + 7) / 8 * 8;
+  if (size_t (index_end - p) < mtl_padded)
+  {
+      return false;
+  }
+  mtl_filename.assign (p, header.mtl_length);
+  p += mtl_padded;
+  sections.clear ();
+  for (uint64_t i = 0; i < header.num_sections; i++)
+  {
+      uint64_t field[section_fields];
+      if (size_t (index_end - p) < sizeof (field))
+      {
+          return false;
+      }
+      memcpy (field, p, sizeof (field));
+      p += sizeof (field);
+      ObjSection section = ObjSection ();
+      section.begin = field[0];
+      section.end = field[1];
+      for (int k = 0; k < NUM_ELEMENTS; k++)
+      {
+          section.offset[k] = field[2 + k];
+          section.count[k] = field[2 + NUM_ELEMENTS + k];
+      }
+      section.polygon_offset = field[2 + 2 * NUM_ELEMENTS];
+      for (int n = 0; n < 3; n++)
+      {
+          uint64_t length = field[3 + 2 * NUM_ELEMENTS + n];
+          if (size_t (index_end - p) < (length + 7) / 8 * 8)
+          {
+              return false;
+          }
+          section.names[n].assign (p, length);
+          p += (length + 7) / 8 * 8;
+      }
+      if (section.begin > section.end || section.end > mesh.size)
+      {
+          return false;
+      }
+      sections.push_back (section);
+  }
+  return p == index_end;
+}
+
+// write the sections to the group index file under a temporary name, which
+// is renamed once complete
+static bool write_index (const std::string& index_file, const MappedFile& mesh,
+                         const std::vector<ObjSection>& sections,
+                         const std::string& mtl_filename)
+{
+  ObjIndexHeader header;
+  memset (&header, 0, sizeof (header));
+  memcpy (header.magic, index_magic, 8);
+  header.version = index_version;
+  header.source_size = mesh.size;
+  header.source_mtime = mesh.mtime;
+  header.num_sections = sections.size ();
+  header.mtl_length = mtl_filename.length ();
+  std::string buffer (reinterpret_cast<const char *> (&header), sizeof (header));
+  append_padded (buffer, mtl_filename);
+  for (size_t i = 0; i < sections.size (); i++)
+  {
+      const ObjSection& section = sections[i];
+      uint64_t field[section_fields];
+      field[0] = section.begin;
+      field[1] = section.end;
+      for (int k = 0; k < NUM_ELEMENTS; k++)
+      {
+          field[2 + k] = section.offset[k];
+          field[2 + NUM_ELEMENTS + k] = section.count[k];
+      }
+      field[2 + 2 * NUM_ELEMENTS] = section.polygon_offset;
+      for (int n = 0; n < 3; n++)
+      {
+          field[3 + 2 * NUM_ELEMENTS + n] = section.names[n].length ();
+      }
+      buffer.append (reinterpret_cast<const char *> (field), sizeof (field));
+      for (int n = 0; n < 3; n++)
+      {
+          append_padded (buffer, section.names[n]);
+      }
+  }
+  std::string temp_file = index_file + ".tmp";
+#if ! defined (_WIN32)
+  temp_file += std::to_string (getpid ());
+#endif
+  std::ofstream outputFile (temp_file.c_str (), std::ios::binary);
+  if (! outputFile.is_open ())
+  {
+      return false;
+  }
+  outputFile.write (buffer.data (), buffer.length ());
+  outputFile.close ();
+  if (! outputFile || std::rename (temp_file.c_str (), index_file.c_str ()) != 0)
+  {
+      std::remove (temp_file.c_str ());
+      return false;
+  }
+  return true;
+}
+
+// collect the distinct indices of an index array in ascending order and
+// replace each index by its 1-based position among them
+template <typename T>
+static void compact_indices (T *index, octave_idx_type n,
+                             std::vector<octave_idx_type>& used)
+{
+  used.assign (index, index + n);
+  std::sort (used.begin (), used.end ());
+  used.erase (std::unique (used.begin (), used.end ()), used.end ());
+  for (octave_idx_type i = 0; i < n; i++)
+  {
+      index[i] = std::lower_bound (used.begin (), used.end (),
+                                   octave_idx_type (index[i]))
+                 - used.begin () + 1;
+  }
+}
+
+// load the faces of the sections that belong to the named groups and the
+// vertices, texture coordinates and normals they refer to.  Only the
+// sections holding these elements are parsed.  The elements are stored in
+// their file order and the face indices are remapped to this compact range
+static bool load_groups (const char *text, bool mapped,
+                         const std::vector<ObjSection>& sections,
+                         const std::vector<std::string>& groups,
+                         int num_threads, int index_class,
+                         MeshArray **matrices, Matrix *polygon_map)
+{
+  std::vector<bool> selected (sections.size (), false);
+  for (size_t g = 0; g < groups.size (); g++)
+  {
+      bool found = false;
+      for (size_t i = 0; i < sections.size (); i++)
+      {
+          if (section_matches (sections[i], groups[g]))
+          {
+              selected[i] = true;
+              found = true;
+          }
+      }
+      if (! found)
+      {
+          std::cout << "Group " << groups[g] << " not found in obj file.\n";
+          return false;
+      }
+  }
+  // parse the faces of the selected sections
+  const int face_elements[3] = {FACE, FACE_TEXTURE, FACE_NORMALS};
+  const int vertex_elements[3] = {VERTEX, TEXTURE, NORMALS};
+  std::vector<ObjChunk> chunks;
+  octave_idx_type total[NUM_ELEMENTS] = {0};
+  for (size_t i = 0; i < sections.size (); i++)
+  {
+      if (! selected[i] || sections[i].count[FACE] == 0)
+      {
+          continue;
+      }
+      ObjChunk chunk = ObjChunk ();
+      chunk.begin = text + sections[i].begin;
+      chunk.end = text + sections[i].end;
+      chunk.mapped = mapped;
+      chunk.polygon_offset = sections[i].polygon_offset;
+      for (int e = 0; e < 3; e++)
+      {
+          int k = face_elements[e];
+          chunk.count[k] = sections[i].count[k];
+          chunk.offset[k] = total[k];
+          total[k] += chunk.count[k];
+      }
+      chunks.push_back (chunk);
+  }
+  ObjArrays arrays;
+  arrays.index_class = index_class;
+  for (int k = 0; k < NUM_ELEMENTS; k++)
+  {
+      arrays.data[k] = allocate_element (matrices[k], k, total[k], index_class);
+      arrays.rows[k] = total[k];
+  }
+  arrays.polygon_map = 0;
+  if (polygon_map)
+  {
+      *polygon_map = Matrix (total[FACE], 1);
+      arrays.polygon_map = polygon_map->fortran_vec ();
+  }
+  arrays.fill_vertices = false;
+  arrays.fill_faces = true;
+  for_each_chunk (chunks, fill_chunk, &arrays, num_threads);
+  for (size_t i = 0; i < chunks.size (); i++)
+  {
+      if (! chunks[i].triangular)
+      {
+          std::cout << "Mesh is not triangular.\n";
+          return false;
+      }
+  }
+  // collect the elements referred to by the faces in file order and remap
+  // the face indices to their position in this list
+  std::vector<octave_idx_type> used[3];
+  for (int e = 0; e < 3; e++)
+  {
+      MeshArray *faces = matrices[face_elements[e]];
+      void *index = faces->data ();
+      octave_idx_type n = faces->numel ();
+      switch (index_class)
+      {
+          case INDEX_INT32:
+            compact_indices (static_cast<int32_t *> (index), n, used[e]);
+            break;
+          case INDEX_UINT32:
+            compact_indices (static_cast<uint32_t *> (index), n, used[e]);
+            break;
+          case INDEX_INT64:
+            compact_indices (static_cast<int64_t *> (index), n, used[e]);
+            break;
+          default:
+            compact_indices (static_cast<double *> (index), n, used[e]);
+      }
+  }
+  // parse the sections holding any of these elements into temporary arrays
+  std::vector<ObjChunk> sources;
+  std::vector<size_t> source_sections;
+  octave_idx_type source_total[NUM_ELEMENTS] = {0};
+  for (size_t i = 0; i < sections.size (); i++)
+  {
+      bool needed = false;
+      for (int e = 0; e < 3 && ! needed; e++)
+      {
+          int k = vertex_elements[e];
+          std::vector<octave_idx_type>::const_iterator first =
+            std::upper_bound (used[e].begin (), used[e].end (), sections[i].offset[k]);
+          needed = first != used[e].end ()
+                   && *first <= sections[i].offset[k] + sections[i].count[k];
+      }
+      if (! needed)
+      {
+          continue;
+      }
+      ObjChunk chunk = ObjChunk ();
+      chunk.begin = text + sections[i].begin;
+      chunk.end = text + sections[i].end;
+      chunk.mapped = mapped;
+      for (int e = 0; e < 3; e++)
+      {
+          int k = vertex_elements[e];
+          chunk.count[k] = sections[i].count[k];
+          chunk.offset[k] = source_total[k];
+          source_total[k] += chunk.count[k];
+      }
+      sources.push_back (chunk);
+      source_sections.push_back (i);
+  }
+  Matrix source_matrices[3];
+  for (int e = 0; e < 3; e++)
+  {
+      int k = vertex_elements[e];
+      source_matrices[e] = Matrix (source_total[k], element_columns[k]);
+      arrays.data[k] = source_matrices[e].fortran_vec ();
+      arrays.rows[k] = source_total[k];
+  }
+  arrays.polygon_map = 0;
+  arrays.fill_vertices = true;
+  arrays.fill_faces = false;
+  for_each_chunk (sources, fill_chunk, &arrays, num_threads);
+  // copy the referenced rows into the compact output arrays
+  for (int e = 0; e < 3; e++)
+  {
+      int k = vertex_elements[e];
+      octave_idx_type rows = used[e].size ();
+      double *dst = static_cast<double *> (allocate_element (matrices[k], k, rows,
+                                                             index_class));
+      const double *src = source_matrices[e].data ();
+      size_t s = 0;
+      for (octave_idx_type r = 0; r < rows; r++)
+      {
+          octave_idx_type global = used[e][r] - 1;
+          while (s < sources.size ()
+                 && global >= sections[source_sections[s]].offset[k]
+                              + sections[source_sections[s]].count[k])
+          {
+              s++;
+          }
+          if (s == sources.size () || global < sections[source_sections[s]].offset[k])
+          {
+              std::cout << "Faces refer to missing vertices.\n";
+              return false;
+          }
+          octave_idx_type row = sources[s].offset[k] + global
+                                - sections[source_sections[s]].offset[k];
+          for (int c = 0; c < element_columns[k]; c++)
+          {
+              dst[r + c * rows] = src[row + c * source_total[k]];
+          }
+      }
+  }
+  return true;
+}
 
 DEFUN_DLD (readObj, args, nargout, 
           "-*- texinfo -*-\n\
@@ -68,296 +1089,319 @@ given then all elements are returned as numerical array in the following order:\
 If odd number of output arguments are provided, then the last output argument is\n\
 used for returning the .mtl filename, where material parameters are stored.\n\
 Note that @code{readObj} handles explicitly triangular mesh objects. If Obj file\n\
-does not contain a proper triangular mesh, then an error message is returned.\n\
+does not contain a proper triangular mesh, then an error message is returned,\n\
+unless its polygons are triangulated with the @code{\"triangulate\"} option.\n\
+\n\
+If eight output arguments are given, then the eighth output argument returns\n\
+the source polygon of each face as an Nx1 matrix with integer values, i.e. its\n\
+1-based position among the face records of the Obj file.\n\
+\n\
+Optional property/value pairs may follow the filename:\n\
+\n\
+@code{\"threads\"} sets the number of worker threads used for parsing the Obj\n\
+file. The file is split into newline aligned chunks, which are parsed in parallel\n\
+and merged in file order, so the result is identical to serial parsing. A value\n\
+of 0 uses all available processors. Default is 1.\n\
+\n\
+@code{\"cache\"}, when true, stores the parsed elements in a binary sidecar\n\
+file named after the Obj file with a .cache suffix appended. Subsequent calls\n\
+with caching enabled load the elements from the sidecar file instead of parsing\n\
+the Obj file, provided that the size, modification time and content hash of the\n\
+Obj file match those stored in the sidecar. Otherwise, the sidecar is rebuilt.\n\
+Default is false.\n\
+\n\
+@code{\"triangulate\"}, when true, splits each polygon with n vertices into\n\
+n - 2 triangles while parsing. Convex polygons are split into a fan from their\n\
+first vertex, whereas non-convex polygons are split by ear clipping in the\n\
+plane of the polygon. The winding of the polygon is preserved and its texture\n\
+and normal indices follow its vertices. Default is false.\n\
+\n\
+@code{\"groups\"} loads only the faces of the named objects, groups or\n\
+materials, given as a string or a cell array of strings, which are matched\n\
+against the names of the o, g and usemtl statements of the Obj file. Only the\n\
+vertices, texture coordinates and normals referenced by these faces are\n\
+returned, in their order in the Obj file, and the face indices are remapped to\n\
+this compact range. The eighth output argument then returns the position of\n\
+each face in the whole Obj file. Groups cannot be combined with triangulation\n\
+and are never loaded from the sidecar cache.\n\
+\n\
+@code{\"index\"}, when true, stores the byte and element ranges between the\n\
+o, g and usemtl statements of the Obj file in a sidecar file named after the\n\
+Obj file with a .index suffix appended. When groups are loaded and the index\n\
+matches the size and modification time of the Obj file, only the parts of the\n\
+Obj file holding the requested faces and their vertices are read. Otherwise,\n\
+the whole Obj file is scanned and the index is rebuilt. Compressed Obj files\n\
+are always decompressed as a whole, so no index is written for them. Default\n\
+is false.\n\
+\n\
+@code{\"indexclass\"} sets the class of the face matrices to \"double\",\n\
+\"int32\", \"uint32\" or \"int64\". Integer face matrices are stored directly\n\
+while parsing and need half the memory in the case of 32-bit classes. They are\n\
+accepted by @code{writeObj} and @code{meshBarycenter} without conversion.\n\
+Default is \"double\".\n\
+\n\
+Obj files compressed with gzip or zstd (e.g. 3DMesh.obj.gz) are detected from\n\
+their contents and decompressed on a separate thread while they are being\n\
+parsed, provided that @code{readObj} was compiled with the corresponding\n\
+library, i.e. @code{mkoctfile -DHAVE_ZLIB -DHAVE_ZSTD readObj.cc -lz -lzstd}.\n\
+\n\
+Example: [@var{v}, @var{f}] = readObj(\"3DMesh.obj\", \"threads\", 8)\n\
+\n\
+Example: [@var{v}, @var{f}] = readObj(\"3DMesh.obj\", \"cache\", true)\n\
+\n\
+Example: [@var{v}, @var{f}, @var{vt}, @var{ft}, @var{vn}, @var{fn}, @var{mtl}, @var{polygon}] = ...\n\
+         readObj(\"3DMesh.obj\", \"triangulate\", true)\n\
+\n\
+Example: [@var{v}, @var{f}] = readObj(\"skeleton.obj\", \"groups\", @{\"femur\", \"tibia\"@}, \"index\", true)\n\
 @end deftypefn")
 {
 
   // Check if there is a valid number of output arguments
-  if (nargout < 2 || nargout > 7)
+  if (nargout < 2 || nargout > 8)
   {
       std::cout << "Invalid number of output arguments.\n";
       return octave_value_list();
   }
   
+  // Check for a filename followed by optional property/value pairs
+  if (args.length() < 1 || args.length() % 2 == 0 || ! args(0).is_string())
+  {
+      std::cout << "Invalid number of input arguments.\n";
+      return octave_value_list();
+  }
+  // number of worker threads used for parsing
+  int num_threads = 1;
+  // use a binary sidecar cache of the parsed elements
+  bool use_cache = false;
+  // split polygons into triangles
+  bool triangulate = false;
+  // objects, groups or materials to load instead of the whole mesh
+  std::vector<std::string> groups;
+  // keep an index of the objects, groups and materials next to the obj file
+  bool use_index = false;
+  // class of the face index arrays
+  int index_class = INDEX_DOUBLE;
+  for (int i = 1; i < args.length(); i += 2)
+  {
+      std::string property = args(i).is_string() ? args(i).string_value() : "";
+      if (property == "threads" && args(i+1).is_real_scalar())
+      {
+          num_threads = args(i+1).int_value();
+          if (num_threads < 1)
+          {
+              num_threads = std::thread::hardware_concurrency();
+          }
+          if (num_threads < 1)
+          {
+              num_threads = 1;
+          }
+      }
+      else if (property == "cache" && args(i+1).is_real_scalar())
+      {
+          use_cache = args(i+1).bool_value();
+      }
+      else if (property == "triangulate" && args(i+1).is_real_scalar())
+      {
+          triangulate = args(i+1).bool_value();
+      }
+      else if (property == "groups" && args(i+1).is_string())
+      {
+          groups.push_back (args(i+1).string_value());
+      }
+      else if (property == "groups" && args(i+1).iscellstr())
+      {
+          Cell names = args(i+1).cell_value();
+          for (octave_idx_type n = 0; n < names.numel(); n++)
+          {
+              groups.push_back (names(n).string_value());
+          }
+      }
+      else if (property == "index" && args(i+1).is_real_scalar())
+      {
+          use_index = args(i+1).bool_value();
+      }
+      else if (property == "indexclass" && args(i+1).is_string()
+               && index_class_value (args(i+1).string_value()) >= 0)
+      {
+          index_class = index_class_value (args(i+1).string_value());
+      }
+      else
+      {
+          std::cout << "Invalid property or value in input arguments.\n";
+          return octave_value_list();
+      }
+  }
+  if (triangulate && ! groups.empty())
+  {
+      std::cout << "Polygons cannot be triangulated when loading groups.\n";
+      return octave_value_list();
+  }
+  
   // store filename string of obj file
   std::string file = args(0).string_value();
   // define string variable for storing material library file if referenced in obj
   std::string mtl_filename;
-  // open file
-  std::ifstream inputFile(file.c_str());
-  // define matrices for storing vertices and faces retrieved from obj
-  std::vector<Coord> vertex;
-  std::vector<Faces> face;
-  // define matrices for storing normals and texture coordinates from obj
-  std::vector<Coord> normals;
-  std::vector<TCoord> texture;
-  // define matrices for storing face normals and face texture
-  std::vector<Faces> face_normals;
-  std::vector<Faces> face_texture;
-  
   
-  // initiate counters for vertices, normals, texture and faces
-  octave_idx_type vertex_counter = 0;
-  octave_idx_type normals_counter = 0;
-  octave_idx_type texture_counter = 0;
-  octave_idx_type face_counter = 0;
-  octave_idx_type faceT_counter = 0;
-  octave_idx_type faceN_counter = 0;
-  
-  // check that file exists
-  if(inputFile)
-  {
-    // define string for reading obj file per line
-    std::string line;
-    while (std::getline(inputFile, line))
-    {
-        if(line[0] == 'm' && line[1] == 't' && line[2] == 'l')
-        {
-            int str_start = line.rfind(" ") + 1;
-            if(line.find("./") != -1) {str_start = line.find("./") + 2;}
-            int str_end = line.length();
-            int str_len = str_end - str_start;
-            mtl_filename = line.substr(str_start, str_len);
-        }
-        if(line[0] == 'v' && line[1] == ' ')
-        {
-            float tmpx, tmpy, tmpz;
-          
-            sscanf(line.c_str(), "v %f %f %f" ,&tmpx,&tmpy,&tmpz);
-        
-            Coord temp3D = {tmpx, tmpy, tmpz};
-          
-            vertex.push_back(temp3D);
-          
-            vertex_counter++;
-        }
-        if(line[0] == 'v' && line[1] == 'n' && line[2] == ' ')
-        {
-            float tmpx, tmpy, tmpz;
-          
-            sscanf(line.c_str(), "vn %f %f %f" ,&tmpx,&tmpy,&tmpz);
-        
-            Coord temp3D = {tmpx, tmpy, tmpz};
-          
-            normals.push_back(temp3D);
-          
-            normals_counter++;
-        }
-        if(line[0] == 'v' && line[1] == 't' && line[2] == ' ')
-        {
-            float tmpu, tmpv;
-          
-            sscanf(line.c_str(), "vt %f %f" ,&tmpu,&tmpv);
-        
-            TCoord tempTexture = {tmpu, tmpv};
-          
-            texture.push_back(tempTexture);
-          
-            texture_counter++;  
-        }  
-        if(line[0] == 'f' && line[1] == ' ')
-        {
-            // check for non triangular mesh
-            int v1=0, v2=0, v3=0, v4=0, vt1=0, vt2=0;
-            int vt3=0, vt4=0, vn1=0, vn2=0, vn3=0, vn4=0;
-            sscanf(line.c_str(), "f %d %d %d %d" ,&v1,&v2,&v3,&v4);
-            if (v1 > 0 && v2 > 0 && v3 > 0 && v4 > 0)
-            {    
-                std::cout << "Mesh is not triangular.\n";
-                return octave_value_list();
-            }
-            sscanf(line.c_str(), "f %d/%d %d/%d %d/%d %d/%d", 
-                    &v1,&vt1,&v2,&vt2,&v3,&vt3,&v4,&vt4);
-            if (v1 > 0 && v2 > 0 && v3 > 0 && v4 > 0 
-                && vt1 > 0 && vt2 > 0 && vt3 > 0 && vt4 > 0)
-            {    
-                std::cout << "Mesh is not triangular.\n";
-                return octave_value_list();
-            }
-            sscanf(line.c_str(), "f %d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%d", 
-                    &v1,&vt1,&vn1,&v2,&vt2,&vn2,&v3,&vt3,&vn3,&v4,&vt4,&vn4);
-            if (v1 > 0 && v2 > 0 && v3 > 0 && v4 > 0 && vt1 > 0 && vt2 > 0 
-                && vt3 > 0 && vt4 > 0 && vn1 > 0 && vn2 > 0 && vn3 > 0 && vn4 > 0)
-            {    
-                std::cout << "Mesh is not triangular.\n";
-                return octave_value_list();
-            }
-            sscanf(line.c_str(), "f %d//%d %d//%d %d//%d %d//%d",
-                    &v1,&vn1,&v2,&vn2,&v3,&vn3,&v4,&vn4);
-            if (v1 > 0 && v2 > 0 && v3 > 0 && v4 > 0 && vn1 > 0 
-                && vn2 > 0 && vn3 > 0 && vn4 > 0)
-            {    
-                std::cout << "Mesh is not triangular.\n";
-                return octave_value_list();
-            }
-            
-            
-            face_counter++;
-            // Reset temp face variables
-            v1=0;v2=0;v3=0,vt1=0,vt2=0,vt3=0,vn1=0,vn2=0,vn3=0;
-
-            // scan for faces only
-            sscanf(line.c_str(), "f %d %d %d" ,&v1,&v2,&v3);
-            if (v1 > 0 && v2 > 0 && v3 > 0)
-            {    
-                Faces temp_face_v = {v1, v2, v3};
-                face.push_back(temp_face_v);
-            }
-            else
-            {
-              // scan for faces with texture
-              sscanf(line.c_str(), "f %d/%d %d/%d %d/%d",
-                      &v1,&vt1,&v2,&vt2,&v3,&vt3);
-              if (v1 > 0 && v2 > 0 && v3 > 0 && vt1 > 0 && vt2 > 0 && vt3 > 0)
-              {    
-                  Faces temp_face_v = {v1, v2, v3};
-                  Faces temp_face_vt = {vt1, vt2, vt3};
-                  face.push_back(temp_face_v);
-                  face_texture.push_back(temp_face_vt);
-                  faceT_counter++;
-              }
-              else
-              {
-                // scan for faces with texture and normals
-                sscanf(line.c_str(), "f %d/%d/%d %d/%d/%d %d/%d/%d" 
-                      ,&v1,&vt1,&vn1,&v2,&vt2,&vn2,&v3,&vt3,&vn3);
-                if (v1 > 0 && v2 > 0 && v3 > 0 && vt1 > 0 && vt2 > 0 
-                    && vt3 > 0 && vn1 > 0 && vn2 > 0 && vn3 > 0)
-                {    
-                    Faces temp_face_v = {v1, v2, v3};
-                    Faces temp_face_vt = {vt1, vt2, vt3};
-                    Faces temp_face_vn = {vn1, vn2, vn3};
-                    face.push_back(temp_face_v);
-                    face_texture.push_back(temp_face_vt);
-                    face_normals.push_back(temp_face_vn);
-                    faceT_counter++;
-                    faceN_counter++;
-                }
-                else
-                {
-                  // scan for faces with normals
-                  sscanf(line.c_str(), "f %d//%d %d//%d %d//%d" 
-                        ,&v1,&vn1,&v2,&vn2,&v3,&vn3);
-                  if (v1 > 0 && v2 > 0 && v3 > 0 && vn1 > 0 && vn2 > 0 && vn3 > 0)
-                  {    
-                      Faces temp_face_v = {v1, v2, v3};
-                      Faces temp_face_vn = {vn1, vn2, vn3};
-                      face.push_back(temp_face_v);
-                      face_normals.push_back(temp_face_vn);
-                      faceN_counter++;
-                  }
-                  else
-                  {
-                      std::cout << "Mesh is not triangular.\n";
-                      return octave_value_list();
-                  }
-                }
-              }
-            }
-        }  
-    }
-  }
-  else
+  // map the obj file into memory and check that it exists
+  MappedFile mesh;
+  if (! mesh.open (file))
   {
       std::cout << "Failure opening file.\n";
       return octave_value_list();
   }
-  
-    
-  std::cout << "Model file contained " << vertex_counter << " vertices and "
-            << face_counter << " faces.\n";
-
-  // check if vertex coordinates exist and store them in Octave array
-  Matrix V (vertex_counter, 3);
-  if (vertex_counter > 0)
+  // load the elements from the sidecar cache file if requested and valid,
+  // otherwise parse the obj file and refresh the cache
+  MeshArray V, F, VT, FT, VN, FN;
+  MeshArray *matrices[NUM_ELEMENTS] = {&V, &F, &VT, &FT, &VN, &FN};
+  // map of each face to its source polygon, which is only built on request
+  Matrix PM;
+  Matrix *polygon_map = nargout == 8 ? &PM : 0;
+  std::string cache_file = file + ".cache";
+  uint64_t hash = 0;
+  bool cached = false;
+  if (use_cache && groups.empty())
+  {
+      hash = hash_file (mesh, num_threads);
+      cached = read_cache (cache_file, mesh, hash, triangulate, index_class,
+                           matrices, polygon_map, mtl_filename);
+  }
+  // load the named groups through the index file if it is valid, which
+  // only reads the sections of the obj file holding their elements
+  std::string index_file = file + ".index";
+  std::vector<ObjSection> sections;
+  bool indexed = false;
+  int compression = compression_format (mesh);
+  if (use_index && ! groups.empty() && compression == COMPRESSION_NONE)
   {
-      //Matrix V (vertex_counter, 3);
-      for (octave_idx_type i = 0; i < vertex_counter; i++)
+      indexed = read_index (index_file, mesh, sections, mtl_filename);
+  }
+  if (cached)
+  {
+      std::cout << "Mesh loaded from cache file " << cache_file << "\n";
+  }
+  else if (indexed)
+  {
+      if (! load_groups (mesh.data, true, sections, groups, num_threads,
+                         index_class, matrices, polygon_map))
       {
-          V(i,0) = vertex[i].x;
-          V(i,1) = vertex[i].y;
-          V(i,2) = vertex[i].z;
+          return octave_value_list();
       }
   }
   else
+  {
+      // compressed files are decompressed on a separate thread, while the
+      // first pass counts the elements of each decompressed block
+      std::string text;
+      std::vector<ObjChunk> chunks;
+      ObjChunk prototype = ObjChunk ();
+      prototype.mapped = true;
+      prototype.triangulate = triangulate;
+      // compressed files are read as a whole, so their index is never used
+      bool write_index_file = use_index && compression == COMPRESSION_NONE;
+      prototype.index = write_index_file || ! groups.empty();
+      if (compression != COMPRESSION_NONE)
+      {
+          if (! decompress_obj (mesh, compression, prototype, text, chunks))
+          {
+              return octave_value_list();
+          }
+      }
+      else
+      {
+          chunks = split_chunks (mesh.data, mesh.size, num_threads, prototype);
+          for_each_chunk (chunks, count_chunk, 0, num_threads);
+      }
+      const char *data = compression != COMPRESSION_NONE ? text.data () : mesh.data;
+      size_t size = compression != COMPRESSION_NONE ? text.size () : mesh.size;
+      if (prototype.index)
+      {
+          octave_idx_type total[NUM_ELEMENTS];
+          prefix_offsets (chunks, total, mtl_filename);
+          sections = collect_sections (chunks, data, size);
+          if (write_index_file
+              && ! write_index (index_file, mesh, sections, mtl_filename))
+          {
+              std::cout << "Failure writing index file " << index_file << "\n";
+          }
+      }
+      if (! groups.empty())
+      {
+          if (! load_groups (data, compression == COMPRESSION_NONE, sections,
+                             groups, num_threads, index_class, matrices,
+                             polygon_map))
+          {
+              return octave_value_list();
+          }
+      }
+      else if (! parse_chunks (chunks, num_threads, index_class, matrices,
+                               polygon_map, mtl_filename))
+      {
+          if (triangulate)
+          {
+              std::cout << "Mesh contains invalid faces.\n";
+          }
+          else
+          {
+              std::cout << "Mesh is not triangular.\n";
+          }
+          return octave_value_list();
+      }
+      if (use_cache && groups.empty()
+          && ! write_cache (cache_file, mesh, hash, triangulate, index_class,
+                            matrices, polygon_map, mtl_filename))
+      {
+          std::cout << "Failure writing cache file " << cache_file << "\n";
+      }
+  }
+  octave_idx_type vertex_counter = V.rows();
+  octave_idx_type normals_counter = VN.rows();
+  octave_idx_type texture_counter = VT.rows();
+  octave_idx_type face_counter = F.rows();
+  octave_idx_type faceT_counter = FT.rows();
+  octave_idx_type faceN_counter = FN.rows();
+  mesh.close ();
+  
+    
+  std::cout << "Model file contained " << vertex_counter << " vertices and "
+            << face_counter << " faces.\n";
+
+  // check if vertex coordinates exist
+  if (vertex_counter == 0)
   {
       std::cout << "Mesh does not contain any vertices.\n";
       return octave_value_list();
   }
-  // check if texture coordinates exist and store them in Octave array
-  Matrix VT (texture_counter, 2);
+  // check if texture coordinates exist
   if (texture_counter > 0)
   {
       std::cout << "Mesh contains texture.\n";
-      for (octave_idx_type i = 0; i < texture_counter; i++)
-      {
-          VT(i,0) = texture[i].u;
-          VT(i,1) = texture[i].v;
-      }
   }
   else
   {
       std::cout << "Mesh does not contain any texture.\n";
   }
-  // check if normal coordinates exist and store them in Octave array
-  Matrix VN (normals_counter, 3);
+  // check if normal coordinates exist
   if (normals_counter > 0)
   {
       std::cout << "Mesh contains normals.\n";
-      for (octave_idx_type i = 0; i < normals_counter; i++)
-      {
-          VN(i,0) = normals[i].x;
-          VN(i,1) = normals[i].y;
-          VN(i,2) = normals[i].z;
-      }
   }
   else
   {
       std::cout << "Mesh does not contain any normals.\n";
   }
-  // check if faces exist and store them in Octave array
-  Matrix F (face_counter, 3);
-  if (face_counter > 0)
-  {
-      for (octave_idx_type i = 0; i < face_counter; i++)
-      {
-          F(i,0) = face[i].a;
-          F(i,1) = face[i].b;
-          F(i,2) = face[i].c;
-      }
-  }
-  else
+  // check if faces exist
+  if (face_counter == 0)
   {
       std::cout << "Mesh does not contain any faces.\n";
       return octave_value_list();
   }
-  // check if texture faces exist and store them in Octave array
-  Matrix FT (faceT_counter, 3);
-  if (faceT_counter > 0)
-  {
-      for (octave_idx_type i = 0; i < faceT_counter; i++)
-      {
-          FT(i,0) = face_texture[i].a;
-          FT(i,1) = face_texture[i].b;
-          FT(i,2) = face_texture[i].c;
-      }
-  }
-  else
+  // check if texture faces exist
+  if (faceT_counter == 0)
   {
       std::cout << "Mesh does not contain any texture faces.\n";
   }
-  // check if face normals exist and store them in Octave array
-  Matrix FN (faceN_counter, 3);
-  if (faceN_counter > 0)
-  {
-      for (octave_idx_type i = 0; i < faceN_counter; i++)
-      {
-          FN(i,0) = face_normals[i].a;
-          FN(i,1) = face_normals[i].b;
-          FN(i,2) = face_normals[i].c;
-      }
-  }
-  else
+  // check if face normals exist
+  if (faceN_counter == 0)
   {
       std::cout << "Mesh does not contain any face normals.\n";
   }
@@ -374,6 +1418,9 @@ does not contain a proper triangular mesh, then an error message is returned.\n\
   //
   // If odd number of output arguments is present, then the last output
   // argument is used for storing the filename with the material parameters.
+  //
+  // If eight output arguments are given, then the last one returns the
+  // source polygon of each face.
   
   
   // define return value list
@@ -381,68 +1428,80 @@ does not contain a proper triangular mesh, then an error message is returned.\n\
   
   if (nargout == 2)
   {
-      retval(0) = V;
-      retval(1) = F;
+      retval(0) = V.value();
+      retval(1) = F.value();
   }
   if (nargout == 3)
   {
-      retval(0) = V;
-      retval(1) = F;
+      retval(0) = V.value();
+      retval(1) = F.value();
       retval(2) = mtl_filename.c_str();
       std::cout << "Material library file is present\n";
   }
   if (nargout == 4 && faceT_counter > 0 && texture_counter > 0)
   {
-      retval(0) = V;
-      retval(1) = F;
-      retval(2) = VT;
-      retval(3) = FT;
+      retval(0) = V.value();
+      retval(1) = F.value();
+      retval(2) = VT.value();
+      retval(3) = FT.value();
   }
   if (nargout == 4 && faceT_counter == 0 && texture_counter == 0 
           && faceN_counter > 0 && normals_counter > 0)
   {
-      retval(0) = V;
-      retval(1) = F;
-      retval(2) = VN;
-      retval(3) = FN;
+      retval(0) = V.value();
+      retval(1) = F.value();
+      retval(2) = VN.value();
+      retval(3) = FN.value();
   }
   if (nargout == 5 && faceT_counter > 0 && texture_counter > 0)
   {
-      retval(0) = V;
-      retval(1) = F;
-      retval(2) = VT;
-      retval(3) = FT;
+      retval(0) = V.value();
+      retval(1) = F.value();
+      retval(2) = VT.value();
+      retval(3) = FT.value();
       retval(4) = mtl_filename.c_str();
       std::cout << "Material library file is present\n";
   }
   if (nargout == 5 && faceT_counter == 0 && texture_counter == 0 
         && faceN_counter > 0 && normals_counter > 0)
   {
-      retval(0) = V;
-      retval(1) = F;
-      retval(2) = VN;
-      retval(3) = FN;
+      retval(0) = V.value();
+      retval(1) = F.value();
+      retval(2) = VN.value();
+      retval(3) = FN.value();
       retval(4) = mtl_filename.c_str();
       std::cout << "Material library file is present\n";
   }
   if (nargout == 6)
   {
-      retval(0) = V;
-      retval(1) = F;
-      retval(2) = VT;
-      retval(3) = FT;
-      retval(4) = VN;
-      retval(5) = FN;
+      retval(0) = V.value();
+      retval(1) = F.value();
+      retval(2) = VT.value();
+      retval(3) = FT.value();
+      retval(4) = VN.value();
+      retval(5) = FN.value();
   }
   if (nargout == 7)
   {
-      retval(0) = V;
-      retval(1) = F;
-      retval(2) = VT;
-      retval(3) = FT;
-      retval(4) = VN;
-      retval(5) = FN;
+      retval(0) = V.value();
+      retval(1) = F.value();
+      retval(2) = VT.value();
+      retval(3) = FT.value();
+      retval(4) = VN.value();
+      retval(5) = FN.value();
+      retval(6) = mtl_filename.c_str();
+      std::cout << "Material library file is present\n";
+  }
+  if (nargout == 8)
+  {
+      retval(0) = V.value();
+      retval(1) = F.value();
+      retval(2) = VT.value();
+      retval(3) = FT.value();
+      retval(4) = VN.value();
+      retval(5) = FN.value();
       retval(6) = mtl_filename.c_str();
+      retval(7) = PM;
       std::cout << "Material library file is present\n";
   }
   
@@ -0,0 +1,180 @@
+/*
+Copyright (C) 2018-2020 Andreas Bertsatos <abertsatos@biol.uoa.gr>
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free Software
+Foundation; either version 3 of the License, or (at your option) any later
+version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+details.
+
+You should have received a copy of the GNU General Public License along with
+this program; if not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <iostream>
+#include <string>
+#include <octave/oct.h>
+#include "objParser.h"
+
+// find the end of the block starting at p, which contains at most
+// max_records vertex, texture, normal and face records
+static const char *find_block_end (const char *p, const char *file_end,
+                                   octave_idx_type max_records)
+{
+  octave_idx_type records = 0;
+  while (p < file_end && records < max_records)
+  {
+      const char *line_end = find_line_end (p, file_end);
+      if ((line_end - p > 1 && (p[0] == 'v' || p[0] == 'f') && is_blank (p[1]))
+          || (line_end - p > 2 && p[0] == 'v' && (p[1] == 't' || p[1] == 'n')
+              && is_blank (p[2])))
+      {
+          records++;
+      }
+      p = std::min (line_end + 1, file_end);
+  }
+  return p;
+}
+
+
+DEFUN_DLD (readObjNext, args, nargout, 
+          "-*- texinfo -*-\n\
+@deftypefn{Loadable function} [@var{block}, @var{objReader}] = readObjNext(@var{objReader}, @var{N})\n\
+\n\
+\n\
+Example: [block, objReader] = readObjNext(objReader, 1e6)\n\
+\n\
+\n\
+This function reads the next block of at most @var{N} vertex, texture\n\
+coordinate, vertex normal and face records from a Wavefront Obj file opened\n\
+with @code{readObjOpen}. Only the lines of the current block are scanned and\n\
+memory usage is bounded by the block size, regardless of the size of the\n\
+file.\n\
+\n\
+The @var{block} structure contains the fields @var{v}, @var{f}, @var{vt},\n\
+@var{ft}, @var{vn} and @var{fn} with the elements found in the block, in the\n\
+same format as returned by @code{readObj}. Face indices refer to the whole\n\
+file, i.e. they are not relative to the block. The fields\n\
+@var{vertex_offset}, @var{texture_offset}, @var{normals_offset} and\n\
+@var{face_offset} hold the number of each element preceding the block, so\n\
+that row i of @var{block.v} is vertex @var{block.vertex_offset} + i of the\n\
+mesh.\n\
+\n\
+The updated @var{objReader} must be passed to the next call. Its @var{done}\n\
+field becomes true once the end of the file has been reached.\n\
+@end deftypefn")
+{
+
+  // Check for a valid number of input and output arguments
+  if (args.length() != 2 || ! args(0).isstruct() || ! args(1).is_real_scalar())
+  {
+      std::cout << "Invalid number of input arguments.\n";
+      return octave_value_list();
+  }
+  if (nargout != 2)
+  {
+      std::cout << "Invalid number of output arguments.\n";
+      return octave_value_list();
+  }
+  octave_scalar_map reader = args(0).scalar_map_value();
+  octave_idx_type max_records = args(1).idx_type_value();
+  if (max_records < 1)
+  {
+      std::cout << "Block size should be a positive integer.\n";
+      return octave_value_list();
+  }
+  if (! reader.isfield ("filename") || ! reader.isfield ("offset"))
+  {
+      std::cout << "First input argument should be an objReader structure.\n";
+      return octave_value_list();
+  }
+  // map the obj file into memory and check that it has not been modified
+  // since it was opened
+  std::string file = reader.getfield ("filename").string_value();
+  MappedFile mesh;
+  if (! mesh.open (file))
+  {
+      std::cout << "Failure opening file.\n";
+      return octave_value_list();
+  }
+  if (double (mesh.size) != reader.getfield ("size").double_value()
+      || mesh.mtime != reader.getfield ("mtime").double_value())
+  {
+      std::cout << "Obj file has been modified since it was opened.\n";
+      return octave_value_list();
+  }
+  // find the lines of the current block
+  size_t offset = reader.getfield ("offset").double_value();
+  const char *file_end = mesh.data + mesh.size;
+  ObjChunk block = ObjChunk ();
+  block.begin = mesh.data + std::min (offset, mesh.size);
+  block.end = find_block_end (block.begin, file_end, max_records);
+  block.mapped = true;
+  // count the elements of the block, allocate its arrays and parse the
+  // block straight into them
+  count_chunk (&block, 0);
+  octave_idx_type offsets[NUM_ELEMENTS];
+  offsets[VERTEX] = reader.getfield ("vertex_offset").idx_type_value();
+  offsets[TEXTURE] = reader.getfield ("texture_offset").idx_type_value();
+  offsets[NORMALS] = reader.getfield ("normals_offset").idx_type_value();
+  offsets[FACE] = reader.getfield ("face_offset").idx_type_value();
+  Matrix V (block.count[VERTEX], 3);
+  Matrix F (block.count[FACE], 3);
+  Matrix VT (block.count[TEXTURE], 2);
+  Matrix FT (block.count[FACE_TEXTURE], 3);
+  Matrix VN (block.count[NORMALS], 3);
+  Matrix FN (block.count[FACE_NORMALS], 3);
+  ObjArrays arrays;
+  Matrix *matrices[NUM_ELEMENTS] = {&V, &F, &VT, &FT, &VN, &FN};
+  for (int k = 0; k < NUM_ELEMENTS; k++)
+  {
+      block.offset[k] = 0;
+      arrays.data[k] = matrices[k]->fortran_vec ();
+      arrays.rows[k] = block.count[k];
+  }
+  // faces of a block may refer to vertices of earlier blocks, so polygons
+  // are not triangulated while streaming
+  arrays.index_class = INDEX_DOUBLE;
+  arrays.polygon_map = 0;
+  arrays.fill_vertices = true;
+  arrays.fill_faces = true;
+  fill_chunk (&block, &arrays);
+  if (! block.triangular)
+  {
+      std::cout << "Mesh is not triangular.\n";
+      return octave_value_list();
+  }
+  
+  // store the elements of the block
+  octave_scalar_map elements;
+  elements.assign ("v", V);
+  elements.assign ("f", F);
+  elements.assign ("vt", VT);
+  elements.assign ("ft", FT);
+  elements.assign ("vn", VN);
+  elements.assign ("fn", FN);
+  elements.assign ("vertex_offset", double (offsets[VERTEX]));
+  elements.assign ("texture_offset", double (offsets[TEXTURE]));
+  elements.assign ("normals_offset", double (offsets[NORMALS]));
+  elements.assign ("face_offset", double (offsets[FACE]));
+  // advance the reader state past the block
+  reader.assign ("offset", double (block.end - mesh.data));
+  reader.assign ("vertex_offset", double (offsets[VERTEX] + block.count[VERTEX]));
+  reader.assign ("texture_offset", double (offsets[TEXTURE] + block.count[TEXTURE]));
+  reader.assign ("normals_offset", double (offsets[NORMALS] + block.count[NORMALS]));
+  reader.assign ("face_offset", double (offsets[FACE] + block.count[FACE]));
+  if (! block.mtl_filename.empty ())
+  {
+      reader.assign ("mtl", block.mtl_filename);
+  }
+  reader.assign ("done", block.end >= file_end);
+  
+  octave_value_list retval;
+  retval(0) = elements;
+  retval(1) = reader;
+  return retval;
+}
@@ -0,0 +1,109 @@
+/*
+Copyright (C) 2018-2020 Andreas Bertsatos <abertsatos@biol.uoa.gr>
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free Software
+Foundation; either version 3 of the License, or (at your option) any later
+version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+details.
+
+You should have received a copy of the GNU General Public License along with
+this program; if not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <iostream>
+#include <string>
+#include <octave/oct.h>
+#include "objParser.h"
+
+
+DEFUN_DLD (readObjOpen, args, nargout, 
+          "-*- texinfo -*-\n\
+@deftypefn{Loadable function} @var{objReader} = readObjOpen(@var{filename})\n\
+\n\
+\n\
+Example: objReader = readObjOpen(\"3DMesh.obj\")\n\
+\n\
+\n\
+This function opens a Wavefront Obj file for reading its elements in fixed\n\
+size blocks with @code{readObjNext}, so that meshes which do not fit in memory\n\
+can be processed with constant memory usage.\n\
+\n\
+The returned @var{objReader} is a structure holding the filename, its size and\n\
+modification time, the byte offset of the next block and the number of\n\
+vertices, texture coordinates, vertex normals and faces read so far. Its\n\
+@var{mtl} field holds the .mtl filename, if referenced in the Obj file, and\n\
+its @var{done} field becomes true once the whole file has been read.\n\
+\n\
+Since @var{objReader} is an ordinary structure, it must be updated with the\n\
+second output argument of each @code{readObjNext} call. For example, the\n\
+bounding box of an arbitrarily large mesh may be computed as:\n\
+\n\
+@example\n\
+r = readObjOpen (\"3DMesh.obj\");\n\
+bbox = [Inf(1,3); -Inf(1,3)];\n\
+while (! r.done)\n\
+  [block, r] = readObjNext (r, 1e6);\n\
+  if (! isempty (block.v))\n\
+    bbox = [min(bbox(1,:), min(block.v, [], 1)); ...\n\
+            max(bbox(2,:), max(block.v, [], 1))];\n\
+  endif\n\
+endwhile\n\
+@end example\n\
+@end deftypefn")
+{
+
+  // Check for a valid number of input and output arguments
+  if (args.length() != 1 || ! args(0).is_string())
+  {
+      std::cout << "Invalid number of input arguments.\n";
+      return octave_value_list();
+  }
+  if (nargout != 1)
+  {
+      std::cout << "Invalid number of output arguments.\n";
+      return octave_value_list();
+  }
+  // store filename string of obj file and map it into memory
+  std::string file = args(0).string_value();
+  MappedFile mesh;
+  if (! mesh.open (file))
+  {
+      std::cout << "Failure opening file.\n";
+      return octave_value_list();
+  }
+  // scan the header lines preceding the first element for the material
+  // library filename
+  std::string mtl_filename;
+  const char *p = mesh.data;
+  const char *file_end = mesh.data + mesh.size;
+  while (p < file_end && *p != 'v' && *p != 'f')
+  {
+      const char *line_end = find_line_end (p, file_end);
+      if (line_end - p > 2 && p[0] == 'm' && p[1] == 't' && p[2] == 'l')
+      {
+          parse_mtllib (p, line_end, mtl_filename);
+      }
+      p = line_end + 1;
+  }
+  // define the reader state
+  octave_scalar_map reader;
+  reader.assign ("filename", file);
+  reader.assign ("size", double (mesh.size));
+  reader.assign ("mtime", mesh.mtime);
+  reader.assign ("offset", 0.0);
+  reader.assign ("vertex_offset", 0.0);
+  reader.assign ("texture_offset", 0.0);
+  reader.assign ("normals_offset", 0.0);
+  reader.assign ("face_offset", 0.0);
+  reader.assign ("mtl", mtl_filename);
+  reader.assign ("done", mesh.size == 0);
+  
+  octave_value_list retval;
+  retval(0) = reader;
+  return retval;
+}
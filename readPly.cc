@@ -0,0 +1,407 @@
+/*
+Copyright (C) 2018-2020 Andreas Bertsatos <abertsatos@biol.uoa.gr>
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free Software
+Foundation; either version 3 of the License, or (at your option) any later
+version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+details.
+
+You should have received a copy of the GNU General Public License along with
+this program; if not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <octave/oct.h>
+#include "mappedFile.h"
+#include "meshIndex.h"
+#include "meshBinary.h"
+
+// copy a property of every fixed size record into a column of doubles
+template <typename T>
+static void copy_column (const char *p, int stride, octave_idx_type rows,
+                         double *column)
+{
+  for (octave_idx_type i = 0; i < rows; i++)
+  {
+      column[i] = load_ply<T> (p + i * stride);
+  }
+}
+
+static void read_column (const char *p, int stride, int type,
+                         octave_idx_type rows, double *column)
+{
+  switch (type)
+  {
+    case PLY_INT8:
+      copy_column<int8_t> (p, stride, rows, column);
+      break;
+    case PLY_UINT8:
+      copy_column<uint8_t> (p, stride, rows, column);
+      break;
+    case PLY_INT16:
+      copy_column<int16_t> (p, stride, rows, column);
+      break;
+    case PLY_UINT16:
+      copy_column<uint16_t> (p, stride, rows, column);
+      break;
+    case PLY_INT32:
+      copy_column<int32_t> (p, stride, rows, column);
+      break;
+    case PLY_UINT32:
+      copy_column<uint32_t> (p, stride, rows, column);
+      break;
+    case PLY_FLOAT32:
+      copy_column<float> (p, stride, rows, column);
+      break;
+    default:
+      copy_column<double> (p, stride, rows, column);
+  }
+}
+
+// position of the first of the named properties present in the element
+static int find_property (const PlyElement& element, const char *const *names,
+                          int n)
+{
+  for (int i = 0; i < n; i++)
+  {
+      int property = element.find (names[i]);
+      if (property >= 0)
+      {
+          return property;
+      }
+  }
+  return -1;
+}
+
+// read the vertex indices of the triangular faces starting at p into the
+// column-major face array F as 1-based indices.  Records made of a single
+// index list are read with a fixed stride, all others are walked property
+// by property.  Returns an error message, which is empty on success
+template <typename T>
+static std::string read_faces (const char *p, const char *end,
+                               const PlyElement& face, int indices,
+                               octave_idx_type V_rows, T *F,
+                               const char *&records_end)
+{
+  const PlyProperty& list = face.properties[indices];
+  int count_size = ply_type_size (list.count_type);
+  int index_size = ply_type_size (list.type);
+  octave_idx_type F_rows = face.count;
+  if (face.properties.size () == 1)
+  {
+      size_t stride = count_size + 3 * index_size;
+      if (size_t (end - p) < F_rows * stride)
+      {
+          return "PLY file is truncated.";
+      }
+      for (octave_idx_type i = 0; i < F_rows; i++, p += stride)
+      {
+          if (load_ply_index (p, list.count_type) != 3)
+          {
+              return "Mesh is not triangular.";
+          }
+          for (int j = 0; j < 3; j++)
+          {
+              int64_t v = load_ply_index (p + count_size + j * index_size,
+                                          list.type);
+              if (v < 0 || v >= V_rows)
+              {
+                  return "Faces refer to missing vertices.";
+              }
+              F[i + j * F_rows] = v + 1;
+          }
+      }
+      records_end = p;
+      return "";
+  }
+  for (octave_idx_type i = 0; i < F_rows; i++)
+  {
+      size_t size = face.record_size (p, end);
+      if (size == 0)
+      {
+          return "PLY file is truncated.";
+      }
+      const char *q = p;
+      for (int k = 0; k < int (face.properties.size ()); k++)
+      {
+          const PlyProperty& property = face.properties[k];
+          if (property.count_type == PLY_INVALID)
+          {
+              q += ply_type_size (property.type);
+              continue;
+          }
+          int64_t n = load_ply_index (q, property.count_type);
+          q += ply_type_size (property.count_type);
+          if (k == indices)
+          {
+              if (n != 3)
+              {
+                  return "Mesh is not triangular.";
+              }
+              for (int j = 0; j < 3; j++)
+              {
+                  int64_t v = load_ply_index (q + j * index_size, list.type);
+                  if (v < 0 || v >= V_rows)
+                  {
+                      return "Faces refer to missing vertices.";
+                  }
+                  F[i + j * F_rows] = v + 1;
+              }
+          }
+          q += n * ply_type_size (property.type);
+      }
+      p += size;
+  }
+  records_end = p;
+  return "";
+}
+
+
+DEFUN_DLD (readPly, args, nargout,
+          "-*- texinfo -*-\n\
+@deftypefn{Loadable function} [@var{v}, @var{f}, @var{vt}, @var{ft}, @var{vn}, @var{fn}] = readPly(@var{filename})\n\
+\n\
+\n\
+Example: [v, f, vt, ft, vn, fn] = readPly(\"3DMesh.ply\")\n\
+\n\
+\n\
+This function loads a triangular 3D Mesh from a binary little endian PLY file\n\
+and returns its elements in the same matrices as @code{readObj}, so that it can\n\
+replace @code{readObj} wherever a binary format is preferred.\n\
+\n\
+The x, y and z properties of the vertex element are returned in @var{v} and\n\
+the vertex_indices list of the face element in @var{f}, as 1-based indices.\n\
+Vertex normals (nx, ny, nz) and texture coordinates (u, v or s, t) are stored\n\
+per vertex in PLY files, so if present they are returned in @var{vn} and\n\
+@var{vt}, with @var{fn} and @var{ft} equal to @var{f}. Otherwise these outputs\n\
+are empty. Other properties and elements are skipped.\n\
+\n\
+The output arguments follow @code{readObj}. Two output arguments return the\n\
+vertices and the faces. Four return them followed by the texture coordinates\n\
+and their faces if the mesh has texture coordinates, or else by the vertex\n\
+normals and their faces. Six return all of @var{v}, @var{f}, @var{vt},\n\
+@var{ft}, @var{vn} and @var{fn}. An odd number of output arguments adds the\n\
+material library filename as the last one, which is empty since binary files\n\
+do not refer to one, so that\n\
+[v, f, vt, ft, vn, fn, mtl] = readPly(filename) may replace the same call to\n\
+@code{readObj}. Optional property/value pairs may follow the filename:\n\
+\n\
+@code{\"indexclass\"} sets the class of the face matrices to \"double\",\n\
+\"int32\", \"uint32\" or \"int64\". Default is \"double\".\n\
+\n\
+Example: [v, f] = readPly(\"3DMesh.ply\", \"indexclass\", \"int32\")\n\
+@end deftypefn")
+{
+
+  // Check if there is a valid number of output arguments
+  if (nargout < 2 || nargout > 7)
+  {
+      std::cout << "Invalid number of output arguments.\n";
+      return octave_value_list();
+  }
+  // Check for a filename followed by optional property/value pairs
+  if (args.length() < 1 || args.length() % 2 == 0 || ! args(0).is_string())
+  {
+      std::cout << "Invalid number of input arguments.\n";
+      return octave_value_list();
+  }
+  // class of the face index arrays
+  int index_class = INDEX_DOUBLE;
+  for (int i = 1; i < args.length(); i += 2)
+  {
+      std::string property = args(i).is_string() ? args(i).string_value() : "";
+      if (property == "indexclass" && args(i+1).is_string()
+          && index_class_value (args(i+1).string_value()) >= 0)
+      {
+          index_class = index_class_value (args(i+1).string_value());
+      }
+      else
+      {
+          std::cout << "Invalid property or value in input arguments.\n";
+          return octave_value_list();
+      }
+  }
+  if (! little_endian_host ())
+  {
+      std::cout << "Binary PLY files are only supported on little endian machines.\n";
+      return octave_value_list();
+  }
+
+  // map the ply file into memory and parse its header
+  std::string file = args(0).string_value();
+  MappedFile mesh;
+  if (! mesh.open (file))
+  {
+      std::cout << "Failure opening file.\n";
+      return octave_value_list();
+  }
+  std::vector<PlyElement> elements;
+  size_t header_size = 0;
+  std::string error = parse_ply_header (mesh.data, mesh.size, elements,
+                                        header_size);
+  if (! error.empty ())
+  {
+      std::cout << error << "\n";
+      return octave_value_list();
+  }
+
+  // read the vertex and face elements in the order they appear in the file
+  // and skip all others
+  static const char *const normal_names[] = {"nx", "ny", "nz"};
+  static const char *const u_names[] = {"u", "s", "texture_u"};
+  static const char *const v_names[] = {"v", "t", "texture_v"};
+  static const char *const index_names[] = {"vertex_indices", "vertex_index"};
+  Matrix V (0, 3), VT (0, 2), VN (0, 3);
+  MeshArray F;
+  F.allocate (0, 3, index_class);
+  bool has_vertices = false, has_faces = false;
+  bool has_texture = false, has_normals = false;
+  const char *p = mesh.data + header_size;
+  const char *file_end = mesh.data + mesh.size;
+  for (size_t e = 0; e < elements.size (); e++)
+  {
+      const PlyElement& element = elements[e];
+      int stride = element.stride ();
+      if (element.name == "vertex")
+      {
+          int x = element.find ("x");
+          int y = element.find ("y");
+          int z = element.find ("z");
+          if (stride < 0 || x < 0 || y < 0 || z < 0)
+          {
+              std::cout << "Vertex element should hold x, y and z properties.\n";
+              return octave_value_list();
+          }
+          if (size_t (file_end - p) < element.count * size_t (stride))
+          {
+              std::cout << "PLY file is truncated.\n";
+              return octave_value_list();
+          }
+          V = Matrix (element.count, 3);
+          int xyz[3] = {x, y, z};
+          for (int j = 0; j < 3; j++)
+          {
+              read_column (p + element.offset (xyz[j]), stride,
+                           element.properties[xyz[j]].type, element.count,
+                           V.fortran_vec () + j * element.count);
+          }
+          int n[3];
+          for (int j = 0; j < 3; j++)
+          {
+              n[j] = element.find (normal_names[j]);
+          }
+          if (n[0] >= 0 && n[1] >= 0 && n[2] >= 0)
+          {
+              VN = Matrix (element.count, 3);
+              for (int j = 0; j < 3; j++)
+              {
+                  read_column (p + element.offset (n[j]), stride,
+                               element.properties[n[j]].type, element.count,
+                               VN.fortran_vec () + j * element.count);
+              }
+              has_normals = true;
+          }
+          int uv[2] = {find_property (element, u_names, 3),
+                       find_property (element, v_names, 3)};
+          if (uv[0] >= 0 && uv[1] >= 0)
+          {
+              VT = Matrix (element.count, 2);
+              for (int j = 0; j < 2; j++)
+              {
+                  read_column (p + element.offset (uv[j]), stride,
+                               element.properties[uv[j]].type, element.count,
+                               VT.fortran_vec () + j * element.count);
+              }
+              has_texture = true;
+          }
+          has_vertices = true;
+          p += element.count * size_t (stride);
+      }
+      else if (element.name == "face")
+      {
+          int indices = find_property (element, index_names, 2);
+          if (! has_vertices || indices < 0
+              || element.properties[indices].count_type == PLY_INVALID)
+          {
+              std::cout << "Face element should hold a vertex_indices list\n"
+                        << "and follow the vertex element.\n";
+              return octave_value_list();
+          }
+          F.allocate (element.count, 3, index_class);
+          void *data = F.data ();
+          octave_idx_type V_rows = V.rows ();
+          switch (index_class)
+          {
+            case INDEX_INT32:
+              error = read_faces (p, file_end, element, indices, V_rows,
+                                  static_cast<int32_t *> (data), p);
+              break;
+            case INDEX_UINT32:
+              error = read_faces (p, file_end, element, indices, V_rows,
+                                  static_cast<uint32_t *> (data), p);
+              break;
+            case INDEX_INT64:
+              error = read_faces (p, file_end, element, indices, V_rows,
+                                  static_cast<int64_t *> (data), p);
+              break;
+            default:
+              error = read_faces (p, file_end, element, indices, V_rows,
+                                  static_cast<double *> (data), p);
+          }
+          if (! error.empty ())
+          {
+              std::cout << error << "\n";
+              return octave_value_list();
+          }
+          has_faces = true;
+      }
+      else if (stride >= 0)
+      {
+          p += element.count * size_t (stride);
+      }
+      else
+      {
+          for (octave_idx_type i = 0; i < element.count; i++)
+          {
+              size_t size = element.record_size (p, file_end);
+              if (size == 0)
+              {
+                  std::cout << "PLY file is truncated.\n";
+                  return octave_value_list();
+              }
+              p += size;
+          }
+      }
+      if (p > file_end)
+      {
+          std::cout << "PLY file is truncated.\n";
+          return octave_value_list();
+      }
+      if (has_vertices && has_faces)
+      {
+          break;
+      }
+  }
+  if (! has_vertices)
+  {
+      std::cout << "Mesh does not contain any vertices.\n";
+      return octave_value_list();
+  }
+
+  // the per vertex texture coordinates and normals share the face indices,
+  // which are returned without copying them
+  octave_value faces = F.value ();
+  MeshArray empty;
+  empty.allocate (0, 3, index_class);
+  return mesh_outputs (nargout, V, faces, VT,
+                       has_texture ? faces : empty.value (), VN,
+                       has_normals ? faces : empty.value (), has_texture);
+}
@@ -0,0 +1,332 @@
+/*
+Copyright (C) 2018-2020 Andreas Bertsatos <abertsatos@biol.uoa.gr>
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free Software
+Foundation; either version 3 of the License, or (at your option) any later
+version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+details.
+
+You should have received a copy of the GNU General Public License along with
+this program; if not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <octave/oct.h>
+#include "mappedFile.h"
+#include "meshIndex.h"
+#include "meshBinary.h"
+
+// open addressing hash table of the distinct vertices of an STL file, keyed
+// by the bit patterns of their single precision coordinates.  The table only
+// holds indices into the vertex list, so it is much smaller and faster than
+// a node based map
+class StlVertexTable
+{
+public:
+  StlVertexTable (octave_idx_type expected)
+    : mask (1)
+  {
+    while (mask < size_t (2 * expected))
+    {
+        mask <<= 1;
+    }
+    slots.assign (mask, -1);
+    mask--;
+  }
+
+  // index of the vertex with the given coordinates, which is appended to
+  // vertices if it is new
+  octave_idx_type insert (const float *xyz, std::vector<uint32_t>& vertices)
+  {
+    uint32_t key[3];
+    memcpy (key, xyz, sizeof (key));
+    // negative zeros are merged with positive ones
+    for (int k = 0; k < 3; k++)
+    {
+        key[k] = key[k] == 0x80000000u ? 0 : key[k];
+    }
+    for (size_t slot = hash (key) & mask; ; slot = (slot + 1) & mask)
+    {
+        octave_idx_type v = slots[slot];
+        if (v < 0)
+        {
+            v = vertices.size () / 3;
+            vertices.insert (vertices.end (), key, key + 3);
+            slots[slot] = v;
+            if (size_t (v + 1) * 2 > mask)
+            {
+                grow (vertices);
+            }
+            return v;
+        }
+        if (memcmp (&vertices[3 * v], key, sizeof (key)) == 0)
+        {
+            return v;
+        }
+    }
+  }
+
+private:
+  static size_t hash (const uint32_t *key)
+  {
+    uint64_t h = (uint64_t (key[0]) << 32 | key[1]) * 0x9E3779B97F4A7C15ULL;
+    h ^= (key[2] + (h >> 31)) * 0xC2B2AE3D27D4EB4FULL;
+    return h ^ (h >> 29);
+  }
+
+  // double the table once it is half full
+  void grow (const std::vector<uint32_t>& vertices)
+  {
+    mask = 2 * mask + 1;
+    slots.assign (mask + 1, -1);
+    for (octave_idx_type v = 0; v < octave_idx_type (vertices.size () / 3); v++)
+    {
+        const uint32_t *key = &vertices[3 * v];
+        size_t slot = hash (key) & mask;
+        while (slots[slot] >= 0)
+        {
+            slot = (slot + 1) & mask;
+        }
+        slots[slot] = v;
+    }
+  }
+
+  size_t mask;
+  std::vector<octave_idx_type> slots;
+};
+
+// store the 1-based vertex indices of the triangles into the column-major
+// face array F
+template <typename T>
+static void store_faces (const std::vector<octave_idx_type>& corners,
+                         octave_idx_type F_rows, T *F)
+{
+  for (octave_idx_type i = 0; i < F_rows; i++)
+  {
+      for (int j = 0; j < 3; j++)
+      {
+          F[i + j * F_rows] = corners[3 * i + j] + 1;
+      }
+  }
+}
+
+template <typename T>
+static void store_normal_faces (octave_idx_type F_rows, T *FN)
+{
+  for (octave_idx_type i = 0; i < F_rows; i++)
+  {
+      FN[i] = FN[i + F_rows] = FN[i + 2 * F_rows] = i + 1;
+  }
+}
+
+
+DEFUN_DLD (readStl, args, nargout,
+          "-*- texinfo -*-\n\
+@deftypefn{Loadable function} [@var{v}, @var{f}, @var{vt}, @var{ft}, @var{vn}, @var{fn}] = readStl(@var{filename})\n\
+\n\
+\n\
+Example: [v, f, vt, ft, vn, fn] = readStl(\"3DMesh.stl\")\n\
+\n\
+\n\
+This function loads a triangular 3D Mesh from a binary STL file and returns\n\
+its elements in the same matrices as @code{readObj}, so that it can replace\n\
+@code{readObj} wherever a binary format is preferred.\n\
+\n\
+STL files store each triangle with its own three vertices and its facet\n\
+normal. Vertices with identical coordinates are merged, so that @var{f} refers\n\
+to the shared vertices in @var{v}. The facet normals are returned in @var{vn}\n\
+with one row per face, each face referring to its own normal in @var{fn}.\n\
+Normals stored as zero are computed from the vertices. STL files hold no\n\
+texture coordinates, so @var{vt} and @var{ft} are empty.\n\
+\n\
+The output arguments follow @code{readObj}. Two output arguments return the\n\
+vertices and the faces. Four return them followed by the texture coordinates\n\
+and their faces if the mesh has texture coordinates, or else by the vertex\n\
+normals and their faces. Six return all of @var{v}, @var{f}, @var{vt},\n\
+@var{ft}, @var{vn} and @var{fn}. An odd number of output arguments adds the\n\
+material library filename as the last one, which is empty since binary files\n\
+do not refer to one, so that\n\
+[v, f, vt, ft, vn, fn, mtl] = readStl(filename) may replace the same call to\n\
+@code{readObj}. Optional property/value pairs may follow the filename:\n\
+\n\
+@code{\"weld\"} set to false keeps the three vertices of every triangle, so\n\
+that the vertices are copied straight from the file. Default is true.\n\
+\n\
+@code{\"indexclass\"} sets the class of the face matrices to \"double\",\n\
+\"int32\", \"uint32\" or \"int64\". Default is \"double\".\n\
+\n\
+Example: [v, f] = readStl(\"3DMesh.stl\", \"indexclass\", \"int32\")\n\
+@end deftypefn")
+{
+
+  // Check if there is a valid number of output arguments
+  if (nargout < 2 || nargout > 7)
+  {
+      std::cout << "Invalid number of output arguments.\n";
+      return octave_value_list();
+  }
+  // Check for a filename followed by optional property/value pairs
+  if (args.length() < 1 || args.length() % 2 == 0 || ! args(0).is_string())
+  {
+      std::cout << "Invalid number of input arguments.\n";
+      return octave_value_list();
+  }
+  // merge vertices with identical coordinates
+  bool weld = true;
+  // class of the face index arrays
+  int index_class = INDEX_DOUBLE;
+  for (int i = 1; i < args.length(); i += 2)
+  {
+      std::string property = args(i).is_string() ? args(i).string_value() : "";
+      if (property == "weld" && (args(i+1).is_bool_scalar()
+          || args(i+1).is_real_scalar()))
+      {
+          weld = args(i+1).bool_value();
+      }
+      else if (property == "indexclass" && args(i+1).is_string()
+               && index_class_value (args(i+1).string_value()) >= 0)
+      {
+          index_class = index_class_value (args(i+1).string_value());
+      }
+      else
+      {
+          std::cout << "Invalid property or value in input arguments.\n";
+          return octave_value_list();
+      }
+  }
+  if (! little_endian_host ())
+  {
+      std::cout << "Binary STL files are only supported on little endian machines.\n";
+      return octave_value_list();
+  }
+
+  // map the stl file into memory and check that its size matches the
+  // number of triangles in its header
+  std::string file = args(0).string_value();
+  MappedFile mesh;
+  if (! mesh.open (file))
+  {
+      std::cout << "Failure opening file.\n";
+      return octave_value_list();
+  }
+  if (mesh.size < stl_header_size)
+  {
+      std::cout << "File is not a binary STL file.\n";
+      return octave_value_list();
+  }
+  octave_idx_type F_rows = load_ply<uint32_t> (mesh.data + 80);
+  if (mesh.size != stl_header_size + F_rows * stl_record_size)
+  {
+      if (mesh.size >= 5 && memcmp (mesh.data, "solid", 5) == 0)
+      {
+          std::cout << "Only binary STL files are supported.\n";
+      }
+      else
+      {
+          std::cout << "STL file size does not match its number of triangles.\n";
+      }
+      return octave_value_list();
+  }
+
+  // read the facet normals and the vertices of each triangle, merging
+  // identical vertices through a hash table of their coordinates.  The
+  // vertices are kept as the bit patterns of their coordinates
+  const char *records = mesh.data + stl_header_size;
+  Matrix VN (F_rows, 3);
+  double *normals = VN.fortran_vec ();
+  std::vector<octave_idx_type> corners (3 * F_rows);
+  std::vector<uint32_t> vertices;
+  vertices.reserve (weld ? F_rows / 2 * 3 : 9 * F_rows);
+  StlVertexTable table (weld ? F_rows / 2 + 1 : 1);
+  for (octave_idx_type i = 0; i < F_rows; i++)
+  {
+      const char *p = records + i * stl_record_size;
+      float values[12];
+      memcpy (values, p, sizeof (values));
+      for (int j = 0; j < 3; j++)
+      {
+          const float *xyz = values + 3 + 3 * j;
+          if (weld)
+          {
+              corners[3 * i + j] = table.insert (xyz, vertices);
+          }
+          else
+          {
+              uint32_t key[3];
+              memcpy (key, xyz, sizeof (key));
+              corners[3 * i + j] = vertices.size () / 3;
+              vertices.insert (vertices.end (), key, key + 3);
+          }
+      }
+      double n[3] = {values[0], values[1], values[2]};
+      if (n[0] == 0 && n[1] == 0 && n[2] == 0)
+      {
+          // normal of the triangle from the cross product of its edges
+          double ab[3], ac[3];
+          for (int k = 0; k < 3; k++)
+          {
+              ab[k] = double (values[6 + k]) - values[3 + k];
+              ac[k] = double (values[9 + k]) - values[3 + k];
+          }
+          n[0] = ab[1] * ac[2] - ab[2] * ac[1];
+          n[1] = ab[2] * ac[0] - ab[0] * ac[2];
+          n[2] = ab[0] * ac[1] - ab[1] * ac[0];
+          double length = std::sqrt (n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+          for (int k = 0; k < 3 && length > 0; k++)
+          {
+              n[k] /= length;
+          }
+      }
+      for (int k = 0; k < 3; k++)
+      {
+          normals[i + k * F_rows] = n[k];
+      }
+  }
+  octave_idx_type V_rows = vertices.size () / 3;
+  Matrix V (V_rows, 3);
+  double *v = V.fortran_vec ();
+  for (octave_idx_type i = 0; i < V_rows; i++)
+  {
+      for (int k = 0; k < 3; k++)
+      {
+          float value;
+          memcpy (&value, &vertices[3 * i + k], sizeof (value));
+          v[i + k * V_rows] = value;
+      }
+  }
+  MeshArray F, FN;
+  F.allocate (F_rows, 3, index_class);
+  FN.allocate (nargout > 3 ? F_rows : 0, 3, index_class);
+  switch (index_class)
+  {
+    case INDEX_INT32:
+      store_faces (corners, F_rows, static_cast<int32_t *> (F.data ()));
+      store_normal_faces (FN.rows (), static_cast<int32_t *> (FN.data ()));
+      break;
+    case INDEX_UINT32:
+      store_faces (corners, F_rows, static_cast<uint32_t *> (F.data ()));
+      store_normal_faces (FN.rows (), static_cast<uint32_t *> (FN.data ()));
+      break;
+    case INDEX_INT64:
+      store_faces (corners, F_rows, static_cast<int64_t *> (F.data ()));
+      store_normal_faces (FN.rows (), static_cast<int64_t *> (FN.data ()));
+      break;
+    default:
+      store_faces (corners, F_rows, static_cast<double *> (F.data ()));
+      store_normal_faces (FN.rows (), static_cast<double *> (FN.data ()));
+  }
+
+  MeshArray FT;
+  FT.allocate (0, 3, index_class);
+  return mesh_outputs (nargout, V, F.value (), Matrix (0, 2), FT.value (), VN,
+                       FN.value (), false);
+}
@@ -21,24 +21,58 @@ this program; if not, see <http://www.gnu.org/licenses/>.
 #include <vector>
 #include <octave/oct.h>
 #include <octave/parse.h>
+#include "meshIndex.h"
+#include "objWriter.h"
+#include "meshCompact.h"
 
-struct Coord
+// write the header and the elements of a mesh to an open obj file.  The face
+// layout (v, v/vt, v//vn or v/vt/vn) is fixed at compile time and every line
+// is formatted straight from the column data of the input matrices
+template <bool texture, bool normals>
+static void write_mesh(ObjWriter& outputFile, const std::string& filename,
+                       const Matrix& V, const IndexView& F,
+                       const Matrix& VT, const IndexView& FT,
+                       const Matrix& VN, const IndexView& FN, int num_threads)
 {
-	    double x, y, z;
-};
-struct Faces
-{
-      int a, b, c;
-};  
-struct TCoord
-{
-      double u, v  ;
-};
-      
+  // writing header to file
+  outputFile.put("#\n# OBJ File generated by GNU Octave\n# using 'writeObj' function\n");
+  outputFile.put("#\n# Object ");
+  outputFile.put(filename);
+  outputFile.put("\n#\n");
+  outputFile.put("# Vertices: ");
+  outputFile.put_index(V.rows());
+  outputFile.put("\n");
+  outputFile.put("# Faces: ");
+  outputFile.put_index(F.rows());
+  outputFile.put("\n#\n#\n");
+  // append reference to materials file in the header of textured meshes
+  if (texture)
+  {
+    outputFile.put("mtllib ./");
+    outputFile.put(material_filename(filename));
+    outputFile.put("\n");
+  }
+  outputFile.put("\n");
+  // write vertices, texture coordinates and vertex normals to file
+  write_element(outputFile, "v ", V, num_threads);
+  if (texture)
+  {
+    write_element(outputFile, "vt ", VT, num_threads);
+  }
+  if (normals)
+  {
+    write_element(outputFile, "vn ", VN, num_threads);
+  }
+  // write faces along with their texture and normal indices to file
+  const octave_idx_type offsets[3] = {0, 0, 0};
+  write_faces<texture, normals>(outputFile, F, FT, FN, offsets, num_threads);
+}
+
 
-DEFUN_DLD (writeObj, args, , 
+DEFUN_DLD (writeObj, args, nargout, 
           "-*- texinfo -*-\n\
 @deftypefn{Loadable function} writeObj(@var{input_arguments})\n\
+@deftypefnx{Loadable function} FILENAME = writeObj(@var{input_arguments})\n\
 \n\
 \n\
 Example: writeObj(V, F, \"3DMesh.obj\")\n\
@@ -67,769 +101,254 @@ triangular mesh in the following order:\n\
 If 5 input arguments are provided, the function will determine whether there is\n\
 a texture coordinates matrix or a vertex normals matrix by the dimensions of the\n\
 matrix provided as the third input argument\n\
+\n\
+The face matrices may be of class double, int32, uint32 or int64, as returned\n\
+by @code{readObj} with the @code{\"indexclass\"} option, and integer indices\n\
+are read in place without conversion.\n\
+\n\
+Optional property/value pairs may follow the filename:\n\
+\n\
+@code{\"precision\"} sets the number of significant digits (1 to 17) of the\n\
+written coordinates, or \"roundtrip\" for the shortest representation that\n\
+reads back to exactly the same double value. Default is \"roundtrip\".\n\
+\n\
+@code{\"threads\"} sets the number of worker threads used for formatting. The\n\
+elements are split into chunks, which are formatted in parallel and written in\n\
+order, so the file is identical to the one written by a single thread. A value\n\
+of 0 uses all available processors. Default is 1.\n\
+\n\
+@code{\"ifexists\"} sets what happens when the file already exists: \"fail\"\n\
+leaves the existing file untouched and writes nothing, \"overwrite\" replaces\n\
+it and \"rename\" writes the mesh to the first free filename made by appending\n\
+_1, _2, ... to its name. Default is \"fail\".\n\
+\n\
+@code{\"compression\"} compresses the file with \"gzip\" or \"zstd\" on a\n\
+separate thread while it is being written, or disables compression with\n\
+\"none\". By default, files ending in .gz or .zst are compressed accordingly.\n\
+The referenced material library is named after the uncompressed filename,\n\
+e.g. 3DMesh.mtl for 3DMesh.obj.gz. Compression requires writeObj to be\n\
+compiled with the corresponding libraries, as readObj.\n\
+\n\
+@code{\"compressionlevel\"} sets the compression level, from 1 (fastest) to 9\n\
+for gzip or to 19 for zstd. Defaults are 6 for gzip and 3 for zstd.\n\
+\n\
+@code{\"compact\"} welds duplicate vertices and drops the vertices, texture\n\
+coordinates and vertex normals which are not referenced by any face before\n\
+writing, as @code{meshCompact}. Default is false.\n\
+\n\
+@code{\"tolerance\"} sets the largest distance between the vertices welded by\n\
+@code{\"compact\"}. Default is 0, which only welds identical vertices.\n\
+\n\
+@code{\"verbose\"} set to false suppresses the messages printed while\n\
+writing. Errors are always printed. Default is true.\n\
+\n\
+The mesh is written to a temporary file in the same directory, which is moved\n\
+to its final name only after it has been completely written, so other\n\
+processes never read a partially written file. The optional output argument\n\
+returns the name of the written file, which differs from the given filename\n\
+when the file was renamed.\n\
+\n\
+Example: writeObj(V, F, \"3DMesh.obj\", \"precision\", 6)\n\
+\n\
+Example: name = writeObj(V, F, \"3DMesh.obj\", \"ifexists\", \"rename\", \"verbose\", false)\n\
+\n\
+Example: writeObj(V, F, \"3DMesh.obj.gz\")\n\
+\n\
+Example: writeObj(V, F, \"3DMesh.obj\", \"threads\", 8)\n\
 @end deftypefn")
 {
 
-  // count the number of input arguments and store their values
-  // into the appropriate variables
-  // check for invalid number of input arguments
-  if (args.length() != 3 && args.length() != 5 && args.length() != 7)
+  // check the mesh matrices and the filename, which is the first string
+  // argument and may be followed by property/value pairs. The element
+  // matrices share their data with the input arguments, so the mesh is
+  // written without making any copies
+  MeshArguments mesh;
+  std::string error = parse_mesh_arguments(args, mesh);
+  if (!error.empty())
   {
-    std::cout << "Invalid number of input arguments.\n";
+    std::cout << error << "\n";
     return octave_value_list();
   }
-  // for three input arguments
-  //
-  // check for last argument being a string
-  if (args.length() == 3 && !args(2).is_string())
+  // number of significant digits of the written coordinates
+  int precision = PRECISION_ROUNDTRIP;
+  // number of worker threads used for formatting
+  int num_threads = 1;
+  // what to do if the file already exists
+  int if_exists = EXISTING_FAIL;
+  // whether to print progress messages
+  bool verbose = true;
+  // compression format, which is otherwise implied by the filename
+  int compression = -1;
+  int compression_level = -1;
+  // whether to weld the vertices within tolerance before writing
+  bool compact = false;
+  double tolerance = 0;
+  for (int i = mesh.options; i < args.length(); i += 2)
   {
-    std::cout << "Third input argument should be a string.\n";
-    return octave_value_list();
-  }
-  // check for first two arguments being real matrices
-  if (!args(0).is_matrix_type() || !args(1).is_matrix_type())
-  {
-    std::cout << "The first two arguments should be real matrices.\n";
-    return octave_value_list();
-  }
-  // considering two input arguments for vertices and faces respcectively and
-  // and a third argument as string for filename under which the vertices and
-  // will be saved
-  if (args.length() == 3 && args(2).is_string())
-  {
-    // store vertices, faces and filename
-    Matrix V = args(0).array_value();
-    Matrix F = args(1).array_value();
-    std::string filename = args(2).string_value();
-    // find number of vertices and faces
-    octave_idx_type V_rows = args(0).rows();
-    octave_idx_type F_rows = args(1).rows();
-    octave_idx_type V_columns = args(0).columns();
-    octave_idx_type F_columns = args(1).columns();
-    // ensure that there are at least 3 vertices and one face in the mesh and
-    // vertex and face matrices are Nx3 in size
-    if (V_rows < 3)
-    {
-      std::cout << "There should be at least 3 vertices in the mesh.\n";
-      return octave_value_list();
-    }
-    if (V_columns != 3)
-    {
-      std::cout << "Vertex matrix should be Nx3 containing x,y,z coordinates.\n";
-      return octave_value_list();
-    }
-    if (F_rows < 1)
-    {
-      std::cout << "There should be at least 1 face in the mesh.\n";
-      return octave_value_list();
-    }
-    if (F_columns != 3)
-    {
-      std::cout << "Face matrix should be Nx3 containing three vertices.\n";
-      return octave_value_list();
-    }
-    // define matrices for storing vertices and faces to file
-    std::vector<Coord> vertex;
-    std::vector<Faces> face;
-    // store vertices in a vector
-    float tmpx, tmpy, tmpz;
-    for (octave_idx_type i = 0; i < V_rows; i++)
+    std::string property = args(i).is_string() ? args(i).string_value() : "";
+    if (property == "precision" && args(i+1).is_string()
+          && args(i+1).string_value() == "roundtrip")
     {
-      tmpx = V(i,0);
-      tmpy = V(i,1);
-      tmpz = V(i,2);
-      Coord temp_vertex = {tmpx, tmpy, tmpz};
-      vertex.push_back(temp_vertex);
+      precision = PRECISION_ROUNDTRIP;
     }
-    // store faces in a vector
-    int tmpa, tmpb, tmpc;
-    for (octave_idx_type i = 0; i < F_rows; i++)
+    else if (property == "precision" && args(i+1).is_real_scalar()
+               && args(i+1).int_value() >= 1 && args(i+1).int_value() <= 17)
     {
-      tmpa = F(i,0);
-      tmpb = F(i,1);
-      tmpc = F(i,2);
-      Faces temp_face = {tmpa, tmpb, tmpc};
-      face.push_back(temp_face);
+      precision = args(i+1).int_value();
     }
-    ////
-    //// code for creating file and storing elements goes here!!!
-    //// vertices + faces
-    ////
-    //// skip reference to materials file from the header
-    ////
-    // check if filename exists
-    bool filename_exists = std::ifstream(filename.c_str()).good();
-    if (filename_exists)
+    else if (property == "threads" && args(i+1).is_real_scalar())
     {
-      std::cout << "Filename already exists.\n";
-      std::cout << "Do you want to replace? (yes or no)\n";
-      std::string yes_or_no;
-      getline(std::cin, yes_or_no);
-      while (yes_or_no.compare("yes") && yes_or_no.compare("no"))
+      num_threads = args(i+1).int_value();
+      if (num_threads < 1)
       {
-        std::cout << "Please answer yes or no! ";
-        getline(std::cin, yes_or_no);
+        num_threads = std::thread::hardware_concurrency();
       }
-      if (yes_or_no.compare("yes"))
+      if (num_threads < 1)
       {
-        std::string newfilename;
-        std::cout << "Please enter new filename: ";
-        getline(std::cin, newfilename);
-        filename = newfilename.c_str();
+        num_threads = 1;
       }
     }
-    std::ofstream outputFile(filename.c_str());
-    if (!outputFile.is_open())
-    {
-      std::cout << "Error opening " << filename.c_str() << "for write\n";
-      return octave_value_list();
-    }
-    else
-    {
-      // writing header to file
-      outputFile << "#\n# OBJ File generated by GNU Octave\n# using 'writeObj' function\n";
-      outputFile << "#\n# Object " << filename.c_str() << "\n#\n";
-      outputFile << "# Vertices: " << V_rows << "\n";
-      outputFile << "# Faces: " << F_rows << "\n#\n#\n\n";
-      std::cout << "Writing to file... ";
-      // write vertices to file
-      for(std::vector<Coord>::iterator v_it = vertex.begin(); v_it != vertex.end(); ++v_it)
-      {
-        outputFile << "v " << v_it->x <<" "<< v_it->y <<" "<< v_it->z <<"\n";
-      }
-      // write faces to file
-      for(std::vector<Faces>::iterator f_it = face.begin(); f_it != face.end(); ++f_it)
-      {
-        outputFile << "f " << f_it->a <<" "<< f_it->b <<" "<< f_it->c <<"\n";
-      }
-      outputFile.close();
-      std::cout << "done!\n";
-    }
-    ////
-    ////
-    ////
-    ////
-    std::cout << "Mesh filename is " << filename.c_str() << "\n";
-    std::cout << "Mesh has " << V_rows << " vertices.\n";
-    std::cout << "Mesh has " << F_rows << " faces.\n";
-    return octave_value_list();
-  }
-  // for five input arguments
-  //
-  // check for last argument being a string
-  if (args.length() == 5 && !args(4).is_string())
-  {
-    std::cout << "Fifth input argument should be a string.\n";
-    return octave_value_list();
-  }
-  // check for first four arguments being real matrices
-  if (!args(0).is_matrix_type() || !args(1).is_matrix_type() || 
-        !args(2).is_matrix_type() || !args(3).is_matrix_type())
-  {
-    std::cout << "The first four arguments should be real matrices.\n";
-    return octave_value_list();
-  }
-  // considering four input arguments being real matrices, the first two are for
-  // vertices and faces respcectively, whereas the latter will either be for
-  // texture coordinates and texture faces or for vertex normals and face normals.
-  // This will depend on the number of coordinates present in third input argument.
-  // The last input argument should again be a string
-  // 
-  // check for 5 input arguments with the third argument having two coordinates
-  // present, namely u, v, and the last argument being a string
-  if (args.length() == 5 && args(2).columns() == 2 && args(4).is_string())
-  {
-    // store vertices, faces and filename
-    Matrix V = args(0).array_value();
-    Matrix F = args(1).array_value();
-    Matrix VT = args(2).array_value();
-    Matrix FT = args(3).array_value();
-    std::string filename = args(4).string_value();
-    // find number of vertices and faces
-    octave_idx_type V_rows = args(0).rows();
-    octave_idx_type F_rows = args(1).rows();
-    octave_idx_type VT_rows = args(2).rows();
-    octave_idx_type FT_rows = args(3).rows();
-    octave_idx_type V_columns = args(0).columns();
-    octave_idx_type F_columns = args(1).columns();
-    octave_idx_type VT_columns = args(2).columns();
-    octave_idx_type FT_columns = args(3).columns();
-    // ensure that there are at least 3 vertices and one face in the mesh and
-    // vertex and face matrices are Nx3.
-    if (V_rows < 3)
-    {
-      std::cout << "There should be at least 3 vertices in the mesh.\n";
-      return octave_value_list();
-    }
-    if (V_columns != 3)
-    {
-      std::cout << "Vertex matrix should be Nx3 containing x,y,z coordinates.\n";
-      return octave_value_list();
-    }
-    if (F_rows < 1)
+    else if (property == "ifexists" && args(i+1).is_string()
+               && existing_file_value(args(i+1).string_value()) >= 0)
     {
-      std::cout << "There should be at least 1 face in the mesh.\n";
-      return octave_value_list();
+      if_exists = existing_file_value(args(i+1).string_value());
     }
-    if (F_columns != 3)
+    else if (property == "compression" && args(i+1).is_string()
+               && output_compression_value(args(i+1).string_value()) >= 0)
     {
-      std::cout << "Face matrix should be Nx3 containing three vertices.\n";
-      return octave_value_list();
+      compression = output_compression_value(args(i+1).string_value());
     }
-    // check that texture faces are a Nx3 matrix
-    if (FT_columns != 3)
+    else if (property == "compressionlevel" && args(i+1).is_real_scalar()
+               && args(i+1).int_value() >= 1 && args(i+1).int_value() <= 19)
     {
-      std::cout << "Texture face matrix should be Nx3 containing three vertices.\n";
-      return octave_value_list();
+      compression_level = args(i+1).int_value();
     }
-    // define matrices for storing vertices, faces, texture coordinates and 
-    // texture faces to file
-    std::vector<Coord> vertex;
-    std::vector<Faces> face;
-    std::vector<TCoord> texture_coord;
-    std::vector<Faces> face_texture;
-    // store vertices in a vector
-    float tmpx, tmpy, tmpz;
-    for (octave_idx_type i = 0; i < V_rows; i++)
+    else if (property == "compact" && args(i+1).is_bool_scalar())
     {
-      tmpx = V(i,0);
-      tmpy = V(i,1);
-      tmpz = V(i,2);
-      Coord temp_vertex = {tmpx, tmpy, tmpz};
-      vertex.push_back(temp_vertex);
+      compact = args(i+1).bool_value();
     }
-    // store faces in a vector
-    int tmpa, tmpb, tmpc;
-    for (octave_idx_type i = 0; i < F_rows; i++)
+    else if (property == "tolerance" && args(i+1).is_real_scalar()
+               && args(i+1).double_value() >= 0)
     {
-      tmpa = F(i,0);
-      tmpb = F(i,1);
-      tmpc = F(i,2);
-      Faces temp_face = {tmpa, tmpb, tmpc};
-      face.push_back(temp_face);
+      tolerance = args(i+1).double_value();
     }
-    // store texture coordinates in a vector
-    float tmpu, tmpv;
-    for (octave_idx_type i = 0; i < VT_rows; i++)
+    else if (property == "verbose" && (args(i+1).is_bool_scalar()
+               || args(i+1).is_real_scalar()))
     {
-      tmpu = VT(i,0);
-      tmpv = VT(i,1);
-      TCoord temp_texture_coord = {tmpu, tmpv};
-      texture_coord.push_back(temp_texture_coord);
+      verbose = args(i+1).bool_value();
     }
-    // store texture faces in a vector
-    for (octave_idx_type i = 0; i < FT_rows; i++)
-    {
-      tmpa = FT(i,0);
-      tmpb = FT(i,1);
-      tmpc = FT(i,2);
-      Faces temp_texture_face = {tmpa, tmpb, tmpc};
-      face_texture.push_back(temp_texture_face);
-    }
-    // check that matrices for faces and texture faces have the same length
-    // to ensure that the iterator will not break when writing to the file
-    if (F_rows != FT_rows)
+    else
     {
-      std::cout << "Faces and texture faces should contain the same\n"
-                << "number of values.\n";
+      std::cout << "Invalid property or value in input arguments.\n";
       return octave_value_list();
     }
-    ////
-    //// code for creating file and storing elements goes here!!!
-    //// vertices + faces + texture coordinates + texture faces
-    ////
-    //// append reference to materials file in the header
-    ////
-    // check if filename exists
-    bool filename_exists = std::ifstream(filename.c_str()).good();
-    if (filename_exists)
-    {
-      std::cout << "Filename already exists.\n";
-      std::cout << "Do you want to replace? (yes or no)\n";
-      std::string yes_or_no;
-      getline(std::cin, yes_or_no);
-      while (yes_or_no.compare("yes") && yes_or_no.compare("no"))
-      {
-        std::cout << "Please answer yes or no! ";
-        getline(std::cin, yes_or_no);
-      }
-      if (yes_or_no.compare("yes"))
-      {
-        std::string newfilename;
-        std::cout << "Please enter new filename: ";
-        getline(std::cin, newfilename);
-        filename = newfilename.c_str();
-      }
-    }
-    std::ofstream outputFile(filename.c_str());
-    if (!outputFile.is_open())
+  }
+  bool texture = mesh.texture;
+  bool normals = mesh.normals;
+  Matrix V = mesh.V;
+  IndexView F (mesh.F);
+  Matrix VT = mesh.VT;
+  IndexView FT (mesh.FT);
+  Matrix VN = mesh.VN;
+  IndexView FN (mesh.FN);
+  std::string filename = mesh.filename;
+  octave_idx_type V_rows = V.rows();
+  octave_idx_type F_rows = F.rows();
+  // weld the vertices and drop the unreferenced rows of every element,
+  // which replaces the shared element matrices by compacted copies
+  if (compact)
+  {
+    error = compact_mesh(V, F, VT, FT, VN, FN, texture, normals,
+                         tolerance);
+    if (!error.empty())
     {
-      std::cout << "Error opening " << filename.c_str() << "for write\n";
+      std::cout << error << "\n";
       return octave_value_list();
     }
-    else
-    {
-      // writing header to file
-      outputFile << "#\n# OBJ File generated by GNU Octave\n# using 'writeObj' function\n";
-      outputFile << "#\n# Object " << filename.c_str() << "\n#\n";
-      outputFile << "# Vertices: " << V_rows << "\n";
-      outputFile << "# Faces: " << F_rows << "\n#\n#\n";
-      int i = filename.length() - 3;
-      std::string mtlfilename = filename.c_str();
-      outputFile << "mtllib ./" << mtlfilename.replace(i,3, "mtl") <<"\n\n";
-      std::cout << "Writing to file... ";
-      // write vertices to file
-      for(std::vector<Coord>::iterator v_it = vertex.begin(); v_it != vertex.end(); ++v_it)
-      {
-        outputFile << "v " << v_it->x <<" "<< v_it->y <<" "<< v_it->z <<"\n";
-      }
-      // write texture coordinates to file
-      for(std::vector<TCoord>::iterator vt_it = texture_coord.begin(); 
-                  vt_it != texture_coord.end(); ++vt_it)
-      {
-        outputFile << "vt " << vt_it->u <<" "<< vt_it->v <<"\n";
-      }
-      // write faces and texture faces to file
-      std::vector<Faces>::const_iterator f_it;
-      std::vector<Faces>::const_iterator ft_it;
-      for(f_it = face.begin(), ft_it = face_texture.begin(); f_it != face.end(),
-                  ft_it != face_texture.end(); ++f_it, ++ft_it)
-      {
-        outputFile << "f " << f_it->a <<"/"<< ft_it->a <<" "<< f_it->b <<"/"
-                   << ft_it->b <<" "<< f_it->c <<"/"<< ft_it->c <<"\n";
-      }
-      outputFile.close();
-      std::cout << "done!\n";
-    }
-    ////
-    ////
-    ////
-    ////
-    std::cout << "Mesh filename is " << filename.c_str() << "\n";
-    std::cout << "Mesh has " << V_rows << " vertices.\n";
-    std::cout << "Mesh has " << F_rows << " faces.\n";
+    V_rows = V.rows();
+  }
+  // compress files ending in .gz or .zst unless told otherwise
+  if (compression < 0)
+  {
+    compression = output_compression_of(filename);
+  }
+  if (compression == OUTPUT_GZIP && compression_level > 9)
+  {
+    std::cout << "Compression level of gzip should be between 1 and 9.\n";
     return octave_value_list();
   }
-  // 
-  // check for 5 input arguments with the third argument having three coordinates
-  // present, namely x, y, z, and the last argument being a string
-  if (args.length() == 5 && args(2).columns() == 3 && args(4).is_string())
+#if ! defined (HAVE_ZLIB)
+  if (compression == OUTPUT_GZIP)
   {
-    // store vertices, faces and filename
-    Matrix V = args(0).array_value();
-    Matrix F = args(1).array_value();
-    Matrix VN = args(2).array_value();
-    Matrix FN = args(3).array_value();
-    std::string filename = args(4).string_value();
-    // find number of vertices and faces
-    octave_idx_type V_rows = args(0).rows();
-    octave_idx_type F_rows = args(1).rows();
-    octave_idx_type VN_rows = args(2).rows();
-    octave_idx_type FN_rows = args(3).rows();
-    octave_idx_type V_columns = args(0).columns();
-    octave_idx_type F_columns = args(1).columns();
-    octave_idx_type VN_columns = args(2).columns();
-    octave_idx_type FN_columns = args(3).columns();
-    // ensure that there are at least 3 vertices and one face in the mesh and
-    // vertex normals and face normals matrices are Nx3.
-    if (V_rows < 3)
-    {
-      std::cout << "There should be at least 3 vertices in the mesh.\n";
-      return octave_value_list();
-    }
-    if (V_columns != 3)
-    {
-      std::cout << "Vertex matrix should be Nx3 containing x,y,z coordinates.\n";
-      return octave_value_list();
-    }
-    if (F_rows < 1)
-    {
-      std::cout << "There should be at least 1 face in the mesh.\n";
-      return octave_value_list();
-    }
-    if (F_columns != 3)
-    {
-      std::cout << "Face matrix should be Nx3 containing three vertices.\n";
-      return octave_value_list();
-    }
-    // check that face normals are a Nx3 matrix
-    if (FN_columns != 3)
-    {
-      std::cout << "Face normals should be an Nx3 matrix.\n";
-      return octave_value_list();
-    }
-    // define matrices for storing vertices and faces to file
-    std::vector<Coord> vertex;
-    std::vector<Faces> face;
-    std::vector<Coord> vertex_normals;
-    std::vector<Faces> face_normals;
-    // store vertices in a vector
-    float tmpx, tmpy, tmpz;
-    for (octave_idx_type i = 0; i < V_rows; i++)
-    {
-      tmpx = V(i,0);
-      tmpy = V(i,1);
-      tmpz = V(i,2);
-      Coord temp_vertex = {tmpx, tmpy, tmpz};
-      vertex.push_back(temp_vertex);
-    }
-    // store faces in a vector
-    int tmpa, tmpb, tmpc;
-    for (octave_idx_type i = 0; i < F_rows; i++)
-    {
-      tmpa = F(i,0);
-      tmpb = F(i,1);
-      tmpc = F(i,2);
-      Faces temp_face = {tmpa, tmpb, tmpc};
-      face.push_back(temp_face);
-    }
-    // store vertex normals in a vector
-    for (octave_idx_type i = 0; i < VN_rows; i++)
-    {
-      tmpx = VN(i,0);
-      tmpy = VN(i,1);
-      tmpz = VN(i,2);
-      Coord temp_vertex_normals = {tmpx, tmpy, tmpz};
-      vertex_normals.push_back(temp_vertex_normals);
-    }
-    // store face normals in a vector
-    for (octave_idx_type i = 0; i < FN_rows; i++)
-    {
-      tmpa = FN(i,0);
-      tmpb = FN(i,1);
-      tmpc = FN(i,2);
-      Faces temp_face_normals = {tmpa, tmpb, tmpc};
-      face_normals.push_back(temp_face_normals);
-    }
-    // check that matrices for faces and face normals have the same length
-    // to ensure that the iterator will not break when writing to the file
-    if (F_rows != FN_rows)
-    {
-      std::cout << "Faces and face normals should contain the same\n"
-                << "number of values.\n";
-      return octave_value_list();
-    }
-    ////
-    //// code for creating file and storing elements goes here!!!
-    //// vertices + faces + vertex normals + face normals
-    ////
-    //// skip reference to materials file from the header
-    ////
-    // check if filename exists
-    bool filename_exists = std::ifstream(filename.c_str()).good();
-    if (filename_exists)
-    {
-      std::cout << "Filename already exists.\n";
-      std::cout << "Do you want to replace? (yes or no)\n";
-      std::string yes_or_no;
-      getline(std::cin, yes_or_no);
-      while (yes_or_no.compare("yes") && yes_or_no.compare("no"))
-      {
-        std::cout << "Please answer yes or no! ";
-        getline(std::cin, yes_or_no);
-      }
-      if (yes_or_no.compare("yes"))
-      {
-        std::string newfilename;
-        std::cout << "Please enter new filename: ";
-        getline(std::cin, newfilename);
-        filename = newfilename.c_str();
-      }
-    }
-    std::ofstream outputFile(filename.c_str());
-    if (!outputFile.is_open())
-    {
-      std::cout << "Error opening " << filename.c_str() << "for write\n";
-      return octave_value_list();
-    }
-    else
-    {
-      // writing header to file
-      outputFile << "#\n# OBJ File generated by GNU Octave\n# using 'writeObj' function\n";
-      outputFile << "#\n# Object " << filename.c_str() << "\n#\n";
-      outputFile << "# Vertices: " << V_rows << "\n";
-      outputFile << "# Faces: " << F_rows << "\n#\n#\n\n";
-      std::cout << "Writing to file... ";
-      // write vertices to file
-      for(std::vector<Coord>::iterator v_it = vertex.begin(); v_it != vertex.end(); ++v_it)
-      {
-        outputFile << "v " << v_it->x <<" "<< v_it->y <<" "<< v_it->z <<"\n";
-      }
-      // write vertex normals to file
-      for(std::vector<Coord>::iterator vn_it = vertex_normals.begin(); 
-                  vn_it != vertex_normals.end(); ++vn_it)
-      {
-        outputFile << "vn " << vn_it->x <<" "<< vn_it->y <<" "<< vn_it->z <<"\n";
-      }
-      // write faces and face normals to file
-      std::vector<Faces>::const_iterator f_it;
-      std::vector<Faces>::const_iterator fn_it;
-      for(f_it = face.begin(), fn_it = face_normals.begin(); f_it != face.end(),
-                  fn_it != face_normals.end(); ++f_it, ++fn_it)
-      {
-        outputFile << "f " << f_it->a <<"//"<< fn_it->a <<" "<< f_it->b <<"//"
-                   << fn_it->b <<" "<< f_it->c <<"//"<< fn_it->c <<"\n";
-      }
-      outputFile.close();
-      std::cout << "done!\n";
-    }
-    ////
-    ////
-    ////
-    ////
-    std::cout << "Mesh filename is " << filename.c_str() << "\n";
-    std::cout << "Mesh has " << V_rows << " vertices.\n";
-    std::cout << "Mesh has " << F_rows << " faces.\n";
+    std::cout << "writeObj was compiled without gzip support.\n";
     return octave_value_list();
   }
-  // for seven input arguments
-  //
-  // check for last argument being a string
-  if (args.length() == 7 && !args(6).is_string())
+#endif
+#if ! defined (HAVE_ZSTD)
+  if (compression == OUTPUT_ZSTD)
   {
-    std::cout << "Seventh input argument should be a string.\n";
+    std::cout << "writeObj was compiled without zstd support.\n";
     return octave_value_list();
   }
-  // check for first six arguments being real matrices
-  if (!args(0).is_matrix_type() || !args(1).is_matrix_type() || 
-        !args(2).is_matrix_type() || !args(3).is_matrix_type() ||
-        !args(4).is_matrix_type() || !args(5).is_matrix_type())
+#endif
+  // check if filename exists and either give up or pick a free filename
+  if (!resolve_filename(filename, if_exists))
   {
-    std::cout << "The first six arguments should be real matrices.\n";
+    std::cout << "Filename " << filename.c_str() << " already exists.\n";
     return octave_value_list();
   }
-  // considering six input arguments being real matrices, the first two are for
-  // vertices and faces respcectively, the next two are texture vertices and
-  // texture faces, and the last two are vertex normals and face normals.
-  // 
-  // check for 7 input arguments with the last argument being a string
-  if (args.length() == 7 && args(6).is_string())
+  ObjWriter outputFile(precision);
+  if (!outputFile.open(filename, if_exists == EXISTING_OVERWRITE, compression,
+                       compression_level))
   {
-    // store vertices, faces and filename
-    Matrix V = args(0).array_value();
-    Matrix F = args(1).array_value();
-    Matrix VT = args(2).array_value();
-    Matrix FT = args(3).array_value();
-    Matrix VN = args(4).array_value();
-    Matrix FN = args(5).array_value();
-    std::string filename = args(6).string_value();
-    // find number of vertices and faces
-    octave_idx_type V_rows = args(0).rows();
-    octave_idx_type F_rows = args(1).rows();
-    octave_idx_type VT_rows = args(2).rows();
-    octave_idx_type FT_rows = args(3).rows();
-    octave_idx_type VN_rows = args(4).rows();
-    octave_idx_type FN_rows = args(5).rows();
-    octave_idx_type V_columns = args(0).columns();
-    octave_idx_type F_columns = args(1).columns();
-    octave_idx_type VT_columns = args(2).columns();
-    octave_idx_type FT_columns = args(3).columns();
-    octave_idx_type VN_columns = args(4).columns();
-    octave_idx_type FN_columns = args(5).columns();
-    // ensure that there are at least 3 vertices and one face in the mesh and
-    // vertex normals and face normals matrices are Nx3.
-    if (V_rows < 3)
-    {
-      std::cout << "There should be at least 3 vertices in the mesh.\n";
-      return octave_value_list();
-    }
-    if (V_columns != 3)
-    {
-      std::cout << "Vertex matrix should be Nx3 containing x,y,z coordinates.\n";
-      return octave_value_list();
-    }
-    if (F_rows < 1)
-    {
-      std::cout << "There should be at least 1 face in the mesh.\n";
-      return octave_value_list();
-    }
-    if (F_columns != 3)
-    {
-      std::cout << "Face matrix should be Nx3 containing three vertices.\n";
-      return octave_value_list();
-    }
-    // check that texture coordinates are an Nx2 matrix
-    if (VT_columns != 2)
-    {
-      std::cout << "Texture ccoordinates matrix should be an Nx2 matrix.\n";
-      return octave_value_list();
-    }
-    // check that texture faces are an Nx3 matrix
-    if (FT_columns != 3)
-    {
-      std::cout << "Texture faces matrix should be an Nx3 matrix.\n";
-      return octave_value_list();
-    }
-    // check that vertex normals are an Nx3 matrix
-    if (VN_columns != 3)
-    {
-      std::cout << "Vertex normals should be an Nx3 matrix.\n";
-      return octave_value_list();
-    }
-    // check that face normals are an Nx3 matrix
-    if (FN_columns != 3)
-    {
-      std::cout << "Face normals should be an Nx3 matrix.\n";
-      return octave_value_list();
-    }
-    // define matrices for storing vertices, faces, texture coordinates,
-    // texture faces, vertex normals and face normals to file
-    std::vector<Coord> vertex;
-    std::vector<Faces> face;
-    std::vector<TCoord> texture_coord;
-    std::vector<Faces> face_texture;
-    std::vector<Coord> vertex_normals;
-    std::vector<Faces> face_normals;
-    // store vertices in a vector
-    float tmpx, tmpy, tmpz;
-    for (octave_idx_type i = 0; i < V_rows; i++)
-    {
-      tmpx = V(i,0);
-      tmpy = V(i,1);
-      tmpz = V(i,2);
-      Coord temp_vertex = {tmpx, tmpy, tmpz};
-      vertex.push_back(temp_vertex);
-    }
-    // store faces in a vector
-    int tmpa, tmpb, tmpc;
-    for (octave_idx_type i = 0; i < F_rows; i++)
-    {
-      tmpa = F(i,0);
-      tmpb = F(i,1);
-      tmpc = F(i,2);
-      Faces temp_face = {tmpa, tmpb, tmpc};
-      face.push_back(temp_face);
-    }
-    // store texture coordinates in a vector
-    float tmpu, tmpv;
-    for (octave_idx_type i = 0; i < VT_rows; i++)
-    {
-      tmpu = VT(i,0);
-      tmpv = VT(i,1);
-      TCoord temp_texture_coord = {tmpu, tmpv};
-      texture_coord.push_back(temp_texture_coord);
-    }
-    // store texture faces in a vector
-    for (octave_idx_type i = 0; i < FT_rows; i++)
-    {
-      tmpa = FT(i,0);
-      tmpb = FT(i,1);
-      tmpc = FT(i,2);
-      Faces temp_texture_face = {tmpa, tmpb, tmpc};
-      face_texture.push_back(temp_texture_face);
-    }
-    // store vertex normals in a vector
-    for (octave_idx_type i = 0; i < VN_rows; i++)
-    {
-      tmpx = VN(i,0);
-      tmpy = VN(i,1);
-      tmpz = VN(i,2);
-      Coord temp_vertex_normals = {tmpx, tmpy, tmpz};
-      vertex_normals.push_back(temp_vertex_normals);
-    }
-    // store face normals in a vector
-    for (octave_idx_type i = 0; i < FN_rows; i++)
-    {
-      tmpa = FN(i,0);
-      tmpb = FN(i,1);
-      tmpc = FN(i,2);
-      Faces temp_face_normals = {tmpa, tmpb, tmpc};
-      face_normals.push_back(temp_face_normals);
-    }
-    // check that matrices for faces, texture faces and face normals have
-    // the same length to ensure that the iterator will not break when
-    // writing to the file
-    if (F_rows != FT_rows && F_rows != FN_rows)
-    {
-      std::cout << "Faces, texture faces and face normals should contain\n"
-                << "the same number of values.\n";
-      return octave_value_list();
-    }
-    ////
-    //// code for creating file and storing elements goes here!!!
-    //// vertices + faces + texture coordinates + texture faces
-    //// + vertex normals + face normals
-    ////
-    ////  append reference to materials file in the header
-    ////
-    // check if filename exists
-    bool filename_exists = std::ifstream(filename.c_str()).good();
-    if (filename_exists)
-    {
-      std::cout << "Filename already exists.\n";
-      std::cout << "Do you want to replace? (yes or no)\n";
-      std::string yes_or_no;
-      getline(std::cin, yes_or_no);
-      while (yes_or_no.compare("yes") && yes_or_no.compare("no"))
-      {
-        std::cout << "Please answer yes or no! ";
-        getline(std::cin, yes_or_no);
-      }
-      if (yes_or_no.compare("yes"))
-      {
-        std::string newfilename;
-        std::cout << "Please enter new filename: ";
-        getline(std::cin, newfilename);
-        filename = newfilename.c_str();
-      }
-    }
-    std::ofstream outputFile(filename.c_str());
-    if (!outputFile.is_open())
+    std::cout << "Error opening " << filename.c_str() << " for write\n";
+    return octave_value_list();
+  }
+  if (verbose)
+  {
+    std::cout << "Writing to file... ";
+  }
+  if (texture && normals)
+  {
+    write_mesh<true, true>(outputFile, filename, V, F, VT, FT, VN, FN, num_threads);
+  }
+  else if (texture)
+  {
+    write_mesh<true, false>(outputFile, filename, V, F, VT, FT, VN, FN, num_threads);
+  }
+  else if (normals)
+  {
+    write_mesh<false, true>(outputFile, filename, V, F, VT, FT, VN, FN, num_threads);
+  }
+  else
+  {
+    write_mesh<false, false>(outputFile, filename, V, F, VT, FT, VN, FN, num_threads);
+  }
+  // another process may have created the file while it was being written,
+  // which is never replaced unless overwriting is allowed
+  if (!outputFile.close())
+  {
+    if (outputFile.target_existed())
     {
-      std::cout << "Error opening " << filename.c_str() << "for write\n";
-      return octave_value_list();
+      std::cout << "Filename " << filename.c_str() << " already exists.\n";
     }
     else
     {
-      // writing header to file
-      outputFile << "#\n# OBJ File generated by GNU Octave\n# using 'writeObj' function\n";
-      outputFile << "#\n# Object " << filename.c_str() << "\n#\n";
-      outputFile << "# Vertices: " << V_rows << "\n";
-      outputFile << "# Faces: " << F_rows << "\n#\n#\n";
-			// write materials reference filename
-      int i = filename.length() - 3;
-      std::string mtlfilename = filename.c_str();
-      outputFile << "mtllib ./" << mtlfilename.replace(i,3, "mtl") <<"\n\n";
-      std::cout << "Writing to file... ";
-      // write vertices to file
-      for(std::vector<Coord>::iterator v_it = vertex.begin(); v_it != vertex.end(); ++v_it)
-      {
-        outputFile << "v " << v_it->x <<" "<< v_it->y <<" "<< v_it->z <<"\n";
-      }
-      // write texture coordinates to file
-      for(std::vector<TCoord>::iterator vt_it = texture_coord.begin(); 
-                  vt_it != texture_coord.end(); ++vt_it)
-      {
-        outputFile << "vt " << vt_it->u <<" "<< vt_it->v <<"\n";
-      }
-      // write vertex normals to file
-      for(std::vector<Coord>::iterator vn_it = vertex_normals.begin(); 
-                  vn_it != vertex_normals.end(); ++vn_it)
-      {
-        outputFile << "vn " << vn_it->x <<" "<< vn_it->y <<" "<< vn_it->z <<"\n";
-      }
-      // write faces and face normals to file
-      std::vector<Faces>::const_iterator f_it;
-      std::vector<Faces>::const_iterator ft_it;
-      std::vector<Faces>::const_iterator fn_it;
-      for(f_it = face.begin(), ft_it = face_texture.begin(),
-          fn_it = face_normals.begin(); f_it != face.end(),
-          ft_it != face_texture.end(), fn_it != face_normals.end();
-          ++f_it, ++ft_it, ++fn_it)
-      {
-        outputFile << "f " << f_it->a <<"/"<< ft_it->a <<"/"<< fn_it->a <<" "
-                           << f_it->b <<"/"<< ft_it->b <<"/"<< fn_it->b <<" "
-                           << f_it->c <<"/"<< ft_it->c <<"/"<< fn_it->c <<"\n";
-      }
-      outputFile.close();
-      std::cout << "done!\n";
+      std::cout << "Error writing " << filename.c_str() << "\n";
     }
-    ////
-    ////
-    ////
+    return octave_value_list();
+  }
+  if (verbose)
+  {
+    std::cout << "done!\n";
     std::cout << "Mesh filename is " << filename.c_str() << "\n";
     std::cout << "Mesh has " << V_rows << " vertices.\n";
     std::cout << "Mesh has " << F_rows << " faces.\n";
-    return octave_value_list();
   }
-}
\ No newline at end of file
+  octave_value_list retval;
+  if (nargout > 0)
+  {
+    retval(0) = filename;
+  }
+  return retval;
+}
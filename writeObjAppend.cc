@@ -0,0 +1,224 @@
+/*
+Copyright (C) 2018-2020 Andreas Bertsatos <abertsatos@biol.uoa.gr>
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free Software
+Foundation; either version 3 of the License, or (at your option) any later
+version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+details.
+
+You should have received a copy of the GNU General Public License along with
+this program; if not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <iostream>
+#include <string>
+#include <octave/oct.h>
+#include "meshIndex.h"
+#include "meshCompact.h"
+#include "objWriter.h"
+
+
+DEFUN_DLD (writeObjAppend, args, nargout,
+          "-*- texinfo -*-\n\
+@deftypefn{Loadable function} @var{objWriter} = writeObjAppend(@var{objWriter}, @var{input_arguments})\n\
+\n\
+\n\
+Example: objWriter = writeObjAppend(objWriter, V, F, \"femur\")\n\
+\n\
+\n\
+This function appends a triangular 3D Mesh to a Wavefront Obj file opened\n\
+with @code{writeObjOpen}. It takes the same 3, 5 or 7 input arguments as\n\
+@code{writeObj} after @var{objWriter}, i.e. the vertices and faces,\n\
+optionally followed by texture coordinates and texture faces and/or vertex\n\
+normals and face normals, with the name of the mesh in place of the\n\
+filename.\n\
+\n\
+Each mesh is written as its own block, which starts with an object and a\n\
+group statement of the given name, followed by its vertices, texture\n\
+coordinates, vertex normals and faces. The face indices of the mesh refer to\n\
+its own rows and are offset by the number of elements of the meshes written\n\
+before it, so the matrices are streamed to the file without being copied or\n\
+concatenated. The material library is referenced before the first textured\n\
+mesh, as in @code{writeObj}.\n\
+\n\
+The updated @var{objWriter} must be passed to the next call and finally to\n\
+@code{writeObjClose}.\n\
+\n\
+Optional property/value pairs may follow the name:\n\
+\n\
+@code{\"compact\"} welds duplicate vertices and drops unreferenced rows of\n\
+the mesh before it is written, as in @code{writeObj}. Default is false.\n\
+\n\
+@code{\"tolerance\"} sets the largest distance between the vertices welded by\n\
+@code{\"compact\"}. Default is 0, which only welds identical vertices.\n\
+\n\
+Example: w = writeObjAppend(w, V, F, VN, FN, \"tibia\", \"compact\", true)\n\
+@end deftypefn")
+{
+
+  // Check for a valid number of input and output arguments
+  if (args.length() < 1 || ! args(0).isstruct())
+  {
+      std::cout << "Invalid number of input arguments.\n";
+      return octave_value_list();
+  }
+  if (nargout != 1)
+  {
+      std::cout << "Invalid number of output arguments.\n";
+      return octave_value_list();
+  }
+  octave_scalar_map writer = args(0).scalar_map_value();
+  if (! writer.isfield ("temporary") || ! writer.isfield ("face_offset"))
+  {
+      std::cout << "First input argument should be an objWriter structure.\n";
+      return octave_value_list();
+  }
+  MeshArguments mesh;
+  std::string error = parse_mesh_arguments (args, mesh, 1);
+  if (! error.empty ())
+  {
+      std::cout << error << "\n";
+      return octave_value_list();
+  }
+  // whether to weld the vertices within tolerance before writing
+  bool compact = false;
+  double tolerance = 0;
+  for (int i = mesh.options; i < args.length(); i += 2)
+  {
+      std::string property = args(i).is_string() ? args(i).string_value() : "";
+      if (property == "compact" && args(i+1).is_bool_scalar())
+      {
+          compact = args(i+1).bool_value();
+      }
+      else if (property == "tolerance" && args(i+1).is_real_scalar()
+               && args(i+1).double_value() >= 0)
+      {
+          tolerance = args(i+1).double_value();
+      }
+      else
+      {
+          std::cout << "Invalid property or value in input arguments.\n";
+          return octave_value_list();
+      }
+  }
+  // faces must refer to the rows of their own mesh, since they are offset
+  // past the meshes written before it
+  IndexView F (mesh.F);
+  IndexView FT (mesh.FT);
+  IndexView FN (mesh.FN);
+  if (compact)
+  {
+      error = compact_mesh (mesh.V, F, mesh.VT, FT, mesh.VN, FN,
+                            mesh.texture, mesh.normals, tolerance);
+      if (! error.empty ())
+      {
+          std::cout << error << "\n";
+          return octave_value_list();
+      }
+  }
+  else if (! faces_in_range (F, mesh.V.rows ())
+           || ! faces_in_range (FT, mesh.VT.rows ())
+           || ! faces_in_range (FN, mesh.VN.rows ()))
+  {
+      std::cout << "Faces refer to missing rows of the mesh.\n";
+      return octave_value_list();
+  }
+
+  // the file may have been opened by a writeObjOpen built with support for
+  // more compression formats
+  int compression = writer.getfield ("compression").int_value();
+#if ! defined (HAVE_ZLIB)
+  if (compression == OUTPUT_GZIP)
+  {
+      std::cout << "writeObjAppend was compiled without gzip support.\n";
+      return octave_value_list();
+  }
+#endif
+#if ! defined (HAVE_ZSTD)
+  if (compression == OUTPUT_ZSTD)
+  {
+      std::cout << "writeObjAppend was compiled without zstd support.\n";
+      return octave_value_list();
+  }
+#endif
+  // reopen the temporary file, which must not have changed since the last
+  // call, and append the mesh to it
+  std::string filename = writer.getfield ("filename").string_value();
+  ObjWriter outputFile (writer.getfield ("precision").int_value());
+  if (! outputFile.resume (filename,
+                           writer.getfield ("temporary").string_value(),
+                           writer.getfield ("size").double_value(),
+                           writer.getfield ("overwrite").bool_value(),
+                           compression,
+                           writer.getfield ("compressionlevel").int_value()))
+  {
+      std::cout << "Obj file is closed or has been modified since it was opened.\n";
+      return octave_value_list();
+  }
+  int num_threads = writer.getfield ("threads").int_value();
+  octave_idx_type offsets[3];
+  offsets[0] = writer.getfield ("vertex_offset").idx_type_value();
+  offsets[1] = writer.getfield ("texture_offset").idx_type_value();
+  offsets[2] = writer.getfield ("normals_offset").idx_type_value();
+  if (mesh.texture && ! writer.getfield ("mtllib").bool_value())
+  {
+      outputFile.put ("mtllib ./");
+      outputFile.put (material_filename (filename));
+      outputFile.put ("\n");
+      writer.assign ("mtllib", true);
+  }
+  outputFile.put ("\no ");
+  outputFile.put (mesh.filename);
+  outputFile.put ("\ng ");
+  outputFile.put (mesh.filename);
+  outputFile.put ("\n");
+  write_element (outputFile, "v ", mesh.V, num_threads);
+  if (mesh.texture)
+  {
+      write_element (outputFile, "vt ", mesh.VT, num_threads);
+  }
+  if (mesh.normals)
+  {
+      write_element (outputFile, "vn ", mesh.VN, num_threads);
+  }
+  if (mesh.texture && mesh.normals)
+  {
+      write_faces<true, true> (outputFile, F, FT, FN, offsets, num_threads);
+  }
+  else if (mesh.texture)
+  {
+      write_faces<true, false> (outputFile, F, FT, FN, offsets, num_threads);
+  }
+  else if (mesh.normals)
+  {
+      write_faces<false, true> (outputFile, F, FT, FN, offsets, num_threads);
+  }
+  else
+  {
+      write_faces<false, false> (outputFile, F, FT, FN, offsets, num_threads);
+  }
+  long size = outputFile.release ();
+  if (size < 0)
+  {
+      std::cout << "Error writing " << filename << "\n";
+      return octave_value_list();
+  }
+
+  // advance the writer state past the mesh
+  writer.assign ("size", double (size));
+  writer.assign ("objects", writer.getfield ("objects").double_value() + 1);
+  writer.assign ("vertex_offset", double (offsets[0] + mesh.V.rows ()));
+  writer.assign ("texture_offset", double (offsets[1] + mesh.VT.rows ()));
+  writer.assign ("normals_offset", double (offsets[2] + mesh.VN.rows ()));
+  writer.assign ("face_offset", writer.getfield ("face_offset").double_value()
+                                + F.rows ());
+
+  octave_value_list retval;
+  retval(0) = writer;
+  return retval;
+}
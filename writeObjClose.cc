@@ -0,0 +1,121 @@
+/*
+Copyright (C) 2018-2020 Andreas Bertsatos <abertsatos@biol.uoa.gr>
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free Software
+Foundation; either version 3 of the License, or (at your option) any later
+version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+details.
+
+You should have received a copy of the GNU General Public License along with
+this program; if not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <iostream>
+#include <string>
+#include <octave/oct.h>
+#include "objWriter.h"
+
+
+DEFUN_DLD (writeObjClose, args, nargout,
+          "-*- texinfo -*-\n\
+@deftypefn{Loadable function} writeObjClose(@var{objWriter})\n\
+@deftypefnx{Loadable function} FILENAME = writeObjClose(@var{objWriter})\n\
+\n\
+\n\
+Example: writeObjClose(objWriter)\n\
+\n\
+\n\
+This function completes a Wavefront Obj file opened with\n\
+@code{writeObjOpen} and written with @code{writeObjAppend}, by moving its\n\
+temporary file to its final name. Unless the file was opened with\n\
+@code{\"ifexists\"} set to \"overwrite\", a file created under the same name\n\
+in the meantime is never replaced.\n\
+\n\
+Optional property/value pairs may follow @var{objWriter}:\n\
+\n\
+@code{\"discard\"} set to true removes the temporary file instead, so that\n\
+nothing is written. Default is false.\n\
+\n\
+The optional output argument returns the name of the written file.\n\
+@end deftypefn")
+{
+
+  // Check for a valid number of input arguments
+  if (args.length() < 1 || args.length() % 2 == 0 || ! args(0).isstruct())
+  {
+      std::cout << "Invalid number of input arguments.\n";
+      return octave_value_list();
+  }
+  octave_scalar_map writer = args(0).scalar_map_value();
+  if (! writer.isfield ("temporary") || ! writer.isfield ("face_offset"))
+  {
+      std::cout << "First input argument should be an objWriter structure.\n";
+      return octave_value_list();
+  }
+  bool discard = false;
+  for (int i = 1; i < args.length(); i += 2)
+  {
+      std::string property = args(i).is_string() ? args(i).string_value() : "";
+      if (property == "discard" && (args(i+1).is_bool_scalar()
+          || args(i+1).is_real_scalar()))
+      {
+          discard = args(i+1).bool_value();
+      }
+      else
+      {
+          std::cout << "Invalid property or value in input arguments.\n";
+          return octave_value_list();
+      }
+  }
+  std::string filename = writer.getfield ("filename").string_value();
+  std::string temporary = writer.getfield ("temporary").string_value();
+  if (discard)
+  {
+      ObjWriter::discard (temporary);
+      return octave_value_list();
+  }
+
+  // reopen the temporary file to check that it has not changed since the
+  // last call, then move it to its final name
+  ObjWriter outputFile;
+  if (! outputFile.resume (filename, temporary,
+                           writer.getfield ("size").double_value(),
+                           writer.getfield ("overwrite").bool_value()))
+  {
+      std::cout << "Obj file is closed or has been modified since it was opened.\n";
+      return octave_value_list();
+  }
+  if (! outputFile.close ())
+  {
+      if (outputFile.target_existed ())
+      {
+          std::cout << "Filename " << filename << " already exists.\n";
+      }
+      else
+      {
+          std::cout << "Error writing " << filename << "\n";
+      }
+      return octave_value_list();
+  }
+  if (writer.getfield ("verbose").bool_value())
+  {
+      std::cout << "Mesh filename is " << filename << "\n";
+      std::cout << "Mesh has " << writer.getfield ("vertex_offset").idx_type_value()
+                << " vertices.\n";
+      std::cout << "Mesh has " << writer.getfield ("face_offset").idx_type_value()
+                << " faces.\n";
+      std::cout << "Mesh has " << writer.getfield ("objects").idx_type_value()
+                << " objects.\n";
+  }
+  octave_value_list retval;
+  if (nargout > 0)
+  {
+      retval(0) = filename;
+  }
+  return retval;
+}
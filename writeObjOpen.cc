@@ -0,0 +1,205 @@
+/*
+Copyright (C) 2018-2020 Andreas Bertsatos <abertsatos@biol.uoa.gr>
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free Software
+Foundation; either version 3 of the License, or (at your option) any later
+version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+details.
+
+You should have received a copy of the GNU General Public License along with
+this program; if not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <iostream>
+#include <string>
+#include <thread>
+#include <octave/oct.h>
+#include "objWriter.h"
+
+
+DEFUN_DLD (writeObjOpen, args, nargout,
+          "-*- texinfo -*-\n\
+@deftypefn{Loadable function} @var{objWriter} = writeObjOpen(@var{filename})\n\
+\n\
+\n\
+Example: objWriter = writeObjOpen(\"Skeleton.obj\")\n\
+\n\
+\n\
+This function opens a Wavefront Obj file for writing several triangular\n\
+meshes into it with @code{writeObjAppend}, each one as its own named object,\n\
+without concatenating their matrices and offsetting their face indices in\n\
+memory. The file is completed with @code{writeObjClose}.\n\
+\n\
+The returned @var{objWriter} is a structure holding the filename, the\n\
+temporary file the meshes are written to, the writing options and the\n\
+number of vertices, texture coordinates, vertex normals and faces written so\n\
+far. Since @var{objWriter} is an ordinary structure, it must be updated with\n\
+the output argument of each @code{writeObjAppend} call. The file only\n\
+appears under its final name once @code{writeObjClose} is called, so other\n\
+processes never read a partially written file.\n\
+\n\
+Optional property/value pairs may follow the filename:\n\
+\n\
+@code{\"precision\"}, @code{\"threads\"}, @code{\"ifexists\"},\n\
+@code{\"compression\"} and @code{\"compressionlevel\"} are the same as in\n\
+@code{writeObj} and apply to all appended meshes. The filename is checked\n\
+against @code{\"ifexists\"} when the file is opened and again when it is\n\
+closed.\n\
+\n\
+@code{\"verbose\"} set to false suppresses the summary printed by\n\
+@code{writeObjClose}. Default is true.\n\
+\n\
+For example, the bones of a skeleton may be written into a single file as:\n\
+\n\
+@example\n\
+w = writeObjOpen (\"Skeleton.obj\", \"ifexists\", \"overwrite\");\n\
+for i = 1:numel (bones)\n\
+  w = writeObjAppend (w, bones(i).V, bones(i).F, bones(i).name);\n\
+endfor\n\
+writeObjClose (w);\n\
+@end example\n\
+@end deftypefn")
+{
+
+  // Check for a filename followed by optional property/value pairs
+  if (args.length() < 1 || args.length() % 2 == 0 || ! args(0).is_string())
+  {
+      std::cout << "Invalid number of input arguments.\n";
+      return octave_value_list();
+  }
+  if (nargout != 1)
+  {
+      std::cout << "Invalid number of output arguments.\n";
+      return octave_value_list();
+  }
+  int precision = PRECISION_ROUNDTRIP;
+  int num_threads = 1;
+  int if_exists = EXISTING_FAIL;
+  bool verbose = true;
+  // compression format, which is otherwise implied by the filename
+  int compression = -1;
+  int compression_level = -1;
+  for (int i = 1; i < args.length(); i += 2)
+  {
+      std::string property = args(i).is_string() ? args(i).string_value() : "";
+      std::string value = args(i+1).is_string() ? args(i+1).string_value() : "";
+      if (property == "precision" && value == "roundtrip")
+      {
+          precision = PRECISION_ROUNDTRIP;
+      }
+      else if (property == "precision" && args(i+1).is_real_scalar()
+               && args(i+1).int_value() >= 1 && args(i+1).int_value() <= 17)
+      {
+          precision = args(i+1).int_value();
+      }
+      else if (property == "threads" && args(i+1).is_real_scalar())
+      {
+          num_threads = args(i+1).int_value();
+          if (num_threads < 1)
+          {
+              num_threads = std::thread::hardware_concurrency();
+          }
+          num_threads = std::max (num_threads, 1);
+      }
+      else if (property == "ifexists" && existing_file_value (value) >= 0)
+      {
+          if_exists = existing_file_value (value);
+      }
+      else if (property == "compression" && output_compression_value (value) >= 0)
+      {
+          compression = output_compression_value (value);
+      }
+      else if (property == "compressionlevel" && args(i+1).is_real_scalar()
+               && args(i+1).int_value() >= 1 && args(i+1).int_value() <= 19)
+      {
+          compression_level = args(i+1).int_value();
+      }
+      else if (property == "verbose" && (args(i+1).is_bool_scalar()
+               || args(i+1).is_real_scalar()))
+      {
+          verbose = args(i+1).bool_value();
+      }
+      else
+      {
+          std::cout << "Invalid property or value in input arguments.\n";
+          return octave_value_list();
+      }
+  }
+  std::string filename = args(0).string_value();
+  if (compression < 0)
+  {
+      compression = output_compression_of (filename);
+  }
+  if (compression == OUTPUT_GZIP && compression_level > 9)
+  {
+      std::cout << "Compression level of gzip should be between 1 and 9.\n";
+      return octave_value_list();
+  }
+#if ! defined (HAVE_ZLIB)
+  if (compression == OUTPUT_GZIP)
+  {
+      std::cout << "writeObjOpen was compiled without gzip support.\n";
+      return octave_value_list();
+  }
+#endif
+#if ! defined (HAVE_ZSTD)
+  if (compression == OUTPUT_ZSTD)
+  {
+      std::cout << "writeObjOpen was compiled without zstd support.\n";
+      return octave_value_list();
+  }
+#endif
+
+  // check if filename exists and either give up or pick a free filename,
+  // then write the header to the temporary file
+  if (! resolve_filename (filename, if_exists))
+  {
+      std::cout << "Filename " << filename << " already exists.\n";
+      return octave_value_list();
+  }
+  ObjWriter outputFile (precision);
+  if (! outputFile.open (filename, if_exists == EXISTING_OVERWRITE,
+                         compression, compression_level))
+  {
+      std::cout << "Error opening " << filename << " for write\n";
+      return octave_value_list();
+  }
+  outputFile.put ("#\n# OBJ File generated by GNU Octave\n# using 'writeObjOpen' function\n");
+  outputFile.put ("#\n# Object ");
+  outputFile.put (filename);
+  outputFile.put ("\n#\n#\n");
+  std::string temporary = outputFile.temporary_filename ();
+  long size = outputFile.release ();
+  if (size < 0)
+  {
+      std::cout << "Error writing " << filename << "\n";
+      return octave_value_list();
+  }
+
+  // define the writer state
+  octave_scalar_map writer;
+  writer.assign ("filename", filename);
+  writer.assign ("temporary", temporary);
+  writer.assign ("size", double (size));
+  writer.assign ("overwrite", if_exists == EXISTING_OVERWRITE);
+  writer.assign ("precision", double (precision));
+  writer.assign ("threads", double (num_threads));
+  writer.assign ("compression", double (compression));
+  writer.assign ("compressionlevel", double (compression_level));
+  writer.assign ("verbose", verbose);
+  writer.assign ("mtllib", false);
+  writer.assign ("objects", 0.0);
+  writer.assign ("vertex_offset", 0.0);
+  writer.assign ("texture_offset", 0.0);
+  writer.assign ("normals_offset", 0.0);
+  writer.assign ("face_offset", 0.0);
+
+  octave_value_list retval;
+  retval(0) = writer;
+  return retval;
+}
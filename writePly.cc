@@ -0,0 +1,377 @@
+/*
+Copyright (C) 2018-2020 Andreas Bertsatos <abertsatos@biol.uoa.gr>
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free Software
+Foundation; either version 3 of the License, or (at your option) any later
+version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+details.
+
+You should have received a copy of the GNU General Public License along with
+this program; if not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include <octave/oct.h>
+#include "meshIndex.h"
+#include "meshBinary.h"
+#include "objWriter.h"
+
+// vertex, texture and normal index of a face corner
+struct PlyCorner
+{
+  octave_idx_type v, vt, vn;
+
+  bool operator == (const PlyCorner& other) const
+  {
+    return v == other.v && vt == other.vt && vn == other.vn;
+  }
+};
+
+struct PlyCornerHash
+{
+  size_t operator () (const PlyCorner& c) const
+  {
+    uint64_t h = c.v * 0x9E3779B97F4A7C15ULL;
+    h ^= (c.vt + 0x632BE59BD9B4E019ULL + (h << 6) + (h >> 2));
+    h ^= (c.vn + 0x85EBCA77C2B2AE63ULL + (h << 6) + (h >> 2));
+    return h;
+  }
+};
+
+// whether the texture or normal index of every face corner is its vertex
+// index, in which case these attributes are already stored per vertex
+static bool per_vertex (const IndexView& F, const IndexView& G,
+                        octave_idx_type V_rows, octave_idx_type G_rows)
+{
+  if (G_rows != V_rows)
+  {
+      return false;
+  }
+  for (octave_idx_type i = 0; i < F.rows (); i++)
+  {
+      for (int j = 0; j < 3; j++)
+      {
+          if (F(i,j) != G(i,j))
+          {
+              return false;
+          }
+      }
+  }
+  return true;
+}
+
+// append a vertex property value of the chosen precision to a record
+template <typename T>
+static inline char *store_value (char *p, double value)
+{
+  T stored = value;
+  memcpy (p, &stored, sizeof (T));
+  return p + sizeof (T);
+}
+
+// write the records of the given vertices, where corners holds the source
+// rows of their coordinates, texture coordinates and normals
+template <typename T>
+static void write_vertices (ObjWriter& out, const MeshArguments& mesh,
+                            const std::vector<PlyCorner>& corners,
+                            octave_idx_type rows)
+{
+  const double *V = mesh.V.data ();
+  const double *VT = mesh.VT.data ();
+  const double *VN = mesh.VN.data ();
+  octave_idx_type V_rows = mesh.V.rows ();
+  octave_idx_type VT_rows = mesh.VT.rows ();
+  octave_idx_type VN_rows = mesh.VN.rows ();
+  bool split = ! corners.empty ();
+  size_t record = sizeof (T) * (3 + (mesh.normals ? 3 : 0)
+                                + (mesh.texture ? 2 : 0));
+  // records are gathered in blocks, which are appended to the output
+  const octave_idx_type block_rows = 1 << 14;
+  std::vector<char> block (block_rows * record);
+  for (octave_idx_type begin = 0; begin < rows; begin += block_rows)
+  {
+      octave_idx_type end = std::min (rows, begin + block_rows);
+      char *p = block.data ();
+      for (octave_idx_type i = begin; i < end; i++)
+      {
+          octave_idx_type v = split ? corners[i].v : i;
+          for (int j = 0; j < 3; j++)
+          {
+              p = store_value<T> (p, V[v + j * V_rows]);
+          }
+          if (mesh.normals)
+          {
+              octave_idx_type vn = split ? corners[i].vn : i;
+              for (int j = 0; j < 3; j++)
+              {
+                  p = store_value<T> (p, VN[vn + j * VN_rows]);
+              }
+          }
+          if (mesh.texture)
+          {
+              octave_idx_type vt = split ? corners[i].vt : i;
+              for (int j = 0; j < 2; j++)
+              {
+                  p = store_value<T> (p, VT[vt + j * VT_rows]);
+              }
+          }
+      }
+      out.put (block.data (), p - block.data ());
+  }
+}
+
+// write the face records as a count of 3 followed by three 0-based indices
+template <typename T>
+static void write_faces (ObjWriter& out, const IndexView& F,
+                         const std::vector<octave_idx_type>& corner_vertex)
+{
+  octave_idx_type F_rows = F.rows ();
+  bool split = ! corner_vertex.empty ();
+  const size_t record = 1 + 3 * sizeof (T);
+  const octave_idx_type block_rows = 1 << 14;
+  std::vector<char> block (block_rows * record);
+  for (octave_idx_type begin = 0; begin < F_rows; begin += block_rows)
+  {
+      octave_idx_type end = std::min (F_rows, begin + block_rows);
+      char *p = block.data ();
+      for (octave_idx_type i = begin; i < end; i++)
+      {
+          *p++ = 3;
+          for (int j = 0; j < 3; j++)
+          {
+              T index = split ? corner_vertex[i + j * F_rows] : F(i,j) - 1;
+              memcpy (p, &index, sizeof (T));
+              p += sizeof (T);
+          }
+      }
+      out.put (block.data (), p - block.data ());
+  }
+}
+
+
+DEFUN_DLD (writePly, args, nargout,
+          "-*- texinfo -*-\n\
+@deftypefn{Loadable function} writePly(@var{input_arguments})\n\
+@deftypefnx{Loadable function} FILENAME = writePly(@var{input_arguments})\n\
+\n\
+\n\
+Example: writePly(V, F, \"3DMesh.ply\")\n\
+\n\
+\n\
+This function saves a triangular 3D Mesh to a binary little endian PLY file.\n\
+It takes the same 3, 5 or 7 input arguments as @code{writeObj}, i.e. the\n\
+vertices and faces, optionally followed by texture coordinates and texture\n\
+faces and/or vertex normals and face normals, and the filename.\n\
+\n\
+PLY files store texture coordinates and normals per vertex. If the texture or\n\
+normal faces differ from the faces, the vertices are split so that every\n\
+distinct combination of vertex, texture coordinate and normal becomes a vertex\n\
+of the written file.\n\
+\n\
+Optional property/value pairs may follow the filename:\n\
+\n\
+@code{\"class\"} sets the type of the vertex properties to \"double\" or to\n\
+\"single\", which halves their size. Default is \"double\".\n\
+\n\
+@code{\"ifexists\"} sets what happens when the file already exists: \"fail\",\n\
+\"overwrite\" or \"rename\", as in @code{writeObj}. Default is \"fail\".\n\
+\n\
+@code{\"verbose\"} set to false suppresses the messages printed while\n\
+writing. Default is true.\n\
+\n\
+The optional output argument returns the name of the written file.\n\
+\n\
+Example: writePly(V, F, VN, FN, \"3DMesh.ply\", \"class\", \"single\")\n\
+@end deftypefn")
+{
+
+  MeshArguments mesh;
+  std::string error = parse_mesh_arguments (args, mesh);
+  if (! error.empty ())
+  {
+      std::cout << error << "\n";
+      return octave_value_list();
+  }
+  // store vertex properties as doubles or singles
+  bool single = false;
+  // what to do if the file already exists
+  int if_exists = EXISTING_FAIL;
+  // whether to print progress messages
+  bool verbose = true;
+  for (int i = mesh.options; i < args.length(); i += 2)
+  {
+      std::string property = args(i).is_string() ? args(i).string_value() : "";
+      std::string value = args(i+1).is_string() ? args(i+1).string_value() : "";
+      if (property == "class" && (value == "double" || value == "single"))
+      {
+          single = value == "single";
+      }
+      else if (property == "ifexists" && existing_file_value (value) >= 0)
+      {
+          if_exists = existing_file_value (value);
+      }
+      else if (property == "verbose" && (args(i+1).is_bool_scalar()
+               || args(i+1).is_real_scalar()))
+      {
+          verbose = args(i+1).bool_value();
+      }
+      else
+      {
+          std::cout << "Invalid property or value in input arguments.\n";
+          return octave_value_list();
+      }
+  }
+  if (! little_endian_host ())
+  {
+      std::cout << "Binary PLY files are only supported on little endian machines.\n";
+      return octave_value_list();
+  }
+  IndexView F (mesh.F);
+  IndexView FT (mesh.FT);
+  IndexView FN (mesh.FN);
+  octave_idx_type V_rows = mesh.V.rows();
+  octave_idx_type F_rows = F.rows();
+  // split the vertices whose corners refer to different texture coordinates
+  // or normals
+  std::vector<PlyCorner> corners;
+  std::vector<octave_idx_type> corner_vertex;
+  if ((mesh.texture && ! per_vertex (F, FT, V_rows, mesh.VT.rows()))
+      || (mesh.normals && ! per_vertex (F, FN, V_rows, mesh.VN.rows())))
+  {
+      std::unordered_map<PlyCorner, octave_idx_type, PlyCornerHash> vertex_of;
+      vertex_of.reserve (V_rows);
+      corner_vertex.resize (3 * F_rows);
+      for (octave_idx_type i = 0; i < F_rows; i++)
+      {
+          for (int j = 0; j < 3; j++)
+          {
+              PlyCorner c = {F(i,j) - 1, mesh.texture ? FT(i,j) - 1 : 0,
+                             mesh.normals ? FN(i,j) - 1 : 0};
+              if (c.v < 0 || c.v >= V_rows
+                  || c.vt < 0 || (mesh.texture && c.vt >= mesh.VT.rows())
+                  || c.vn < 0 || (mesh.normals && c.vn >= mesh.VN.rows()))
+              {
+                  std::cout << "Faces refer to missing vertices.\n";
+                  return octave_value_list();
+              }
+              std::pair<std::unordered_map<PlyCorner, octave_idx_type,
+                                           PlyCornerHash>::iterator, bool>
+                found = vertex_of.insert (std::make_pair (c, corners.size ()));
+              if (found.second)
+              {
+                  corners.push_back (c);
+              }
+              corner_vertex[i + j * F_rows] = found.first->second;
+          }
+      }
+  }
+  // the corners were checked while splitting, otherwise the texture and
+  // normal faces equal the faces, whose indices are still unchecked
+  else if (! faces_in_range (F, V_rows))
+  {
+      std::cout << "Faces refer to missing vertices.\n";
+      return octave_value_list();
+  }
+  octave_idx_type rows = corners.empty () ? V_rows : corners.size ();
+  // indices are stored as int, unless there are too many vertices
+  bool wide = rows > INT32_MAX;
+  if (rows > UINT32_MAX)
+  {
+      std::cout << "Mesh has too many vertices for a PLY file.\n";
+      return octave_value_list();
+  }
+
+  // check if filename exists and either give up or pick a free filename
+  std::string filename = mesh.filename;
+  if (! resolve_filename (filename, if_exists))
+  {
+      std::cout << "Filename " << filename << " already exists.\n";
+      return octave_value_list();
+  }
+  ObjWriter outputFile;
+  if (! outputFile.open (filename, if_exists == EXISTING_OVERWRITE))
+  {
+      std::cout << "Error opening " << filename << " for write\n";
+      return octave_value_list();
+  }
+  if (verbose)
+  {
+      std::cout << "Writing to file... ";
+  }
+  // writing header to file
+  const char *type = single ? "float" : "double";
+  outputFile.put ("ply\nformat binary_little_endian 1.0\n");
+  outputFile.put ("comment PLY File generated by GNU Octave using 'writePly' function\n");
+  outputFile.put ("element vertex ");
+  outputFile.put_index (rows);
+  outputFile.put ("\n");
+  const char *names[] = {"x", "y", "z", "nx", "ny", "nz", "u", "v"};
+  for (int k = 0; k < 8; k++)
+  {
+      if ((k >= 3 && k < 6 && ! mesh.normals) || (k >= 6 && ! mesh.texture))
+      {
+          continue;
+      }
+      outputFile.put ("property ");
+      outputFile.put (type);
+      outputFile.put (" ");
+      outputFile.put (names[k]);
+      outputFile.put ("\n");
+  }
+  outputFile.put ("element face ");
+  outputFile.put_index (F_rows);
+  outputFile.put (wide ? "\nproperty list uchar uint vertex_indices\n"
+                       : "\nproperty list uchar int vertex_indices\n");
+  outputFile.put ("end_header\n");
+  // write vertices and faces to file
+  if (single)
+  {
+      write_vertices<float> (outputFile, mesh, corners, rows);
+  }
+  else
+  {
+      write_vertices<double> (outputFile, mesh, corners, rows);
+  }
+  if (wide)
+  {
+      write_faces<uint32_t> (outputFile, F, corner_vertex);
+  }
+  else
+  {
+      write_faces<int32_t> (outputFile, F, corner_vertex);
+  }
+  if (! outputFile.close ())
+  {
+      if (outputFile.target_existed ())
+      {
+          std::cout << "Filename " << filename << " already exists.\n";
+      }
+      else
+      {
+          std::cout << "Error writing " << filename << "\n";
+      }
+      return octave_value_list();
+  }
+  if (verbose)
+  {
+      std::cout << "done!\n";
+      std::cout << "Mesh filename is " << filename << "\n";
+      std::cout << "Mesh has " << rows << " vertices.\n";
+      std::cout << "Mesh has " << F_rows << " faces.\n";
+  }
+  octave_value_list retval;
+  if (nargout > 0)
+  {
+      retval(0) = filename;
+  }
+  return retval;
+}
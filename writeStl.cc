@@ -0,0 +1,207 @@
+/*
+Copyright (C) 2018-2020 Andreas Bertsatos <abertsatos@biol.uoa.gr>
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free Software
+Foundation; either version 3 of the License, or (at your option) any later
+version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+details.
+
+You should have received a copy of the GNU General Public License along with
+this program; if not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <octave/oct.h>
+#include "meshIndex.h"
+#include "meshBinary.h"
+#include "objWriter.h"
+
+
+DEFUN_DLD (writeStl, args, nargout,
+          "-*- texinfo -*-\n\
+@deftypefn{Loadable function} writeStl(@var{input_arguments})\n\
+@deftypefnx{Loadable function} FILENAME = writeStl(@var{input_arguments})\n\
+\n\
+\n\
+Example: writeStl(V, F, \"3DMesh.stl\")\n\
+\n\
+\n\
+This function saves a triangular 3D Mesh to a binary STL file. It takes the\n\
+same 3, 5 or 7 input arguments as @code{writeObj}, i.e. the vertices and\n\
+faces, optionally followed by texture coordinates and texture faces and/or\n\
+vertex normals and face normals, and the filename.\n\
+\n\
+STL files store each triangle with its own three vertices in single precision\n\
+and its facet normal, which is computed from the vertices. Texture\n\
+coordinates and vertex normals cannot be stored in STL files and are ignored.\n\
+\n\
+Optional property/value pairs may follow the filename:\n\
+\n\
+@code{\"ifexists\"} sets what happens when the file already exists: \"fail\",\n\
+\"overwrite\" or \"rename\", as in @code{writeObj}. Default is \"fail\".\n\
+\n\
+@code{\"verbose\"} set to false suppresses the messages printed while\n\
+writing. Default is true.\n\
+\n\
+The optional output argument returns the name of the written file.\n\
+\n\
+Example: writeStl(V, F, \"3DMesh.stl\", \"ifexists\", \"overwrite\")\n\
+@end deftypefn")
+{
+
+  MeshArguments mesh;
+  std::string error = parse_mesh_arguments (args, mesh);
+  if (! error.empty ())
+  {
+      std::cout << error << "\n";
+      return octave_value_list();
+  }
+  // what to do if the file already exists
+  int if_exists = EXISTING_FAIL;
+  // whether to print progress messages
+  bool verbose = true;
+  for (int i = mesh.options; i < args.length(); i += 2)
+  {
+      std::string property = args(i).is_string() ? args(i).string_value() : "";
+      std::string value = args(i+1).is_string() ? args(i+1).string_value() : "";
+      if (property == "ifexists" && existing_file_value (value) >= 0)
+      {
+          if_exists = existing_file_value (value);
+      }
+      else if (property == "verbose" && (args(i+1).is_bool_scalar()
+               || args(i+1).is_real_scalar()))
+      {
+          verbose = args(i+1).bool_value();
+      }
+      else
+      {
+          std::cout << "Invalid property or value in input arguments.\n";
+          return octave_value_list();
+      }
+  }
+  if (! little_endian_host ())
+  {
+      std::cout << "Binary STL files are only supported on little endian machines.\n";
+      return octave_value_list();
+  }
+  IndexView F (mesh.F);
+  const double *V = mesh.V.data();
+  octave_idx_type V_rows = mesh.V.rows();
+  octave_idx_type F_rows = F.rows();
+  if (F_rows > UINT32_MAX)
+  {
+      std::cout << "Mesh has too many faces for an STL file.\n";
+      return octave_value_list();
+  }
+  for (octave_idx_type i = 0; i < F_rows; i++)
+  {
+      for (int j = 0; j < 3; j++)
+      {
+          if (F(i,j) < 1 || F(i,j) > V_rows)
+          {
+              std::cout << "Faces refer to missing vertices.\n";
+              return octave_value_list();
+          }
+      }
+  }
+
+  // check if filename exists and either give up or pick a free filename
+  std::string filename = mesh.filename;
+  if (! resolve_filename (filename, if_exists))
+  {
+      std::cout << "Filename " << filename << " already exists.\n";
+      return octave_value_list();
+  }
+  ObjWriter outputFile;
+  if (! outputFile.open (filename, if_exists == EXISTING_OVERWRITE))
+  {
+      std::cout << "Error opening " << filename << " for write\n";
+      return octave_value_list();
+  }
+  if (verbose)
+  {
+      std::cout << "Writing to file... ";
+  }
+  // writing header to file, which must not start with "solid"
+  char header[stl_header_size];
+  memset (header, ' ', 80);
+  const char *title = "STL File generated by GNU Octave using 'writeStl' function";
+  memcpy (header, title, strlen (title));
+  uint32_t count = F_rows;
+  memcpy (header + 80, &count, sizeof (count));
+  outputFile.put (header, stl_header_size);
+  // write each triangle as its facet normal and its three vertices
+  const octave_idx_type block_rows = 1 << 14;
+  std::vector<char> block (block_rows * stl_record_size);
+  for (octave_idx_type begin = 0; begin < F_rows; begin += block_rows)
+  {
+      octave_idx_type end = std::min (F_rows, begin + block_rows);
+      char *p = block.data ();
+      for (octave_idx_type i = begin; i < end; i++)
+      {
+          float values[12];
+          double xyz[3][3];
+          for (int j = 0; j < 3; j++)
+          {
+              octave_idx_type v = F(i,j) - 1;
+              for (int k = 0; k < 3; k++)
+              {
+                  xyz[j][k] = V[v + k * V_rows];
+                  values[3 + 3 * j + k] = xyz[j][k];
+              }
+          }
+          double ab[3], ac[3], n[3];
+          for (int k = 0; k < 3; k++)
+          {
+              ab[k] = xyz[1][k] - xyz[0][k];
+              ac[k] = xyz[2][k] - xyz[0][k];
+          }
+          n[0] = ab[1] * ac[2] - ab[2] * ac[1];
+          n[1] = ab[2] * ac[0] - ab[0] * ac[2];
+          n[2] = ab[0] * ac[1] - ab[1] * ac[0];
+          double length = std::sqrt (n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+          for (int k = 0; k < 3; k++)
+          {
+              values[k] = length > 0 ? n[k] / length : 0;
+          }
+          memcpy (p, values, sizeof (values));
+          p[48] = p[49] = 0;
+          p += stl_record_size;
+      }
+      outputFile.put (block.data (), p - block.data ());
+  }
+  if (! outputFile.close ())
+  {
+      if (outputFile.target_existed ())
+      {
+          std::cout << "Filename " << filename << " already exists.\n";
+      }
+      else
+      {
+          std::cout << "Error writing " << filename << "\n";
+      }
+      return octave_value_list();
+  }
+  if (verbose)
+  {
+      std::cout << "done!\n";
+      std::cout << "Mesh filename is " << filename << "\n";
+      std::cout << "Mesh has " << V_rows << " vertices.\n";
+      std::cout << "Mesh has " << F_rows << " faces.\n";
+  }
+  octave_value_list retval;
+  if (nargout > 0)
+  {
+      retval(0) = filename;
+  }
+  return retval;
+}